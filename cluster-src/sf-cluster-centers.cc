@@ -43,7 +43,8 @@ SfClusterCenters::SfClusterCenters(int dimensionality,
   } 
 }
 
-SfClusterCenters::SfClusterCenters(const string& file_name) {
+SfClusterCenters::SfClusterCenters(const string& file_name)
+  : dimensionality_(0) {
   long int buffer_size = 1 * 1024 * 1024; // 1MB
   char* local_buffer = new char[buffer_size];
   std::ifstream file_stream(file_name.c_str(), std::ifstream::in);
@@ -69,14 +70,22 @@ void SfClusterCenters::AddClusterCenter(const SfWeightVector& new_center) {
   }
 }
 
-void SfClusterCenters::AddClusterCenterAt(const SfSparseVector& x) {
+void SfClusterCenters::GrowToFit(int max_feature_id) {
+  if (max_feature_id < dimensionality_) return;
+  dimensionality_ = max_feature_id + 1;
+  for (unsigned int i = 0; i < cluster_centers_.size(); ++i) {
+    cluster_centers_[i].GrowToFit(max_feature_id);
+  }
+}
+
+void SfClusterCenters::AddClusterCenterAt(const SfSparseVectorView& x) {
   SfWeightVector new_center(dimensionality_);
   new_center.AddVector(x, 1.0);
   AddClusterCenter(new_center);
 }
 
 float SfClusterCenters::SqDistanceToCenterId(int center_id,
-					     const SfSparseVector& x) const {
+					     const SfSparseVectorView& x) const {
   assert(center_id >= 0 &&
 	 static_cast<unsigned int>(center_id) < cluster_centers_.size());
   // ||a - b||^2 = a^2 - 2ab + b^2
@@ -88,7 +97,7 @@ float SfClusterCenters::SqDistanceToCenterId(int center_id,
 }
 
 float SfClusterCenters::SqDistanceToClosestCenter(
-      const SfSparseVector& x,
+      const SfSparseVectorView& x,
       int* closest_center_id) const {
   assert(!cluster_centers_.empty());
   assert(closest_center_id != NULL);
@@ -123,7 +132,7 @@ string SfClusterCenters::AsString() {
 }
 
 SfSparseVector* SfClusterCenters::MapVectorToCenters(
-    const SfSparseVector& x,
+    const SfSparseVectorView& x,
     ClusterCenterMappingType type,
     float p) const {
   SfSparseVector* mapped_x = new SfSparseVector(x);
@@ -61,19 +61,24 @@ class SfClusterCenters {
   // the new_center.
   void AddClusterCenter(const SfWeightVector& new_center);
 
+  // Increases the dimensionality of this object and of each cluster center,
+  // if need be, so that feature ids up to max_feature_id may be used.  The
+  // centers are unchanged, with zero weight for the new features.
+  void GrowToFit(int max_feature_id);
+
   // Create a new cluster center at the location given by SfSparseVector x.
-  void AddClusterCenterAt(const SfSparseVector& x);
+  void AddClusterCenterAt(const SfSparseVectorView& x);
 
   // Returns the squared Euclidean distance from x to the nearest cluster
   // center, and fills the closest_center_id output argument with the id
   // of the closest center.  This method will cause failure/death if there
   // are no centers defined, or if closest_center_id is null.
-  float SqDistanceToClosestCenter(const SfSparseVector& x,
+  float SqDistanceToClosestCenter(const SfSparseVectorView& x,
 				  int* closest_center_id) const;
 
   // Returns the Eucliean distance from x to the specified cluster center.
   // This will fail/die if the specified center_id does not exist.
-  float SqDistanceToCenterId(int center_id, const SfSparseVector& x) const;
+  float SqDistanceToCenterId(int center_id, const SfSparseVectorView& x) const;
 
   // Maps example x to a new transformed vector x', where each coordinate
   // i (ranging from 1..k+1) of the returned x' corresponds to cluster_center
@@ -81,7 +86,7 @@ class SfClusterCenters {
   // where f is determined by the ClusterCenterMappingType type:
   //   SQUARED_DISTANCE: f(x, c) = ||x - c|| ^ 2
   //   RBF_KERNEL: f(x, c) = exp(-p * ||x - c|| ^ 2)
-  SfSparseVector* MapVectorToCenters(const SfSparseVector& x,
+  SfSparseVector* MapVectorToCenters(const SfSparseVectorView& x,
 				     ClusterCenterMappingType type,
 				     float p) const;
 
@@ -108,7 +113,7 @@ class SfClusterCenters {
   int Size() const { return cluster_centers_.size(); }
 
  protected:
-  float SqDistance(int center_id, const SfSparseVector& x); 
+  float SqDistance(int center_id, const SfSparseVectorView& x); 
   
   // The set of cluster centers.
   vector<SfWeightVector> cluster_centers_;
@@ -70,6 +70,13 @@ int main (int argc, char** argv) {
 				"0 2 5 -1 0 0 0 0 0 0\n");
   assert(cluster_centers_1.AsString() == expected_output_string);
 
+  cluster_centers_1.GrowToFit(11);
+  assert(cluster_centers_1.GetDimensionality() == 12);
+  assert(cluster_centers_1.ClusterCenter(1).GetDimensions() == 12);
+  assert(cluster_centers_1.ClusterCenter(1).ValueOf(2) == 5);
+  cluster_centers_1.AddClusterCenterAt(SfSparseVector("0.0 11:1"));
+  assert(cluster_centers_1.ClusterCenter(2).ValueOf(11) == 1);
+
   SfClusterCenters cluster_centers_2("sf-cluster-centers_test.dat");
   assert(cluster_centers_2.Size() == 2);
   assert(cluster_centers_2.ClusterCenter(0).ValueOf(1) == 1);
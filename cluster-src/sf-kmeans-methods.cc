@@ -33,21 +33,9 @@ namespace sofia_cluster {
   //         Helper functions (Not exposed in API)
   // ---------------------------------------------------
 
-  int RandInt(int num_vals) {
-    return static_cast<int>(rand()) % num_vals;
-  }
-
-  float RandFloat() {
-    return static_cast<float>(rand() / static_cast<float>(RAND_MAX));
-  }
-
-  const SfSparseVector& RandomExample(const SfDataSet& data_set) {
-    int num_examples = data_set.NumExamples();
-    int i = static_cast<int>(rand()) % num_examples;
-    if (i < 0) {
-      i += num_examples;
-    }
-    return data_set.VectorAt(i);
+  SfSparseVectorView RandomExample(const SfDataSet& data_set,
+				   SfRandom* random) {
+    return data_set.VectorAt(random->RandInt(data_set.NumExamples()));
   }
 
   // ---------------------------------------------------
@@ -56,22 +44,24 @@ namespace sofia_cluster {
 
   void InitializeWithKRandomCenters(int k,
                                     const SfDataSet& data_set,
+                                    SfRandom* random,
                                     SfClusterCenters* cluster_centers) {
     assert(k > 0 && k <= data_set.NumExamples());
     std::set<int> selected_centers;
     // Sample k centers uniformly at random, with replacement.
     for (int i = 0; i < k; ++i) {
-      cluster_centers->AddClusterCenterAt(RandomExample(data_set));
+      cluster_centers->AddClusterCenterAt(RandomExample(data_set, random));
     }
   }
 
   void SamplingFarthestFirst(int k,
 			     int sample_size,
 			     const SfDataSet& data_set,
+			     SfRandom* random,
 			     SfClusterCenters* cluster_centers) {
     assert(k > 0 && k <= data_set.NumExamples());
     // Get first point.
-    int id = RandInt(data_set.NumExamples());
+    int id = random->RandInt(data_set.NumExamples());
     cluster_centers->AddClusterCenterAt(data_set.VectorAt(id));
     // Get the next k - 1 points.
     int center_id;
@@ -79,7 +69,7 @@ namespace sofia_cluster {
       int best_distance = 0;
       int best_center = 0;
       for (int j = 0; j < sample_size; ++j) {
-	int temp_id = RandInt(data_set.NumExamples());
+	int temp_id = random->RandInt(data_set.NumExamples());
 	float temp_distance = cluster_centers->
 	  SqDistanceToClosestCenter(data_set.VectorAt(temp_id), &center_id);
 	if (temp_distance > best_distance) {
@@ -93,10 +83,11 @@ namespace sofia_cluster {
 
   void ClassicKmeansPlusPlus(int k,
 			     const SfDataSet& data_set,
+			     SfRandom* random,
 			     SfClusterCenters* cluster_centers) {
     assert(k > 0 && k <= data_set.NumExamples());
     // Get first point.
-    int id = RandInt(data_set.NumExamples());
+    int id = random->RandInt(data_set.NumExamples());
     cluster_centers->AddClusterCenterAt(data_set.VectorAt(id));
     // Get the next k - 1 points.
     for (int i = 1; i < k; ++i) {
@@ -115,7 +106,7 @@ namespace sofia_cluster {
       }
       // Get an example with D^2 weighting.
       // Note that we're breaking ties arbitrarily.
-      float sample_distance = RandFloat() * total_distance_mass;
+      float sample_distance = random->RandFloat() * total_distance_mass;
       std::map<float, int>::iterator distance_iter =
 	distance_for_points.lower_bound(sample_distance);
       if (distance_iter == distance_for_points.end()) {
@@ -129,10 +120,11 @@ namespace sofia_cluster {
 
   void OptimizedKmeansPlusPlus(int k,
                                const SfDataSet& data_set,
+                               SfRandom* random,
                                SfClusterCenters* cluster_centers) {
     assert(k > 0 && k <= data_set.NumExamples());
     // Get first point, and initialize best distances.
-    int cluster_center = RandInt(data_set.NumExamples());
+    int cluster_center = random->RandInt(data_set.NumExamples());
     cluster_centers->AddClusterCenterAt(data_set.VectorAt(cluster_center));
     vector<float> best_center_ids(data_set.NumExamples(), 0);
     vector<float> best_distances(data_set.NumExamples(), FLT_MAX);
@@ -162,7 +154,7 @@ namespace sofia_cluster {
       }
       // Get an example with D^2 weighting.
       // Note that we're breaking ties arbitrarily.
-      float sample_distance = RandFloat() * total_distance_mass;
+      float sample_distance = random->RandFloat() * total_distance_mass;
       std::map<float, int>::iterator distance_iter =
 	distance_for_points.lower_bound(sample_distance);
       if (distance_iter == distance_for_points.end()) {
@@ -176,10 +168,11 @@ namespace sofia_cluster {
 
   void OptimizedKmeansPlusPlusTI(int k,
 				 const SfDataSet& data_set,
+				 SfRandom* random,
 				 SfClusterCenters* cluster_centers) {
     assert(k > 0 && k <= data_set.NumExamples());
     // Get first point, and initialize best distances.
-    int cluster_center = RandInt(data_set.NumExamples());
+    int cluster_center = random->RandInt(data_set.NumExamples());
     cluster_centers->AddClusterCenterAt(data_set.VectorAt(cluster_center));
     vector<float> best_center_ids(data_set.NumExamples(), 0);
     vector<float> best_distances(data_set.NumExamples());
@@ -217,7 +210,7 @@ namespace sofia_cluster {
       }
       // Get an example with D^2 weighting.
       // Note that we're breaking ties arbitrarily.
-      float sample_distance = RandFloat() * total_distance_mass;
+      float sample_distance = random->RandFloat() * total_distance_mass;
       std::map<float, int>::iterator distance_iter =
 	distance_for_points.lower_bound(sample_distance);
       if (distance_iter == distance_for_points.end()) {
@@ -239,11 +232,12 @@ namespace sofia_cluster {
   void SamplingKmeansPlusPlus(int k,
                               int sample_size,
                               const SfDataSet& data_set,
+                              SfRandom* random,
                               SfClusterCenters* cluster_centers) {
     assert(k > 0 && k <= data_set.NumExamples());
     assert(sample_size > 0);
     // Get first point, and initialize best distances.
-    int cluster_center = RandInt(data_set.NumExamples());
+    int cluster_center = random->RandInt(data_set.NumExamples());
     cluster_centers->AddClusterCenterAt(data_set.VectorAt(cluster_center));
 
     int cluster_id;
@@ -251,12 +245,12 @@ namespace sofia_cluster {
       int selected_center = 0;
       float total_distance_mass = 0.0;
       for (int j = 0; j < sample_size; ++j) {
-	int proposed_cluster_center = RandInt(data_set.NumExamples());
+	int proposed_cluster_center = random->RandInt(data_set.NumExamples());
 	float distance = cluster_centers->SqDistanceToClosestCenter(
 	  data_set.VectorAt(proposed_cluster_center),
 	  &cluster_id);
 	total_distance_mass += distance;
-	if (RandFloat() < distance / total_distance_mass) {
+	if (random->RandFloat() < distance / total_distance_mass) {
 	  selected_center = proposed_cluster_center;
 	}
       }
@@ -271,11 +265,13 @@ namespace sofia_cluster {
 
   void ProjectToL1Ball(float L1_lambda,
 		       float L1_epsilon,
+		       SfRandom* random,
 		       SfClusterCenters* cluster_centers) {
     if (L1_lambda > 0) {
       for (int i = 0; i < cluster_centers->Size(); ++i) {
 	if (L1_epsilon == 0.0) {
-	  cluster_centers->MutableClusterCenter(i)->ProjectToL1Ball(L1_lambda);
+	  cluster_centers->MutableClusterCenter(i)->
+	    ProjectToL1Ball(L1_lambda, random);
 	} else {
 	  cluster_centers->MutableClusterCenter(i)->
 	    ProjectToL1Ball(L1_lambda, L1_epsilon);
@@ -286,35 +282,38 @@ namespace sofia_cluster {
 
   void BatchKmeans(int num_iterations,
 		   const SfDataSet& data_set,
+		   SfRandom* random,
 		   SfClusterCenters* cluster_centers,
 		   float L1_lambda,
 		   float L1_epsilon) {
     for (int i = 0; i < num_iterations; ++i) {
       OneBatchKmeansOptimization(data_set, cluster_centers);
-      ProjectToL1Ball(L1_lambda, L1_epsilon, cluster_centers);
+      ProjectToL1Ball(L1_lambda, L1_epsilon, random, cluster_centers);
     }
   }
 
   void SGDKmeans(int num_iterations,
                  const SfDataSet& data_set,
+                 SfRandom* random,
                  SfClusterCenters* cluster_centers,
 		 float L1_lambda,
 		 float L1_epsilon) {
     vector<int> per_center_step_counts;
     per_center_step_counts.resize(cluster_centers->Size());
     for (int i = 0; i < num_iterations; ++i) {
-      OneStochasticKmeansStep(RandomExample(data_set),
+      OneStochasticKmeansStep(RandomExample(data_set, random),
 			      cluster_centers,
 			      &per_center_step_counts);
       if (i % 100 == 50)
-	ProjectToL1Ball(L1_lambda, L1_epsilon, cluster_centers);
+	ProjectToL1Ball(L1_lambda, L1_epsilon, random, cluster_centers);
     }    
-    ProjectToL1Ball(L1_lambda, L1_epsilon, cluster_centers);
+    ProjectToL1Ball(L1_lambda, L1_epsilon, random, cluster_centers);
   }
 
   void MiniBatchKmeans(int num_iterations,
 		       int mini_batch_size,
 		       const SfDataSet& data_set,
+		       SfRandom* random,
 		       SfClusterCenters* cluster_centers,
 		       float L1_lambda,
 		       float L1_epsilon) {
@@ -322,12 +321,13 @@ namespace sofia_cluster {
     per_center_step_counts.resize(cluster_centers->Size());
     for (int i = 0; i < num_iterations; ++i) {
       OneMiniBatchKmeansOptimization(data_set,
+				     random,
 				     cluster_centers,
 				     mini_batch_size,
 				     &per_center_step_counts);
-      ProjectToL1Ball(L1_lambda, L1_epsilon, cluster_centers);
+      ProjectToL1Ball(L1_lambda, L1_epsilon, random, cluster_centers);
     }    
-    ProjectToL1Ball(L1_lambda, L1_epsilon, cluster_centers);
+    ProjectToL1Ball(L1_lambda, L1_epsilon, random, cluster_centers);
   }
 
   void OneBatchKmeansOptimization(const SfDataSet& data_set,
@@ -361,7 +361,7 @@ namespace sofia_cluster {
     }
   }
 
-  void OneStochasticKmeansStep(const SfSparseVector& x,
+  void OneStochasticKmeansStep(const SfSparseVectorView& x,
                                SfClusterCenters* cluster_centers,
                                vector<int>* per_center_step_counts) {
     // Find the closest center.
@@ -378,6 +378,7 @@ namespace sofia_cluster {
   }
   
   void OneMiniBatchKmeansOptimization(const SfDataSet&  data_set,
+				      SfRandom* random,
 				      SfClusterCenters* cluster_centers,
 				      int mini_batch_size,
 				      vector<int>* per_center_step_counts) {
@@ -385,7 +386,7 @@ namespace sofia_cluster {
     vector<vector<int> > mini_batch_centers(cluster_centers->Size());
     for (int i = 0; i < mini_batch_size; ++i) {
       // Find the closest center for a random example.
-      int x_id = RandInt(data_set.NumExamples());
+      int x_id = random->RandInt(data_set.NumExamples());
       int closest_center;
       cluster_centers->SqDistanceToClosestCenter(data_set.VectorAt(x_id),
 						 &closest_center);
@@ -27,9 +27,14 @@
 #include <vector>
 #include "sf-cluster-centers.h"
 #include "../src/sf-data-set.h"
+#include "../src/sf-random.h"
 
 namespace sofia_cluster {
 
+  // Functions that sample examples, or project centers exactly to an L1
+  // ball, draw from random, which the caller seeds, so that runs are
+  // repeatable and each thread may use its own.
+
   // ---------------------------------------------------
   //          Kmeans Initialization Functions
   // ---------------------------------------------------
@@ -38,6 +43,7 @@ namespace sofia_cluster {
   // as the seed values for the cluster_centers.
   void InitializeWithKRandomCenters(int k,
 				    const SfDataSet& data_set,
+				    SfRandom* random,
 				    SfClusterCenters* cluster_centers);
 
   // Seed the cluster centers with k centers, sampled using the kmeans++
@@ -46,6 +52,7 @@ namespace sofia_cluster {
   // each sampling round.
   void ClassicKmeansPlusPlus(int k,
 			     const SfDataSet& data_set,
+			     SfRandom* random,
 			     SfClusterCenters* cluster_centers);
 
   // An optimized implementation of the kmeans++ sampling algorithm,
@@ -54,6 +61,7 @@ namespace sofia_cluster {
   // newest active center on each sampling round.
   void OptimizedKmeansPlusPlus(int k,
 			       const SfDataSet& data_set,
+			       SfRandom* random,
 			       SfClusterCenters* cluster_centers);
 
   // A further optimization of kmeans++, which only compares the
@@ -62,6 +70,7 @@ namespace sofia_cluster {
   // center.
   void OptimizedKmeansPlusPlusTI(int k,
 				 const SfDataSet& data_set,
+				 SfRandom* random,
 				 SfClusterCenters* cluster_centers);
 
   // A sampling-based variant of kmeans++, in which each new center
@@ -70,6 +79,7 @@ namespace sofia_cluster {
   void SamplingKmeansPlusPlus(int k,
 			      int sample_size,
 			      const SfDataSet& data_set,
+			      SfRandom* random,
 			      SfClusterCenters* cluster_centers);
 
   // A sampling-based variant of the farthest-first sampling method,
@@ -78,6 +88,7 @@ namespace sofia_cluster {
   void SamplingFarthestFirst(int k,
 			     int sample_size,
 			     const SfDataSet& data_set,
+			     SfRandom* random,
 			     SfClusterCenters* cluster_centers);
   
   // ---------------------------------------------------
@@ -91,6 +102,7 @@ namespace sofia_cluster {
   // center to a radius of between lambda and (1+epsilon)*lambda.
   void BatchKmeans(int num_iterations,
 		   const SfDataSet& data_set,
+		   SfRandom* random,
 		   SfClusterCenters* cluster_centers,
 		   float L1_lambda = -1.0,
 		   float L1_epsilon = 0.0);
@@ -103,6 +115,7 @@ namespace sofia_cluster {
   // center to a radius of between lambda and (1+epsilon)*lambda.
   void SGDKmeans(int num_iterations,
 		 const SfDataSet& data_set,
+		 SfRandom* random,
 		 SfClusterCenters* cluster_centers,
 		 float L1_lambda = -1.0,
 		 float L1_epsilon = 0.0);
@@ -119,6 +132,7 @@ namespace sofia_cluster {
   void MiniBatchKmeans(int num_iterations,
 		       int mini_batch_size,
 		       const SfDataSet& data_set,
+		       SfRandom* random,
 		       SfClusterCenters* cluster_centers,
 		       float L1_lambda = -1.0,
 		       float L1_epsilon = 0.0);
@@ -127,11 +141,12 @@ namespace sofia_cluster {
 				 SfClusterCenters* cluster_centers);
 
   void OneMiniBatchKmeansOptimization(const SfDataSet& data_set,
+				      SfRandom* random,
 				      SfClusterCenters* cluster_centers,
 				      int mini_batch_size,
 				      vector<int>* per_center_step_counts);
 
-  void OneStochasticKmeansStep(const SfSparseVector& x,
+  void OneStochasticKmeansStep(const SfSparseVectorView& x,
 			       SfClusterCenters* cluster_centers,
 			       vector<int>* per_center_step_counts);
 
@@ -22,12 +22,28 @@
 #include <iostream>
 #include "sf-kmeans-methods.h"
 
+// True if every center is at one of the examples of data_set.
+bool CentersAreExamples(const SfDataSet& data_set,
+			const SfClusterCenters& cluster_centers) {
+  for (int i = 0; i < cluster_centers.Size(); ++i) {
+    bool found = false;
+    for (int j = 0; j < data_set.NumExamples(); ++j) {
+      if (cluster_centers.SqDistanceToCenterId(i, data_set.VectorAt(j)) == 0) {
+	found = true;
+      }
+    }
+    if (!found) return false;
+  }
+  return true;
+}
+
 int main (int argc, char** argv) {
-  srand(101);  // Use a fixed seed for deterministic testing.
+  SfRandom random(101);  // Use a fixed seed for deterministic testing.
   SfDataSet data_set("sf-kmeans-methods_test.dat", 1, false);
   
   SfClusterCenters cluster_centers_1(10);
-  sofia_cluster::InitializeWithKRandomCenters(9, data_set, &cluster_centers_1);
+  sofia_cluster::InitializeWithKRandomCenters(9, data_set, &random,
+					      &cluster_centers_1);
   assert(cluster_centers_1.Size() == 9);
 
   SfClusterCenters* cluster_centers_2 = new SfClusterCenters(10, 1);
@@ -39,98 +55,164 @@ int main (int argc, char** argv) {
   assert(cluster_centers_2->ClusterCenter(0).ValueOf(3) < 0.34 &&
 	 cluster_centers_2->ClusterCenter(0).ValueOf(3) > 0.33);
   
-  SfClusterCenters* cluster_centers_3 = new SfClusterCenters(10);
-  srand(105);  // Use a fixed seed for deterministic testing.
-  sofia_cluster::InitializeWithKRandomCenters(3, data_set, cluster_centers_3);
-  sofia_cluster::BatchKmeans(5, data_set, cluster_centers_3);
-  assert(cluster_centers_3->ClusterCenter(0).ValueOf(1) == 1.0);
-  assert(cluster_centers_3->ClusterCenter(0).ValueOf(2) == 0.0);
-  assert(cluster_centers_3->ClusterCenter(0).ValueOf(3) == 1.0);
-  assert(cluster_centers_3->ClusterCenter(1).ValueOf(1) == 1.0);
-  assert(cluster_centers_3->ClusterCenter(1).ValueOf(2) == 0.0);
-  assert(cluster_centers_3->ClusterCenter(1).ValueOf(3) == 0.0);
-  assert(cluster_centers_3->ClusterCenter(2).ValueOf(1) == 0.0);
-  assert(cluster_centers_3->ClusterCenter(2).ValueOf(2) == 1.0);
-  assert(cluster_centers_3->ClusterCenter(2).ValueOf(3) == 0.0);
-
-  SfClusterCenters* cluster_centers_4 = new SfClusterCenters(5);
-  srand(105);  // Use a fixed seed for deterministic testing.
-  sofia_cluster::InitializeWithKRandomCenters(3, data_set, cluster_centers_4);
-  sofia_cluster::SGDKmeans(1000, data_set, cluster_centers_4);
-  assert(cluster_centers_4->ClusterCenter(0).ValueOf(1) < 1.01 &&
-	 cluster_centers_4->ClusterCenter(0).ValueOf(1) > 0.99);
-  assert(cluster_centers_4->ClusterCenter(0).ValueOf(2) == 0.0);
-  assert(cluster_centers_4->ClusterCenter(0).ValueOf(3) < 1.01 &&
-	 cluster_centers_4->ClusterCenter(0).ValueOf(3) > 0.99);
-
-  assert(cluster_centers_4->ClusterCenter(1).ValueOf(1) < 1.01 &&
-	 cluster_centers_4->ClusterCenter(1).ValueOf(1) > 0.99);
-  assert(cluster_centers_4->ClusterCenter(1).ValueOf(2) == 0.0);
-  assert(cluster_centers_4->ClusterCenter(1).ValueOf(3) == 0.0);
-
-  assert(cluster_centers_4->ClusterCenter(2).ValueOf(1) < 0.01 &&
-	 cluster_centers_4->ClusterCenter(2).ValueOf(1) >= 0);
-  assert(cluster_centers_4->ClusterCenter(2).ValueOf(2) < 1.01 &&
-	 cluster_centers_4->ClusterCenter(2).ValueOf(2) > 0.99);
-  assert(cluster_centers_4->ClusterCenter(2).ValueOf(3) == 0.0);
-
-  srand(100);
-  SfClusterCenters* cluster_centers_5 = new SfClusterCenters(5);
-  sofia_cluster::ClassicKmeansPlusPlus(3, data_set, cluster_centers_5);
-  assert(cluster_centers_5->ClusterCenter(0).ValueOf(1) == 0);
-  assert(cluster_centers_5->ClusterCenter(0).ValueOf(2) > 1.09 &&
-	 cluster_centers_5->ClusterCenter(0).ValueOf(2) < 1.11);
-  assert(cluster_centers_5->ClusterCenter(0).ValueOf(3) == 0);
-  assert(cluster_centers_5->ClusterCenter(1).ValueOf(1) > 1.09 &&
-	 cluster_centers_5->ClusterCenter(1).ValueOf(1) < 1.11);
-  assert(cluster_centers_5->ClusterCenter(1).ValueOf(2) == 0);
-  assert(cluster_centers_5->ClusterCenter(1).ValueOf(3) == 0);
-  assert(cluster_centers_5->ClusterCenter(2).ValueOf(1) > 1.09 &&
-	 cluster_centers_5->ClusterCenter(2).ValueOf(1) < 1.11);
-  assert(cluster_centers_5->ClusterCenter(2).ValueOf(2) == 0);
-  assert(cluster_centers_5->ClusterCenter(2).ValueOf(3) > 0.89 &&
-	 cluster_centers_5->ClusterCenter(2).ValueOf(3) < 0.91);
-
-  SfClusterCenters* cluster_centers_6 = new SfClusterCenters(5);
-  sofia_cluster::OptimizedKmeansPlusPlus(3, data_set, cluster_centers_6);
-  assert(cluster_centers_6->ClusterCenter(0).ValueOf(1) > 0.89 &&
-	 cluster_centers_6->ClusterCenter(0).ValueOf(1) < 0.91);
-  assert(cluster_centers_6->ClusterCenter(0).ValueOf(2) == 0);
-  assert(cluster_centers_6->ClusterCenter(0).ValueOf(3) == 0);
-  assert(cluster_centers_6->ClusterCenter(1).ValueOf(1) == 0);
-  assert(cluster_centers_6->ClusterCenter(1).ValueOf(2) > 1.09 &&
-	 cluster_centers_6->ClusterCenter(1).ValueOf(2) < 1.11);
-  assert(cluster_centers_6->ClusterCenter(1).ValueOf(3) == 0);
-  assert(cluster_centers_6->ClusterCenter(2).ValueOf(1) > 0.89 &&
-	 cluster_centers_6->ClusterCenter(2).ValueOf(1) < 0.91);
-  assert(cluster_centers_6->ClusterCenter(2).ValueOf(2) == 0);
-  assert(cluster_centers_6->ClusterCenter(2).ValueOf(3) > 1.09 &&
-	 cluster_centers_6->ClusterCenter(2).ValueOf(3) < 1.11);
-
-  SfClusterCenters* cluster_centers_7 = new SfClusterCenters(5);
-  sofia_cluster::SamplingKmeansPlusPlus(3, 10, data_set, cluster_centers_7);
-  assert(cluster_centers_7->ClusterCenter(0).ValueOf(1) > 0.89 &&
-	 cluster_centers_7->ClusterCenter(0).ValueOf(1) < 0.91);
-  assert(cluster_centers_7->ClusterCenter(0).ValueOf(2) == 0);
-  assert(cluster_centers_7->ClusterCenter(0).ValueOf(3) == 0);
-  assert(cluster_centers_7->ClusterCenter(1).ValueOf(1) == 0);
-  assert(cluster_centers_7->ClusterCenter(1).ValueOf(2) > 1.09 &&
-	 cluster_centers_7->ClusterCenter(1).ValueOf(2) < 1.11);
-  assert(cluster_centers_7->ClusterCenter(1).ValueOf(3) == 0);
-  assert(cluster_centers_7->ClusterCenter(2).ValueOf(1) > 0.99 &&
-	 cluster_centers_7->ClusterCenter(2).ValueOf(1) < 1.01);
-  assert(cluster_centers_7->ClusterCenter(2).ValueOf(2) == 0);
-  assert(cluster_centers_7->ClusterCenter(2).ValueOf(3) > 0.99 &&
-	 cluster_centers_7->ClusterCenter(2).ValueOf(3) < 1.01);
-
-  float kmeans_objective_7 = 
-   sofia_cluster::KmeansObjective(data_set, *cluster_centers_7);
-  assert(kmeans_objective_7 > 0.139 && kmeans_objective_7 < 0.141);
-  
-  sofia_cluster::SGDKmeans(1000, data_set, cluster_centers_7);
-  float improved_kmeans_objective_7 = 
-    sofia_cluster::KmeansObjective(data_set, *cluster_centers_7);
-  assert(improved_kmeans_objective_7 < kmeans_objective_7);
+  // SfRandom draws the same values on every platform, so a fixed seed
+  // gives fixed centers.
+  {
+    SfRandom random_3(100);
+    SfClusterCenters cluster_centers_3(10);
+    sofia_cluster::InitializeWithKRandomCenters(3, data_set, &random_3,
+						&cluster_centers_3);
+    sofia_cluster::BatchKmeans(5, data_set, &random_3, &cluster_centers_3);
+    assert(cluster_centers_3.ClusterCenter(0).ValueOf(1) == 1.0);
+    assert(cluster_centers_3.ClusterCenter(0).ValueOf(2) == 0.0);
+    assert(cluster_centers_3.ClusterCenter(0).ValueOf(3) == 1.0);
+    assert(cluster_centers_3.ClusterCenter(1).ValueOf(1) == 1.0);
+    assert(cluster_centers_3.ClusterCenter(1).ValueOf(2) == 0.0);
+    assert(cluster_centers_3.ClusterCenter(1).ValueOf(3) == 0.0);
+    assert(cluster_centers_3.ClusterCenter(2).ValueOf(1) == 0.0);
+    assert(cluster_centers_3.ClusterCenter(2).ValueOf(2) == 1.0);
+    assert(cluster_centers_3.ClusterCenter(2).ValueOf(3) == 0.0);
+
+    SfRandom random_4(100);
+    SfClusterCenters cluster_centers_4(5);
+    sofia_cluster::InitializeWithKRandomCenters(3, data_set, &random_4,
+						&cluster_centers_4);
+    float random_objective_4 =
+      sofia_cluster::KmeansObjective(data_set, cluster_centers_4);
+    assert(random_objective_4 > 0.199 && random_objective_4 < 0.201);
+    sofia_cluster::SGDKmeans(1000, data_set, &random_4, &cluster_centers_4);
+    assert(cluster_centers_4.ClusterCenter(0).ValueOf(1) < 1.01 &&
+	   cluster_centers_4.ClusterCenter(0).ValueOf(1) > 0.99);
+    assert(cluster_centers_4.ClusterCenter(0).ValueOf(2) == 0.0);
+    assert(cluster_centers_4.ClusterCenter(0).ValueOf(3) < 1.01 &&
+	   cluster_centers_4.ClusterCenter(0).ValueOf(3) > 0.99);
+    assert(cluster_centers_4.ClusterCenter(1).ValueOf(1) < 1.01 &&
+	   cluster_centers_4.ClusterCenter(1).ValueOf(1) > 0.99);
+    assert(cluster_centers_4.ClusterCenter(1).ValueOf(2) == 0.0);
+    assert(cluster_centers_4.ClusterCenter(1).ValueOf(3) == 0.0);
+    assert(cluster_centers_4.ClusterCenter(2).ValueOf(1) == 0.0);
+    assert(cluster_centers_4.ClusterCenter(2).ValueOf(2) < 1.01 &&
+	   cluster_centers_4.ClusterCenter(2).ValueOf(2) > 0.99);
+    assert(cluster_centers_4.ClusterCenter(2).ValueOf(3) == 0.0);
+    assert(sofia_cluster::KmeansObjective(data_set, cluster_centers_4) <
+	   random_objective_4);
+
+    SfRandom random_5(100);
+    SfClusterCenters cluster_centers_5(5);
+    sofia_cluster::ClassicKmeansPlusPlus(3, data_set, &random_5,
+					 &cluster_centers_5);
+    assert(cluster_centers_5.ClusterCenter(0).ValueOf(1) > 1.09 &&
+	   cluster_centers_5.ClusterCenter(0).ValueOf(1) < 1.11);
+    assert(cluster_centers_5.ClusterCenter(0).ValueOf(2) == 0);
+    assert(cluster_centers_5.ClusterCenter(0).ValueOf(3) > 0.89 &&
+	   cluster_centers_5.ClusterCenter(0).ValueOf(3) < 0.91);
+    assert(cluster_centers_5.ClusterCenter(1).ValueOf(1) == 0);
+    assert(cluster_centers_5.ClusterCenter(1).ValueOf(2) == 1.0);
+    assert(cluster_centers_5.ClusterCenter(1).ValueOf(3) == 0);
+    assert(cluster_centers_5.ClusterCenter(2).ValueOf(1) > 0.89 &&
+	   cluster_centers_5.ClusterCenter(2).ValueOf(1) < 0.91);
+    assert(cluster_centers_5.ClusterCenter(2).ValueOf(2) == 0);
+    assert(cluster_centers_5.ClusterCenter(2).ValueOf(3) == 0);
+
+    SfClusterCenters cluster_centers_6(5);
+    sofia_cluster::OptimizedKmeansPlusPlus(3, data_set, &random_5,
+					   &cluster_centers_6);
+    assert(cluster_centers_6.ClusterCenter(0).ValueOf(1) == 1.0);
+    assert(cluster_centers_6.ClusterCenter(0).ValueOf(2) == 0);
+    assert(cluster_centers_6.ClusterCenter(0).ValueOf(3) == 1.0);
+    assert(cluster_centers_6.ClusterCenter(1).ValueOf(1) == 0);
+    assert(cluster_centers_6.ClusterCenter(1).ValueOf(2) > 1.09 &&
+	   cluster_centers_6.ClusterCenter(1).ValueOf(2) < 1.11);
+    assert(cluster_centers_6.ClusterCenter(1).ValueOf(3) == 0);
+    assert(cluster_centers_6.ClusterCenter(2).ValueOf(1) == 1.0);
+    assert(cluster_centers_6.ClusterCenter(2).ValueOf(2) == 0);
+    assert(cluster_centers_6.ClusterCenter(2).ValueOf(3) == 0);
+
+    SfClusterCenters cluster_centers_7(5);
+    sofia_cluster::SamplingKmeansPlusPlus(3, 10, data_set, &random_5,
+					  &cluster_centers_7);
+    assert(cluster_centers_7.ClusterCenter(0).ValueOf(1) == 1.0);
+    assert(cluster_centers_7.ClusterCenter(0).ValueOf(2) == 0);
+    assert(cluster_centers_7.ClusterCenter(0).ValueOf(3) == 0);
+    assert(cluster_centers_7.ClusterCenter(1).ValueOf(1) == 1.0);
+    assert(cluster_centers_7.ClusterCenter(1).ValueOf(2) == 0);
+    assert(cluster_centers_7.ClusterCenter(1).ValueOf(3) == 1.0);
+    assert(cluster_centers_7.ClusterCenter(2).ValueOf(1) == 0);
+    assert(cluster_centers_7.ClusterCenter(2).ValueOf(2) > 0.89 &&
+	   cluster_centers_7.ClusterCenter(2).ValueOf(2) < 0.91);
+    assert(cluster_centers_7.ClusterCenter(2).ValueOf(3) == 0);
+
+    float kmeans_objective_7 =
+      sofia_cluster::KmeansObjective(data_set, cluster_centers_7);
+    assert(kmeans_objective_7 > 0.109 && kmeans_objective_7 < 0.111);
+    sofia_cluster::SGDKmeans(1000, data_set, &random_5, &cluster_centers_7);
+    float improved_kmeans_objective_7 =
+      sofia_cluster::KmeansObjective(data_set, cluster_centers_7);
+    assert(improved_kmeans_objective_7 < kmeans_objective_7);
+  }
+
+  // The rest holds whichever examples are sampled, so it is checked for
+  // several seeds.
+  for (int seed = 1; seed <= 10; ++seed) {
+    SfRandom random_3(seed);
+
+    // Batch k-means never increases the objective of its starting centers.
+    SfClusterCenters cluster_centers_3(10);
+    sofia_cluster::InitializeWithKRandomCenters(3, data_set, &random_3,
+						&cluster_centers_3);
+    assert(cluster_centers_3.Size() == 3);
+    assert(CentersAreExamples(data_set, cluster_centers_3));
+    float random_objective_3 =
+      sofia_cluster::KmeansObjective(data_set, cluster_centers_3);
+    sofia_cluster::BatchKmeans(5, data_set, &random_3, &cluster_centers_3);
+    assert(sofia_cluster::KmeansObjective(data_set, cluster_centers_3) <=
+	   random_objective_3);
+
+    // SGD k-means ends at least as good as it started, less a little
+    // sampling noise when it started at the optimum.
+    SfClusterCenters cluster_centers_4(5);
+    sofia_cluster::InitializeWithKRandomCenters(3, data_set, &random_3,
+						&cluster_centers_4);
+    float random_objective_4 =
+      sofia_cluster::KmeansObjective(data_set, cluster_centers_4);
+    sofia_cluster::SGDKmeans(1000, data_set, &random_3, &cluster_centers_4);
+    assert(sofia_cluster::KmeansObjective(data_set, cluster_centers_4) <
+	   random_objective_4 * 1.02);
+
+    // Each k-means++ variant picks its centers from the examples.
+    SfClusterCenters cluster_centers_5(5);
+    sofia_cluster::ClassicKmeansPlusPlus(3, data_set, &random_3,
+					 &cluster_centers_5);
+    assert(cluster_centers_5.Size() == 3);
+    assert(CentersAreExamples(data_set, cluster_centers_5));
+
+    SfClusterCenters cluster_centers_6(5);
+    sofia_cluster::OptimizedKmeansPlusPlus(3, data_set, &random_3,
+					   &cluster_centers_6);
+    assert(cluster_centers_6.Size() == 3);
+    assert(CentersAreExamples(data_set, cluster_centers_6));
+
+    SfClusterCenters cluster_centers_7(5);
+    sofia_cluster::SamplingKmeansPlusPlus(3, 10, data_set, &random_3,
+					  &cluster_centers_7);
+    assert(cluster_centers_7.Size() == 3);
+    assert(CentersAreExamples(data_set, cluster_centers_7));
+
+    // The same holds from k-means++ centers, and SGD k-means keeps the
+    // centers within the examples' bounding box.
+    float kmeans_objective_7 = 
+      sofia_cluster::KmeansObjective(data_set, cluster_centers_7);
+    sofia_cluster::SGDKmeans(1000, data_set, &random_3, &cluster_centers_7);
+    float improved_kmeans_objective_7 = 
+      sofia_cluster::KmeansObjective(data_set, cluster_centers_7);
+    assert(improved_kmeans_objective_7 < kmeans_objective_7 * 1.02);
+    for (int i = 0; i < cluster_centers_7.Size(); ++i) {
+      for (int j = 1; j <= 3; ++j) {
+	assert(cluster_centers_7.ClusterCenter(i).ValueOf(j) >= 0.0 &&
+	       cluster_centers_7.ClusterCenter(i).ValueOf(j) <= 1.1 + 0.0001);
+      }
+    }
+  }
  
   std::cout << argv[0] << ": PASS" << std::endl;
 }
@@ -28,13 +28,18 @@
 
 #include "sf-cluster-centers.h"
 #include "sf-kmeans-methods.h"
+#include "../src/sf-sparse-dot.h"
 #include "../src/simple-cmd-line-helper.h"
 
 using std::string;
 
 void CommandLine(int argc, char** argv) {
-  AddFlag("--training_file", "File to be used for training.", string(""));
-  AddFlag("--test_file", "File to be used for testing.", string(""));
+  AddFlag("--training_file",
+	  "File to be used for training.  Use - to read standard input.",
+	  string(""));
+  AddFlag("--test_file",
+	  "File to be used for testing.  Use - to read standard input.",
+	  string(""));
   AddFlag("--model_in", "Read in a model from this file.", string(""));
   AddFlag("--model_out", "Write the model to this file.", string(""));
   AddFlag("--cluster_assignments_out",
@@ -103,12 +108,22 @@ void CommandLine(int argc, char** argv) {
           int(100000));
   AddFlag("--buffer_mb",
           "Size of buffer to use in reading/writing to files, in MB.\n"
+          "    Memory-mapped input files release each --buffer_mb of parsed input\n"
+          "    from memory as they are read.\n"
           "    Default: 40",
           int(40));
+  AddFlag("--parse_threads",
+          "Number of threads to use in parsing each memory-mapped data file.\n"
+          "    Examples keep the order in which they appear in the file.\n"
+          "    Default: 1",
+          int(1));
   AddFlag("--dimensionality",
-          "Index value of largest feature index in training data set. \n"
-          "    Default: 2^17 = 131072",
-          int(2<<16));
+          "Largest allowed feature index plus one.  The cluster centers are\n"
+          "    sized to fit the largest feature index in the training data; if\n"
+          "    that is at least this value, loading the data fails rather than\n"
+          "    training.\n"
+          "    Default of 0 sets no limit.",
+          int(0));
   AddFlag("--no_bias_term",
           "When set, causes a bias term x_0 to be set to 0 for every \n"
           "    feature vector loaded from files, rather than the default \n"
@@ -142,6 +157,13 @@ void CommandLine(int argc, char** argv) {
 	  "    to perform exact projection.",
 	  float(0.0));
 
+  AddFlag("--sequential_inner_products",
+	  "Sum the terms of each inner product one at a time, left to right, as\n"
+	  "    earlier versions did, so that their results are reproduced\n"
+	  "    bit-for-bit.  By default the terms are summed in 8 interleaved lanes,\n"
+	  "    using AVX2 or AVX-512 where the CPU supports them.\n"
+	  "    Default: not set.",
+	  bool(false));
   ParseFlags(argc, argv);
 }
 
@@ -151,6 +173,7 @@ void PrintElapsedTime(clock_t start, const string& message) {
 }
 
 void InitializeCenters(const SfDataSet& data_set,
+		       SfRandom* random,
 		       SfClusterCenters* cluster_centers) {
   if (CMD_LINE_INTS["--k"] <= 0) {
     std::cerr << "--k must be greater than 0." << std::endl;
@@ -162,28 +185,34 @@ void InitializeCenters(const SfDataSet& data_set,
   if (CMD_LINE_STRINGS["--init_type"] == "random") {
     sofia_cluster::InitializeWithKRandomCenters(CMD_LINE_INTS["--k"],
 						data_set,
+						random,
 						cluster_centers);
   } else if (CMD_LINE_STRINGS["--init_type"] == "kmeans_pp") {
     sofia_cluster::ClassicKmeansPlusPlus(CMD_LINE_INTS["--k"],
 					 data_set,
+					 random,
 					 cluster_centers);
   } else if (CMD_LINE_STRINGS["--init_type"] == "optimized_kmeans_pp") {
     sofia_cluster::OptimizedKmeansPlusPlus(CMD_LINE_INTS["--k"],
 					   data_set,
+					   random,
 					   cluster_centers);
   } else if (CMD_LINE_STRINGS["--init_type"] == "optimized_kmeans_pp_ti") {
     sofia_cluster::OptimizedKmeansPlusPlusTI(CMD_LINE_INTS["--k"],
 					   data_set,
+					   random,
 					   cluster_centers);
   } else if (CMD_LINE_STRINGS["--init_type"] == "sampling_kmeans_pp") {
     sofia_cluster::SamplingKmeansPlusPlus(CMD_LINE_INTS["--k"],
 					  CMD_LINE_INTS["--sample_size"],
 					  data_set,
+					  random,
 					  cluster_centers);
   } else if (CMD_LINE_STRINGS["--init_type"] == "sampling_farthest") {
     sofia_cluster::SamplingFarthestFirst(CMD_LINE_INTS["--k"],
 					 CMD_LINE_INTS["--sample_size"],
 					 data_set,
+					 random,
 					 cluster_centers);
   } else { 
     std::cerr << "--init_type " << CMD_LINE_STRINGS["--init_type"]
@@ -196,6 +225,7 @@ void InitializeCenters(const SfDataSet& data_set,
 
 
 void OptimizeCenters(const SfDataSet& data_set,
+		     SfRandom* random,
 		       SfClusterCenters* cluster_centers) {
   if (CMD_LINE_INTS["--iterations"] < 0) {
     std::cerr << "--iterations must be non-negative." << std::endl;
@@ -207,12 +237,14 @@ void OptimizeCenters(const SfDataSet& data_set,
   if (CMD_LINE_STRINGS["--opt_type"] == "batch_kmeans") {
     sofia_cluster::BatchKmeans(CMD_LINE_INTS["--iterations"],
 			       data_set,
+			       random,
 			       cluster_centers,
 			       CMD_LINE_FLOATS["--L1_lambda"],
 			       CMD_LINE_FLOATS["--L1_epsilon"]);
   } else if (CMD_LINE_STRINGS["--opt_type"] == "sgd_kmeans") {
     sofia_cluster::SGDKmeans(CMD_LINE_INTS["--iterations"],
 			     data_set,
+			     random,
 			     cluster_centers,
 			     CMD_LINE_FLOATS["--L1_lambda"],
 			     CMD_LINE_FLOATS["--L1_epsilon"]);
@@ -220,6 +252,7 @@ void OptimizeCenters(const SfDataSet& data_set,
     sofia_cluster::MiniBatchKmeans(CMD_LINE_INTS["--iterations"],
 				   CMD_LINE_INTS["--mini_batch_size"],
 				   data_set,
+				   random,
 				   cluster_centers,
 				   CMD_LINE_FLOATS["--L1_lambda"],
 				   CMD_LINE_FLOATS["--L1_epsilon"]);
@@ -250,12 +283,28 @@ SfDataSet* NewDataSet(const string& file_name) {
   clock_t read_data_start = clock();
   SfDataSet* data_set = new SfDataSet(file_name,
 				      CMD_LINE_INTS["--buffer_mb"],
-				      !CMD_LINE_BOOLS["--no_bias_term"]);
+				      !CMD_LINE_BOOLS["--no_bias_term"],
+				      CMD_LINE_INTS["--parse_threads"]);
   PrintElapsedTime(read_data_start,
 		   "Time to read training data from " + file_name + ": ");  
   return data_set;
 }
 
+// Grows cluster_centers to fit the feature ids of training_data, exiting
+// if they reach the --dimensionality limit.
+void FitDimensionality(const SfDataSet& training_data,
+		       SfClusterCenters* cluster_centers) {
+  int max_feature_id = training_data.MaxFeatureId();
+  if (CMD_LINE_INTS["--dimensionality"] > 0 &&
+      max_feature_id >= CMD_LINE_INTS["--dimensionality"]) {
+    std::cerr << "Feature id " << max_feature_id
+	      << " exceeds the maximum dimensionality of "
+	      << CMD_LINE_INTS["--dimensionality"] << std::endl;
+    exit(1);
+  }
+  cluster_centers->GrowToFit(max_feature_id);
+}
+
 void LoadModelFromFile(const string& file_name,
 		       SfClusterCenters** cluster_centers) {
   if (*cluster_centers != NULL) delete *cluster_centers;
@@ -281,16 +330,21 @@ void SaveModelToFile(const string& file_name,
 int main (int argc, char** argv) {
   CommandLine(argc, argv);
   
-  if (CMD_LINE_INTS["--random_seed"] == 0) {
-    srand(time(NULL));
+  if (CMD_LINE_BOOLS["--sequential_inner_products"]) {
+    SfSetSparseDotOrder(SF_SEQUENTIAL_ORDER);
+  }
+
+  unsigned int random_seed = CMD_LINE_INTS["--random_seed"];
+  if (random_seed == 0) {
+    random_seed = time(NULL);
   } else {
     std::cerr << "Using random_seed: "
 	      << CMD_LINE_INTS["--random_seed"] << std::endl;
-    srand(CMD_LINE_INTS["--random_seed"]);
   }
+  SfRandom random(random_seed);
 
-  SfClusterCenters* cluster_centers =
-    new SfClusterCenters(CMD_LINE_INTS["--dimensionality"]);
+  // Set up empty model, which grows to fit the data it is used on.
+  SfClusterCenters* cluster_centers = new SfClusterCenters(1);
   
   // Load model (overwriting empty model), if needed.
   if (!CMD_LINE_STRINGS["--model_in"].empty()) {
@@ -300,13 +354,14 @@ int main (int argc, char** argv) {
   // Train model, if needed.
   if (!CMD_LINE_STRINGS["--training_file"].empty()) {
     SfDataSet* training_data = NewDataSet(CMD_LINE_STRINGS["--training_file"]);
+    FitDimensionality(*training_data, cluster_centers);
 
-    InitializeCenters(*training_data, cluster_centers);
+    InitializeCenters(*training_data, &random, cluster_centers);
     if (CMD_LINE_BOOLS["--objective_after_init"]) {
       ComputeObjective(*training_data, *cluster_centers, "initialization");
     }
 
-    OptimizeCenters(*training_data, cluster_centers);
+    OptimizeCenters(*training_data, &random, cluster_centers);
     if (CMD_LINE_BOOLS["--objective_after_training"]) {
       ComputeObjective(*training_data, *cluster_centers, "training");
     }
@@ -320,6 +375,8 @@ int main (int argc, char** argv) {
   // Test cluster centers, if needed.
   if (!CMD_LINE_STRINGS["--test_file"].empty()) {
     SfDataSet* test_data = NewDataSet(CMD_LINE_STRINGS["--test_file"]);
+    // Features never seen in training are zero in every center.
+    cluster_centers->GrowToFit(test_data->MaxFeatureId());
     if (CMD_LINE_BOOLS["--objective_on_test"]) {
       ComputeObjective(*test_data, *cluster_centers, "test");
     }
@@ -376,6 +433,7 @@ int main (int argc, char** argv) {
       for (int i = 0; i < test_data->NumExamples(); ++i) {
 	SfSparseVector* x_t =
 	  cluster_centers->MapVectorToCenters(test_data->VectorAt(i), type, p);
+	x_t->SetComment(test_data->CommentAt(i));
 	mapping_stream << x_t->AsString() << std::endl;
 	delete x_t;
       }
@@ -0,0 +1,124 @@
+//================================================================================//
+// Copyright 2026 The sofia-ml Authors                                            //
+//                                                                                //
+// Licensed under the Apache License, Version 2.0 (the "License");                //
+// you may not use this file except in compliance with the License.               //
+// You may obtain a copy of the License at                                        //
+//                                                                                //
+//      http://www.apache.org/licenses/LICENSE-2.0                                //
+//                                                                                //
+// Unless required by applicable law or agreed to in writing, software            //
+// distributed under the License is distributed on an "AS IS" BASIS,              //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.       //
+// See the License for the specific language governing permissions and            //
+// limitations under the License.                                                 //
+//================================================================================//
+//
+// sf-background-reader.cc
+//
+// Implementation of sf-background-reader.h
+
+#include <cstdlib>
+#include <iostream>
+
+#include "sf-background-reader.h"
+
+//----------------------------------------------------------------//
+//--------------- SfBackgroundReader Public Methods --------------//
+//----------------------------------------------------------------//
+
+SfBackgroundReader::SfBackgroundReader(const string& file_name,
+				       int buffer_mb,
+				       bool use_bias_term,
+				       int batch_size,
+				       int max_queued_batches)
+  : line_reader_(file_name, buffer_mb * 1024L * 1024L),
+    use_bias_term_(use_bias_term),
+    batch_size_(batch_size < 1 ? 1 : batch_size),
+    max_queued_batches_(max_queued_batches < 1 ? 1 : max_queued_batches),
+    done_(false),
+    stopping_(false) {
+  pthread_mutex_init(&mutex_, NULL);
+  pthread_cond_init(&batch_queued_, NULL);
+  pthread_cond_init(&batch_taken_, NULL);
+  if (pthread_create(&thread_, NULL, RunReadBatches, this) != 0) {
+    std::cerr << "Error creating reading thread." << std::endl;
+    exit(1);
+  }
+}
+
+SfBackgroundReader::~SfBackgroundReader() {
+  pthread_mutex_lock(&mutex_);
+  stopping_ = true;
+  pthread_cond_signal(&batch_taken_);
+  pthread_mutex_unlock(&mutex_);
+  pthread_join(thread_, NULL);
+
+  while (!queue_.empty()) {
+    delete queue_.front();
+    queue_.pop_front();
+  }
+  pthread_cond_destroy(&batch_taken_);
+  pthread_cond_destroy(&batch_queued_);
+  pthread_mutex_destroy(&mutex_);
+}
+
+SfDataSet* SfBackgroundReader::NextBatch() {
+  pthread_mutex_lock(&mutex_);
+  while (queue_.empty() && !done_) {
+    pthread_cond_wait(&batch_queued_, &mutex_);
+  }
+  SfDataSet* batch = NULL;
+  if (!queue_.empty()) {
+    batch = queue_.front();
+    queue_.pop_front();
+    pthread_cond_signal(&batch_taken_);
+  }
+  pthread_mutex_unlock(&mutex_);
+  return batch;
+}
+
+//----------------------------------------------------------------//
+//-------------- SfBackgroundReader Private Methods --------------//
+//----------------------------------------------------------------//
+
+void* SfBackgroundReader::RunReadBatches(void* reader) {
+  static_cast<SfBackgroundReader*>(reader)->ReadBatches();
+  return NULL;
+}
+
+void SfBackgroundReader::ReadBatches() {
+  const char* line_begin;
+  const char* line_end;
+  bool at_end = false;
+  while (!at_end) {
+    // Parse the batch without holding the lock, so that the consumer may
+    // take earlier batches meanwhile.
+    SfDataSet* batch = new SfDataSet(use_bias_term_);
+    while (batch->NumExamples() < batch_size_) {
+      if (!line_reader_.NextLine(&line_begin, &line_end)) {
+	at_end = true;
+	break;
+      }
+      batch->AddVector(line_begin, line_end);
+    }
+
+    pthread_mutex_lock(&mutex_);
+    while (queue_.size() >= max_queued_batches_ && !stopping_) {
+      pthread_cond_wait(&batch_taken_, &mutex_);
+    }
+    if (stopping_) {
+      pthread_mutex_unlock(&mutex_);
+      delete batch;
+      return;
+    }
+    if (batch->NumExamples() > 0) {
+      queue_.push_back(batch);
+    } else {
+      delete batch;
+    }
+    done_ = at_end;
+    pthread_cond_signal(&batch_queued_);
+    pthread_mutex_unlock(&mutex_);
+  }
+}
@@ -0,0 +1,87 @@
+//================================================================================//
+// Copyright 2026 The sofia-ml Authors                                            //
+//                                                                                //
+// Licensed under the Apache License, Version 2.0 (the "License");                //
+// you may not use this file except in compliance with the License.               //
+// You may obtain a copy of the License at                                        //
+//                                                                                //
+//      http://www.apache.org/licenses/LICENSE-2.0                                //
+//                                                                                //
+// Unless required by applicable law or agreed to in writing, software            //
+// distributed under the License is distributed on an "AS IS" BASIS,              //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.       //
+// See the License for the specific language governing permissions and            //
+// limitations under the License.                                                 //
+//================================================================================//
+//
+// sf-background-reader.h
+//
+// Reads and parses a data file on a background thread, handing the parsed
+// examples over in batches through a bounded queue.  This lets a caller
+// train on a stream of examples while the next examples are being read
+// and parsed, so that the time taken is about the larger of the reading
+// time and the training time, rather than their sum.
+
+#ifndef SF_BACKGROUND_READER_H__
+#define SF_BACKGROUND_READER_H__
+
+#include <pthread.h>
+#include <deque>
+#include <string>
+
+#include "sf-data-set.h"
+#include "sf-line-reader.h"
+
+using std::string;
+
+class SfBackgroundReader {
+ public:
+  // Opens file_name, exiting if it can not be opened, and starts reading it
+  // through a buffer of buffer_mb megabytes on a new thread.  Each batch
+  // holds batch_size examples, except perhaps the last, and at most
+  // max_queued_batches parsed batches wait in the queue at any time.
+  SfBackgroundReader(const string& file_name,
+		     int buffer_mb,
+		     bool use_bias_term,
+		     int batch_size,
+		     int max_queued_batches);
+
+  // Stops the reading thread, even if the file has not all been read.
+  ~SfBackgroundReader();
+
+  // Returns the next batch of examples, in file order, waiting for it to be
+  // parsed if need be.  The caller takes ownership of the batch.  Returns
+  // NULL once the whole file has been returned.
+  SfDataSet* NextBatch();
+
+ private:
+  // Thread body, calling ReadBatches() on the given reader.
+  static void* RunReadBatches(void* reader);
+
+  // Parses the file into batches, adding them to the queue.
+  void ReadBatches();
+
+  SfLineReader line_reader_;
+  bool use_bias_term_;
+  int batch_size_;
+  unsigned int max_queued_batches_;
+
+  // Guarded by mutex_.
+  std::deque<SfDataSet*> queue_;
+  // True once the reading thread has queued its last batch.
+  bool done_;
+  // True once the reading thread should stop early.
+  bool stopping_;
+
+  pthread_mutex_t mutex_;
+  pthread_cond_t batch_queued_;
+  pthread_cond_t batch_taken_;
+  pthread_t thread_;
+
+  // Disallowed.
+  SfBackgroundReader();
+  SfBackgroundReader(const SfBackgroundReader&);
+  void operator=(const SfBackgroundReader&);
+};
+
+#endif  // SF_BACKGROUND_READER_H__
@@ -0,0 +1,52 @@
+//================================================================================//
+// Copyright 2026 The sofia-ml Authors                                            //
+//                                                                                //
+// Licensed under the Apache License, Version 2.0 (the "License");                //
+// you may not use this file except in compliance with the License.               //
+// You may obtain a copy of the License at                                        //
+//                                                                                //
+//      http://www.apache.org/licenses/LICENSE-2.0                                //
+//                                                                                //
+// Unless required by applicable law or agreed to in writing, software            //
+// distributed under the License is distributed on an "AS IS" BASIS,              //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.       //
+// See the License for the specific language governing permissions and            //
+// limitations under the License.                                                 //
+//================================================================================//
+//
+#include <assert.h>
+#include <iostream>
+#include "sf-background-reader.h"
+
+int main (int argc, char** argv) {
+  // Batches come back in file order, and then NULL, however small the
+  // batches and the queue.
+  SfBackgroundReader reader("sf-data-set_test.dat", 1, true, 1, 1);
+  SfDataSet* batch = reader.NextBatch();
+  assert(batch != NULL && batch->NumExamples() == 1);
+  assert(batch->VectorAt(0).GetY() == 1);
+  assert(batch->CommentAt(0) == "happy");
+  delete batch;
+  batch = reader.NextBatch();
+  assert(batch != NULL && batch->NumExamples() == 1);
+  assert(batch->VectorAt(0).GetY() == -1);
+  delete batch;
+  assert(reader.NextBatch() == NULL);
+  assert(reader.NextBatch() == NULL);
+
+  // A batch larger than the file holds the whole file.
+  SfBackgroundReader whole_file_reader("sf-data-set_test.dat", 1, false,
+				       100, 4);
+  batch = whole_file_reader.NextBatch();
+  assert(batch != NULL && batch->NumExamples() == 2);
+  assert(batch->VectorAt(0).ValueAt(0) == 0);
+  delete batch;
+  assert(whole_file_reader.NextBatch() == NULL);
+
+  // A reader may be destroyed before it has been read to the end.
+  {
+    SfBackgroundReader unread_reader("sf-data-set_test.dat", 1, true, 1, 1);
+  }
+
+  std::cout << argv[0] << ": PASS" << std::endl;
+}
@@ -22,66 +22,587 @@
 // Implementation of sf-data-set.h
 
 #include <assert.h>
+#include <pthread.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
 #include <cstdlib>
+#include <cstring>
 #include <iostream>
-#include <fstream>
 
 #include "sf-data-set.h"
+#include "sf-feature-map.h"
+#include "sf-gzip-reader.h"
+#include "sf-line-reader.h"
+#include "sf-mapped-file.h"
+
+// Identifies a binary data file.
+static const char kBinaryMagic[] = "SFDATA01";
 
 //----------------------------------------------------------------//
 //------------------ SfDataSet Public Methods --------------------//
 //----------------------------------------------------------------//
 
 SfDataSet::SfDataSet(bool use_bias_term)
-  : use_bias_term_(use_bias_term) {
+  : row_offsets_(1, 0),
+    comment_offsets_(1, 0),
+    max_feature_id_(0),
+    use_bias_term_(use_bias_term) {
 }
 
 SfDataSet::SfDataSet(const string& file_name,
 		     int buffer_mb,
 		     bool use_bias_term)
-  : use_bias_term_(use_bias_term) {
-  long int buffer_size = buffer_mb * 1024 * 1024;
-  char* local_buffer = new char[buffer_size];
-  std::ifstream file_stream(file_name.c_str(), std::ifstream::in);
-  file_stream.rdbuf()->pubsetbuf(local_buffer, buffer_size); 
-  if (!file_stream) {
-    std::cerr << "Error reading file " << file_name << std::endl;
-    exit(1);
-  }
+  : row_offsets_(1, 0),
+    comment_offsets_(1, 0),
+    max_feature_id_(0),
+    use_bias_term_(use_bias_term) {
+  AddVectorsFromFile(file_name, buffer_mb, 1);
+}
+
+SfDataSet::SfDataSet(const string& file_name,
+		     int buffer_mb,
+		     bool use_bias_term,
+		     int num_threads)
+  : row_offsets_(1, 0),
+    comment_offsets_(1, 0),
+    max_feature_id_(0),
+    use_bias_term_(use_bias_term) {
+  AddVectorsFromFile(file_name, buffer_mb, num_threads);
+}
 
-  string line_string;
-  while (getline(file_stream, line_string)) {
-    AddVector(line_string);
+SfDataSet::SfDataSet(const SfDataSet& data_set,
+		     const vector<long int>& examples)
+  : row_offsets_(1, 0),
+    comment_offsets_(1, 0),
+    max_feature_id_(0),
+    use_bias_term_(data_set.use_bias_term_) {
+  for (unsigned int e = 0; e < examples.size(); ++e) {
+    long int i = examples[e];
+    SfSparseVectorView x = data_set.VectorAt(i);
+    labels_.push_back(x.GetY());
+    squared_norms_.push_back(x.GetSquaredNorm());
+    features_.insert(features_.end(),
+		     x.Features(),
+		     x.Features() + x.NumFeatures());
+    if (x.MaxFeatureId() > max_feature_id_) max_feature_id_ = x.MaxFeatureId();
+    row_offsets_.push_back(features_.size());
+    groups_.push_back(InternGroupId(data_set.GroupIdAt(i)));
+    comments_.append(data_set.comments_,
+		     data_set.comment_offsets_[i],
+		     data_set.comment_offsets_[i + 1] -
+		     data_set.comment_offsets_[i]);
+    comment_offsets_.push_back(comments_.size());
   }
-  
-  delete[] local_buffer;
 }
 
 string SfDataSet::AsString() const {
   string out_string;
-  for (unsigned long int i = 0; i < vectors_.size(); ++i) {
-    out_string += VectorAt(i).AsString() + "\n";
+  for (long int i = 0; i < NumExamples(); ++i) {
+    SfSparseVector x(VectorAt(i));
+    x.SetComment(CommentAt(i));
+    out_string += x.AsString() + "\n";
   }
   return out_string;
 }
 
-const SfSparseVector& SfDataSet::VectorAt(long int index) const {
-  assert (index >= 0 &&
-	  static_cast<unsigned long int>(index) < vectors_.size());
-  return vectors_[index];
+string SfDataSet::CommentAt(long int index) const {
+  assert(index >= 0 && index < NumExamples());
+  return comments_.substr(comment_offsets_[index],
+			  comment_offsets_[index + 1] -
+			  comment_offsets_[index]);
 }
 
 void SfDataSet::AddVector(const string& vector_string) {
-  vectors_.push_back(SfSparseVector(vector_string.c_str(),
-				    use_bias_term_));
+  AddVector(vector_string.data(), vector_string.data() + vector_string.size());
 }
 
 void SfDataSet::AddVector(const char* vector_string) {
-  vectors_.push_back(SfSparseVector(vector_string,
-				    use_bias_term_));
+  AddVector(vector_string, vector_string + strlen(vector_string));
+}
+
+void SfDataSet::AddVector(const char* begin, const char* end) {
+  parsed_vector_.Parse(begin, end, use_bias_term_);
+  AppendVector(parsed_vector_, parsed_vector_.GetY());
 }
 
 void SfDataSet::AddLabeledVector(const SfSparseVector& x, float y) {
-  vectors_.push_back(x);
-  vectors_[vectors_.size() - 1].SetY(y);
+  AppendVector(x, y);
+}
+
+// Orders feature value pairs by increasing id.
+static bool LessById(const FeatureValuePair& a, const FeatureValuePair& b) {
+  return a.id_ < b.id_;
+}
+
+void SfDataSet::RemapFeatures(const SfFeatureMap& feature_map) {
+  long int num_kept = 0;
+  long int row_begin = 0;
+  max_feature_id_ = 0;
+  for (long int i = 0; i < NumExamples(); ++i) {
+    long int row_end = row_offsets_[i + 1];
+    long int kept_begin = num_kept;
+    for (long int j = row_begin; j < row_end; ++j) {
+      int dense_id = feature_map.DenseId(features_[j].id_);
+      if (dense_id == -1) continue;
+      features_[num_kept].id_ = dense_id;
+      features_[num_kept].value_ = features_[j].value_;
+      ++num_kept;
+      if (dense_id > max_feature_id_) max_feature_id_ = dense_id;
+    }
+    std::sort(features_.begin() + kept_begin,
+	      features_.begin() + num_kept,
+	      LessById);
+    if (num_kept - kept_begin < row_end - row_begin) {
+      float squared_norm = 0.0;
+      for (long int j = kept_begin; j < num_kept; ++j) {
+	squared_norm += features_[j].value_ * features_[j].value_;
+      }
+      squared_norms_[i] = squared_norm;
+    }
+    row_begin = row_end;
+    row_offsets_[i + 1] = num_kept;
+  }
+  features_.resize(num_kept);
+}
+
+// Writes count items of the given size to file, or exits.
+static void WriteOrDie(const void* data, size_t size, size_t count,
+		       FILE* file, const string& file_name) {
+  if (count > 0 && fwrite(data, size, count, file) != count) {
+    std::cerr << "Error writing file " << file_name << std::endl;
+    exit(1);
+  }
+}
+
+void SfDataSet::WriteBinaryFile(const string& file_name) const {
+  SfBinaryHeader header;
+  memcpy(header.magic, kBinaryMagic, sizeof(header.magic));
+  header.num_examples = NumExamples();
+  header.num_features = features_.size();
+  header.group_id_bytes = 0;
+  header.comment_bytes = comments_.size();
+  header.use_bias_term = use_bias_term_ ? 1 : 0;
+
+  // Group ids are interned in memory, but written out in full.
+  vector<long int> group_id_offsets(1, 0);
+  for (long int i = 0; i < NumExamples(); ++i) {
+    header.group_id_bytes += GroupIdAt(i).size();
+    group_id_offsets.push_back(header.group_id_bytes);
+  }
+
+  FILE* file = fopen(file_name.c_str(), "wb");
+  if (file == NULL) {
+    std::cerr << "Error writing file " << file_name << std::endl;
+    exit(1);
+  }
+  WriteOrDie(&header, sizeof(header), 1, file, file_name);
+  WriteOrDie(&row_offsets_[0], sizeof(long int), row_offsets_.size(),
+	     file, file_name);
+  WriteOrDie(&group_id_offsets[0], sizeof(long int), group_id_offsets.size(),
+	     file, file_name);
+  WriteOrDie(&comment_offsets_[0], sizeof(long int), comment_offsets_.size(),
+	     file, file_name);
+  WriteOrDie(FeaturesBegin(), sizeof(FeatureValuePair), features_.size(),
+	     file, file_name);
+  if (!labels_.empty()) {
+    WriteOrDie(&labels_[0], sizeof(float), labels_.size(), file, file_name);
+  }
+  for (long int i = 0; i < NumExamples(); ++i) {
+    const string& group_id = GroupIdAt(i);
+    WriteOrDie(group_id.data(), 1, group_id.size(), file, file_name);
+  }
+  WriteOrDie(comments_.data(), 1, comments_.size(), file, file_name);
+  if (fclose(file) != 0) {
+    std::cerr << "Error writing file " << file_name << std::endl;
+    exit(1);
+  }
+}
+
+//----------------------------------------------------------------//
+//---------------------- Parallel Loading ------------------------//
+//----------------------------------------------------------------//
+
+// Returns the start of the line after the one beginning at position.
+static const char* NextLineStart(const char* position, const char* end) {
+  const char* newline =
+    static_cast<const char*>(memchr(position, '\n', end - position));
+  return (newline == NULL) ? end : newline + 1;
+}
+
+void* SfDataSet::ParseChunkLines(void* chunk_ptr) {
+  ParseChunk* chunk = static_cast<ParseChunk*>(chunk_ptr);
+  const char* position = chunk->begin;
+  const char* released = chunk->begin;
+  bool reserved = false;
+  while (position < chunk->end) {
+    const char* next_line = NextLineStart(position, chunk->end);
+    const char* line_end = next_line;
+    if (line_end > position && line_end[-1] == '\n') --line_end;
+    chunk->data_set->AddVector(position, line_end);
+    position = next_line;
+
+    if (position - released >= chunk->release_interval) {
+      if (!reserved) {
+	chunk->data_set->ReserveForText(0, 0, position - chunk->begin,
+					chunk->end - chunk->begin);
+	reserved = true;
+      }
+      released = chunk->mapped_file->ReleaseRange(released, position);
+    }
+  }
+  return NULL;
+}
+
+//----------------------------------------------------------------//
+//------------------ SfDataSet Private Methods -------------------//
+//----------------------------------------------------------------//
+
+void SfDataSet::AppendVector(const SfSparseVector& x, float y) {
+  SfSparseVectorView x_view(x);
+  labels_.push_back(y);
+  squared_norms_.push_back(x_view.GetSquaredNorm());
+  features_.insert(features_.end(),
+		   x_view.Features(),
+		   x_view.Features() + x_view.NumFeatures());
+  int x_max_feature_id = x_view.MaxFeatureId();
+  if (x_max_feature_id > max_feature_id_) max_feature_id_ = x_max_feature_id;
+  row_offsets_.push_back(features_.size());
+  groups_.push_back(InternGroupId(x.GetGroupId()));
+  comments_ += x.GetComment();
+  comment_offsets_.push_back(comments_.size());
+}
+
+void SfDataSet::AppendDataSet(const SfDataSet& other) {
+  long int features_offset = features_.size();
+  long int comments_offset = comments_.size();
+  labels_.insert(labels_.end(), other.labels_.begin(), other.labels_.end());
+  squared_norms_.insert(squared_norms_.end(),
+			other.squared_norms_.begin(),
+			other.squared_norms_.end());
+  features_.insert(features_.end(),
+		   other.features_.begin(),
+		   other.features_.end());
+  comments_ += other.comments_;
+  if (other.max_feature_id_ > max_feature_id_) {
+    max_feature_id_ = other.max_feature_id_;
+  }
+
+  vector<int> other_group_to_group;
+  for (unsigned int i = 0; i < other.group_ids_.size(); ++i) {
+    other_group_to_group.push_back(InternGroupId(other.group_ids_[i]));
+  }
+  for (long int i = 0; i < other.NumExamples(); ++i) {
+    row_offsets_.push_back(features_offset + other.row_offsets_[i + 1]);
+    groups_.push_back(other_group_to_group[other.groups_[i]]);
+    comment_offsets_.push_back(comments_offset +
+			       other.comment_offsets_[i + 1]);
+  }
+}
+
+void SfDataSet::ReserveForText(long int num_examples,
+			       long int num_features,
+			       long int num_parsed_bytes,
+			       long int num_bytes) {
+  // Only the lines already parsed are looked at, as scanning ahead would
+  // read in pages before they can be released.  An estimate that falls
+  // short leaves the arrays to grow as usual.
+  if (num_parsed_bytes <= 0) return;
+  double scale = static_cast<double>(num_bytes) / num_parsed_bytes;
+  long int total_examples = num_examples +
+    static_cast<long int>((NumExamples() - num_examples) * scale);
+  long int total_features = num_features +
+    static_cast<long int>((features_.size() - num_features) * scale);
+  labels_.reserve(total_examples);
+  squared_norms_.reserve(total_examples);
+  row_offsets_.reserve(total_examples + 1);
+  groups_.reserve(total_examples);
+  comment_offsets_.reserve(total_examples + 1);
+  features_.reserve(total_features);
+}
+
+void SfDataSet::PartitionByLabel() const {
+  positives_.clear();
+  negatives_.clear();
+  for (long int i = 0; i < NumExamples(); ++i) {
+    if (labels_[i] > 0.0)
+      positives_.push_back(i);
+    else
+      negatives_.push_back(i);
+  }
+}
+
+int SfDataSet::InternGroupId(const string& group_id) {
+  // Examples of a group are usually consecutive, so try the last one first.
+  if (!groups_.empty() && group_ids_[groups_.back()] == group_id) {
+    return groups_.back();
+  }
+  std::map<string, int>::iterator iter = group_id_to_group_.find(group_id);
+  if (iter != group_id_to_group_.end()) return iter->second;
+  int group = group_ids_.size();
+  group_ids_.push_back(group_id);
+  group_id_to_group_[group_id] = group;
+  return group;
+}
+
+void SfDataSet::AddVectorsFromFile(const string& file_name,
+				   int buffer_mb,
+				   int num_threads) {
+  long int buffer_size = buffer_mb * 1024L * 1024L;
+  if (AddVectorsFromMappedFile(file_name, buffer_size, num_threads)) return;
+
+  // The file can not be mapped, so read it as a stream instead.
+  SfLineReader line_reader(file_name, buffer_size);
+  const char* line_begin;
+  const char* line_end;
+  while (line_reader.NextLine(&line_begin, &line_end)) {
+    AddVector(line_begin, line_end);
+  }
+}
+
+bool SfDataSet::AddVectorsFromMappedFile(const string& file_name,
+					 long int release_interval,
+					 int num_threads) {
+  SfMappedFile mapped_file;
+  if (!mapped_file.Open(file_name)) return false;
+  if (mapped_file.Size() >= static_cast<long int>(sizeof(SfBinaryHeader)) &&
+      memcmp(mapped_file.Begin(), kBinaryMagic, 8) == 0) {
+    AddVectorsFromBinary(mapped_file);
+    return true;
+  }
+  // Compressed data must be streamed through the decompressor instead.
+  if (SfGzipReader::IsGzip(mapped_file.Begin(), mapped_file.Size())) {
+    return false;
+  }
+
+  const char* position = mapped_file.Begin();
+  const char* end = mapped_file.End();
+  if (num_threads <= 1) {
+    const char* begin = position;
+    long int num_examples = NumExamples();
+    long int num_features = features_.size();
+    bool reserved = false;
+    const char* next_release = position + release_interval;
+    while (position < end) {
+      const char* newline =
+	static_cast<const char*>(memchr(position, '\n', end - position));
+      const char* line_end = (newline == NULL) ? end : newline;
+      AddVector(position, line_end);
+      position = (newline == NULL) ? end : newline + 1;
+
+      // Each line is parsed only once, so drop pages we are done with.
+      if (position >= next_release) {
+	if (!reserved) {
+	  ReserveForText(num_examples, num_features, position - begin,
+			 end - begin);
+	  reserved = true;
+	}
+	mapped_file.Release(position);
+	next_release = position + release_interval;
+      }
+    }
+    return true;
+  }
+
+  // Split the file into chunks of about equal size, moving each split
+  // point forward to the start of the next line, and parse each chunk
+  // into a data set of its own.
+  vector<ParseChunk> chunks(num_threads);
+  vector<pthread_t> threads(num_threads);
+  for (int i = 0; i < num_threads; ++i) {
+    ParseChunk& chunk = chunks[i];
+    chunk.begin = (i == 0) ? position : chunks[i - 1].end;
+    chunk.end = end;
+    if (i < num_threads - 1) {
+      const char* split = position + (end - position) / num_threads * (i + 1);
+      if (split > chunk.begin) chunk.end = NextLineStart(split - 1, end);
+      else chunk.end = chunk.begin;
+    }
+    chunk.data_set = new SfDataSet(use_bias_term_);
+    chunk.mapped_file = &mapped_file;
+    chunk.release_interval = release_interval;
+    if (pthread_create(&threads[i], NULL, ParseChunkLines, &chunk) != 0) {
+      std::cerr << "Error creating parsing thread." << std::endl;
+      exit(1);
+    }
+  }
+
+  // Splice the chunks back together in file order.
+  long int num_examples = NumExamples();
+  long int num_features = features_.size();
+  for (int i = 0; i < num_threads; ++i) {
+    pthread_join(threads[i], NULL);
+    num_examples += chunks[i].data_set->NumExamples();
+    num_features += chunks[i].data_set->features_.size();
+  }
+  labels_.reserve(num_examples);
+  squared_norms_.reserve(num_examples);
+  row_offsets_.reserve(num_examples + 1);
+  groups_.reserve(num_examples);
+  comment_offsets_.reserve(num_examples + 1);
+  features_.reserve(num_features);
+  for (int i = 0; i < num_threads; ++i) {
+    AppendDataSet(*chunks[i].data_set);
+    delete chunks[i].data_set;
+  }
+  return true;
+}
+
+// Exits if the binary data file is malformed.
+static void DieBinaryFormat() {
+  std::cerr << "Binary data file is truncated or corrupt." << std::endl;
+  exit(1);
+}
+
+// Exits unless offsets[0..n] are non-decreasing, from 0 to total.
+static void CheckOffsets(const long int* offsets, long int n, long int total) {
+  if (offsets[0] != 0 || offsets[n] != total) DieBinaryFormat();
+  for (long int i = 0; i < n; ++i) {
+    if (offsets[i] > offsets[i + 1]) DieBinaryFormat();
+  }
+}
+
+void SfDataSet::AddVectorsFromBinary(const SfMappedFile& mapped_file) {
+  SfBinaryHeader header;
+  memcpy(&header, mapped_file.Begin(), sizeof(header));
+  long int n = header.num_examples;
+  // Each count is bounded by the file size first, so that the sizes
+  // computed from them can not overflow.
+  long int size = mapped_file.Size();
+  if (n < 0 || n > size / static_cast<long int>(sizeof(long int)) ||
+      header.num_features < 0 ||
+      header.num_features >
+      size / static_cast<long int>(sizeof(FeatureValuePair)) ||
+      header.group_id_bytes < 0 || header.group_id_bytes > size ||
+      header.comment_bytes < 0 || header.comment_bytes > size ||
+      size !=
+      static_cast<long int>(sizeof(header) + 3 * (n + 1) * sizeof(long int) +
+			    header.num_features * sizeof(FeatureValuePair) +
+			    n * sizeof(float)) +
+      header.group_id_bytes + header.comment_bytes) {
+    DieBinaryFormat();
+  }
+
+  const char* position = mapped_file.Begin() + sizeof(header);
+  const long int* row_offsets = reinterpret_cast<const long int*>(position);
+  const long int* group_id_offsets = row_offsets + n + 1;
+  const long int* comment_offsets = group_id_offsets + n + 1;
+  const FeatureValuePair* features =
+    reinterpret_cast<const FeatureValuePair*>(comment_offsets + n + 1);
+  const float* labels =
+    reinterpret_cast<const float*>(features + header.num_features);
+  const char* group_ids = reinterpret_cast<const char*>(labels + n);
+  const char* comments = group_ids + header.group_id_bytes;
+  CheckOffsets(row_offsets, n, header.num_features);
+  CheckOffsets(group_id_offsets, n, header.group_id_bytes);
+  CheckOffsets(comment_offsets, n, header.comment_bytes);
+
+  // The arrays are copied across whole, except that the bias term, which
+  // is always the first feature of each example, is set as requested.
+  long int features_offset = features_.size();
+  long int comments_offset = comments_.size();
+  labels_.insert(labels_.end(), labels, labels + n);
+  features_.insert(features_.end(),
+		   features, features + header.num_features);
+  comments_.append(comments, header.comment_bytes);
+  float bias_value = use_bias_term_ ? 1.0 : 0.0;
+  for (long int i = 0; i < n; ++i) {
+    long int row_begin = features_offset + row_offsets[i];
+    long int row_end = features_offset + row_offsets[i + 1];
+    // Ids must be as SfSparseVector::PushPair() allows: the bias id 0
+    // first, perhaps again for an explicit 0: feature, then ascending.
+    if (row_end == row_begin || features_[row_begin].id_ != 0) {
+      DieBinaryFormat();
+    }
+    for (long int j = row_begin + 1; j < row_end; ++j) {
+      if (features_[j].id_ <= features_[j - 1].id_ &&
+	  !(features_[j].id_ == 0 && features_[j - 1].id_ == 0)) {
+	DieBinaryFormat();
+      }
+    }
+    features_[row_begin].value_ = bias_value;
+    // Sum in the same order as SfSparseVector::PushPair().
+    float squared_norm = 0.0;
+    for (long int j = row_begin; j < row_end; ++j) {
+      squared_norm += features_[j].value_ * features_[j].value_;
+      if (features_[j].id_ > max_feature_id_) {
+	max_feature_id_ = features_[j].id_;
+      }
+    }
+    squared_norms_.push_back(squared_norm);
+    row_offsets_.push_back(row_end);
+    groups_.push_back(InternGroupId(string(group_ids + group_id_offsets[i],
+					    group_ids +
+					    group_id_offsets[i + 1])));
+    comment_offsets_.push_back(comments_offset + comment_offsets[i + 1]);
+  }
+}
+
+//----------------------------------------------------------------//
+//----------------- SfRankIndex Public Methods -------------------//
+//----------------------------------------------------------------//
+
+// Orders examples by group, then by label.  Used with std::stable_sort, so
+// that examples with the same group and label stay in their original order.
+struct GroupThenLabelLess {
+  const vector<float>* labels;
+  const vector<int>* groups;
+  bool operator()(int a, int b) const {
+    if ((*groups)[a] != (*groups)[b]) return (*groups)[a] < (*groups)[b];
+    return (*labels)[a] < (*labels)[b];
+  }
+};
+
+void SfRankIndex::Build(const vector<float>& labels,
+			const vector<int>& groups) {
+  int num_examples = labels.size();
+  for (int i = 0; i < num_examples; ++i) {
+    if (!std::isfinite(labels[i])) {
+      std::cerr << "Rank loops need finite labels, but example " << i
+		<< " has label " << labels[i] << "." << std::endl;
+      exit(1);
+    }
+  }
+  order_.resize(num_examples);
+  for (int i = 0; i < num_examples; ++i) {
+    order_[i] = i;
+  }
+  GroupThenLabelLess less;
+  less.labels = &labels;
+  less.groups = &groups;
+  std::stable_sort(order_.begin(), order_.end(), less);
+
+  ranges_.resize(num_examples);
+  rankable_groups_.clear();
+  int group_begin = 0;
+  while (group_begin < num_examples) {
+    int group = groups[order_[group_begin]];
+    int group_end = group_begin;
+    while (group_end < num_examples && groups[order_[group_end]] == group) {
+      ++group_end;
+    }
+    int label_begin = group_begin;
+    while (label_begin < group_end) {
+      float label = labels[order_[label_begin]];
+      int label_end = label_begin + 1;
+      while (label_end < group_end && labels[order_[label_end]] == label) {
+	++label_end;
+      }
+      for (int i = label_begin; i < label_end; ++i) {
+	ExampleRange& range = ranges_[order_[i]];
+	range.group_begin = group_begin;
+	range.label_begin = label_begin;
+	range.label_end = label_end;
+	range.group_end = group_end;
+      }
+      label_begin = label_end;
+    }
+    if (NumPartners(order_[group_begin]) > 0) {
+      GroupRange rankable_group;
+      rankable_group.begin = group_begin;
+      rankable_group.end = group_end;
+      rankable_groups_.push_back(rankable_group);
+    }
+    group_begin = group_end;
+  }
 }
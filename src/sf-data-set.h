@@ -23,43 +23,354 @@
 // sf-sparse-vector.h.  Methods are provided for reading
 // a data set into memory from a file, and accessing individual
 // vectors within the data set.
+//
+// The examples are stored in compressed sparse row form: the features of
+// all examples lie end to end in one array, with parallel arrays of
+// labels and squared norms, and an array of offsets marking where each
+// example's features begin.  Group ids are interned, so that each example
+// stores only a small integer, and comments are pooled into one string.
+// VectorAt() returns a lightweight SfSparseVectorView of one example.
+//
+// Data files may be in svm-light text format, or in the binary format
+// written by WriteBinaryFile(), which is detected automatically and loads
+// without any parsing.  A binary file holds, in native byte order:
+//
+//   SfBinaryHeader  (magic string, counts, and the bias setting)
+//   long int        row_offsets[num_examples + 1]
+//   long int        group_id_offsets[num_examples + 1]
+//   long int        comment_offsets[num_examples + 1]
+//   FeatureValuePair features[num_features]
+//   float           labels[num_examples]
+//   char            group_ids[group_id_bytes]
+//   char            comments[comment_bytes]
+//
+// The features of example i, bias term included, are features
+// [row_offsets[i], row_offsets[i + 1]), and likewise for the characters
+// of its group id and comment.  Binary files are not portable between
+// machines with different byte orders or type sizes.
 
 #ifndef SF_DATA_SET_H__
 #define SF_DATA_SET_H__
 
+#include <assert.h>
+#include <map>
 #include <string>
 #include <vector>
 
 #include "sf-sparse-vector.h"
 
+class SfFeatureMap;
+class SfMappedFile;
+
+// The first bytes of a binary data file.
+struct SfBinaryHeader {
+  char magic[8];
+  long int num_examples;
+  long int num_features;
+  long int group_id_bytes;
+  long int comment_bytes;
+  // 1 if the bias feature of each example has value 1, else 0.
+  long int use_bias_term;
+};
+
+// An index of the pairs of examples that a rank step may be taken on:
+// those in the same group with different labels.  The examples of each
+// group are stored together, sorted by label, so that the partners of any
+// example are the examples of its group outside its own run of equal
+// labels, and the k-th of them is found with a little arithmetic.
+class SfRankIndex {
+ public:
+  // An index of no examples.
+  SfRankIndex() {}
+
+  // Indexes the examples whose labels and groups are given by the
+  // parallel arrays labels and groups, replacing any previous index.
+  // Exits, naming the example, if any label is not finite, as a NaN label
+  // can not be ordered against the others.
+  void Build(const vector<float>& labels, const vector<int>& groups);
+
+  // Number of examples indexed.
+  long int NumExamples() const { return ranges_.size(); }
+
+  // Number of examples in the same group as example index, but with a
+  // different label.
+  int NumPartners(long int index) const {
+    const ExampleRange& range = ranges_[index];
+    return (range.group_end - range.group_begin) -
+      (range.label_end - range.label_begin);
+  }
+
+  // Returns the k-th partner of example index, for 0 <= k <
+  // NumPartners(index).  Partners are ordered by label, and then by their
+  // order in the data.
+  int PartnerAt(long int index, int k) const {
+    const ExampleRange& range = ranges_[index];
+    int position = range.group_begin + k;
+    if (position >= range.label_begin) {
+      position += range.label_end - range.label_begin;
+    }
+    return order_[position];
+  }
+
+  // Number of groups with at least two different labels.  These are the
+  // groups that have rank pairs, and every example in them has a partner.
+  int NumRankableGroups() const { return rankable_groups_.size(); }
+
+  // Number of examples in the k-th rankable group.
+  int RankableGroupSize(int k) const {
+    return rankable_groups_[k].end - rankable_groups_[k].begin;
+  }
+
+  // Returns the i-th example of the k-th rankable group, for
+  // 0 <= i < RankableGroupSize(k).
+  int RankableGroupExampleAt(int k, int i) const {
+    return order_[rankable_groups_[k].begin + i];
+  }
+
+ private:
+  // Where in order_ the group of an example is, and, within that, the
+  // examples of its group with the same label.
+  struct ExampleRange {
+    int group_begin;
+    int label_begin;
+    int label_end;
+    int group_end;
+  };
+
+  // [begin, end) in order_ of a group.
+  struct GroupRange {
+    int begin;
+    int end;
+  };
+
+  // Every example, sorted by group, then by label, then by index.
+  vector<int> order_;
+  vector<ExampleRange> ranges_;
+  vector<GroupRange> rankable_groups_;
+};
+
 class SfDataSet {
  public:
   // Empty data set.
   SfDataSet(bool use_bias_term);
 
   // Construct and fill a SfDataSet with data from the given file.
-  // Use buffer_mb megabytes for the buffer.
+  // Regular files are memory-mapped and parsed in place, and each
+  // buffer_mb megabytes of parsed input is released from the mapping as
+  // we go.  Other files, such as pipes, or "-" for standard input, are
+  // read through a buffer of buffer_mb megabytes instead; these must hold
+  // svm-light text rather than binary data.  So are gzip-compressed files,
+  // which are decompressed on a separate thread as they are parsed.  Either
+  // way, no per-line strings are allocated.
   SfDataSet(const string& file_name, int buffer_mb, bool use_bias_term);
 
+  // As above, but a memory-mapped file is split into num_threads chunks
+  // at line boundaries, and each chunk is parsed by its own thread.  The
+  // examples are stored in the same order as in the file, just as if they
+  // had been read by a single thread.
+  SfDataSet(const string& file_name, int buffer_mb, bool use_bias_term,
+	    int num_threads);
+
+  // A shard of data_set, for training replicas of a model apart: a copy of
+  // the examples whose indices are listed in examples, in that order, with
+  // their group ids and comments.
+  SfDataSet(const SfDataSet& data_set, const vector<long int>& examples);
+
+  // Writes the data set to file_name in binary format.  Exits on error.
+  void WriteBinaryFile(const string& file_name) const;
+
   // Debug string.
   string AsString() const;
   
   // Number of total examples in data set.
-  long int NumExamples() const { return vectors_.size(); }
+  long int NumExamples() const { return labels_.size(); }
+
+  // Largest feature id in any example, or 0 if there are no features.  A
+  // weight vector of dimensionality MaxFeatureId() + 1 fits the data.
+  int MaxFeatureId() const { return max_feature_id_; }
+
+  // Returns a view of the specified vector, which remains valid until more
+  // vectors are added to the data set.
+  inline SfSparseVectorView VectorAt(long int index) const {
+    assert(index >= 0 && index < NumExamples());
+    return SfSparseVectorView(FeaturesBegin() + row_offsets_[index],
+			      row_offsets_[index + 1] - row_offsets_[index],
+			      labels_[index],
+			      squared_norms_[index]);
+  }
+
+  // Hints that the specified vector will soon be used, so that its label,
+  // norm and features may be fetched into cache ahead of time.
+  inline void PrefetchVector(long int index) const {
+    assert(index >= 0 && index < NumExamples());
+    const char* begin =
+      reinterpret_cast<const char*>(FeaturesBegin() + row_offsets_[index]);
+    const char* end =
+      reinterpret_cast<const char*>(FeaturesBegin() + row_offsets_[index + 1]);
+    for (const char* line = begin; line < end; line += kCacheLineBytes) {
+      __builtin_prefetch(line);
+    }
+    if (end > begin) __builtin_prefetch(end - 1);
+    __builtin_prefetch(&labels_[index]);
+    __builtin_prefetch(&squared_norms_[index]);
+  }
+
+  // Returns the group id of the specified vector.
+  const string& GroupIdAt(long int index) const {
+    return group_ids_[groups_[index]];
+  }
+
+  // Returns the group of the specified vector, as an integer in
+  // [0, NumGroups()).  Groups are numbered in the order their ids first
+  // appear in the data, so that training loops may index arrays by group
+  // rather than looking up the group id string.
+  int GroupAt(long int index) const { return groups_[index]; }
 
-  // Returns a reference to the specified vector.
-  const SfSparseVector& VectorAt (long int index) const;
+  // Number of distinct group ids, including the empty id of examples that
+  // have none.
+  int NumGroups() const { return group_ids_.size(); }
+
+  // Returns an index of the pairs of examples that rank steps may be taken
+  // on.  It is built on the first call, and again only after examples have
+  // been added, so that every rank loop run on the data set shares it.
+  // The first call must not be made by several threads at once.
+  const SfRankIndex& RankIndex() const {
+    if (rank_index_.NumExamples() != NumExamples()) {
+      rank_index_.Build(labels_, groups_);
+    }
+    return rank_index_;
+  }
+
+  // Returns the indices, in order, of the examples with positive labels,
+  // and of the others, for sampling balanced pairs of examples.  Like
+  // RankIndex(), these are computed on the first call and kept until
+  // examples are added, and the first call must not be made by several
+  // threads at once.
+  const vector<long int>& Positives() const {
+    if (!LabelPartitionIsCurrent()) PartitionByLabel();
+    return positives_;
+  }
+  const vector<long int>& Negatives() const {
+    if (!LabelPartitionIsCurrent()) PartitionByLabel();
+    return negatives_;
+  }
+
+  // Returns the comment of the specified vector.
+  string CommentAt(long int index) const;
 
   // Adds the vector represented by this svm-light format string
   // to the data set.
   void AddVector(const string& vector_string);
   void AddVector(const char* vector_string);
+  // As above, for the svm-light format string [begin, end).
+  void AddVector(const char* begin, const char* end);
   // Adds a copy of the given vector, using label y.
   void AddLabeledVector(const SfSparseVector& x, float y);
 
+  // Replaces every feature id with its dense id in feature_map, keeping
+  // the features of each example sorted by id.  Features that are not
+  // mapped are dropped.
+  void RemapFeatures(const SfFeatureMap& feature_map);
+
  private:
-  // Member containing all vectors in data set.
-  vector<SfSparseVector> vectors_;
+  // Bytes per cache line, the stride at which PrefetchVector() touches
+  // the features of a vector.
+  static const int kCacheLineBytes = 64;
+
+  // One thread's share of a parallel load: a chunk of a mapped file that
+  // begins at the start of a line and ends just after a newline (or at the
+  // end of the file), and the data set its lines are parsed into.
+  struct ParseChunk {
+    const char* begin;
+    const char* end;
+    SfDataSet* data_set;
+    const SfMappedFile* mapped_file;
+    long int release_interval;
+  };
+
+  // Thread body: parses each line of a ParseChunk into its data set.
+  static void* ParseChunkLines(void* chunk_ptr);
+
+  // Appends the features, group id and comment of x, with label y.
+  void AppendVector(const SfSparseVector& x, float y);
+
+  // Appends all of the examples in other, in order.
+  void AppendDataSet(const SfDataSet& other);
+
+  // Reserves room for the examples in num_bytes of svm-light text, so that
+  // the arrays are not reallocated, and so copied, as they grow.  The
+  // count is extrapolated from the first num_parsed_bytes of that text,
+  // parsed since the data set held num_examples examples and num_features
+  // features.
+  void ReserveForText(long int num_examples,
+		      long int num_features,
+		      long int num_parsed_bytes,
+		      long int num_bytes);
+
+  // True if positives_ and negatives_ cover every example.
+  bool LabelPartitionIsCurrent() const {
+    return static_cast<long int>(positives_.size() + negatives_.size()) ==
+      NumExamples();
+  }
+
+  // Fills positives_ and negatives_ from the labels of all examples.
+  void PartitionByLabel() const;
+
+  // Returns the index of group_id in group_ids_, adding it if needed.
+  int InternGroupId(const string& group_id);
+
+  // Start of the features array, or NULL if it is empty.
+  const FeatureValuePair* FeaturesBegin() const {
+    return features_.empty() ? NULL : &features_[0];
+  }
+
+  // Common initialization method shared by the file-reading constructors.
+  void AddVectorsFromFile(const string& file_name,
+			  int buffer_mb,
+			  int num_threads);
+
+  // Adds one vector for each line of file_name, parsing the lines directly
+  // from a read-only mapping of the file with num_threads threads, and
+  // releasing the pages of each release_interval bytes once they have been
+  // parsed.  Returns false if the file can not be mapped.
+  bool AddVectorsFromMappedFile(const string& file_name,
+				long int release_interval,
+				int num_threads);
+
+  // Adds the vectors stored in binary format in the mapped file, setting
+  // the bias term according to use_bias_term_ whatever it was when the
+  // file was written.  Exits if the file is truncated, or if any example
+  // has a negative or out of order feature id, or does not start with the
+  // bias feature.
+  void AddVectorsFromBinary(const SfMappedFile& mapped_file);
+
+  // Members.
+  // Label and squared norm of each example.
+  vector<float> labels_;
+  vector<float> squared_norms_;
+  // The features of example i are [row_offsets_[i], row_offsets_[i + 1])
+  // in features_, so row_offsets_ has one more entry than there are
+  // examples.
+  vector<long int> row_offsets_;
+  vector<FeatureValuePair> features_;
+  // The group id of example i is group_ids_[groups_[i]].
+  vector<int> groups_;
+  vector<string> group_ids_;
+  std::map<string, int> group_id_to_group_;
+  // The comment of example i is [comment_offsets_[i],
+  // comment_offsets_[i + 1]) in comments_.
+  vector<long int> comment_offsets_;
+  string comments_;
+  int max_feature_id_;
+  // Built on demand by RankIndex().  Examples are only ever appended, and
+  // their labels and groups never change, so the index is stale exactly
+  // when it has fewer examples than the data set.
+  mutable SfRankIndex rank_index_;
+  // Built on demand by Positives() and Negatives(), in the same way.
+  mutable vector<long int> positives_;
+  mutable vector<long int> negatives_;
+  // Reused to parse each new vector before it is appended.
+  SfSparseVector parsed_vector_;
   // Should we add a bias term to each new vector in the data set?
   bool use_bias_term_;
 };
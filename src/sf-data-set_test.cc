@@ -15,7 +15,13 @@
 //================================================================================//
 //
 #include <assert.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <zlib.h>
+#include <cstdio>
+#include <fstream>
 #include <iostream>
+#include <iterator>
 #include "sf-data-set.h"
 
 int main (int argc, char** argv) {
@@ -26,6 +32,8 @@ int main (int argc, char** argv) {
   assert(data_set.VectorAt(0).FeatureAt(0) == 0);
   assert(data_set.VectorAt(0).ValueAt(0) == 1);
   assert(data_set.VectorAt(1).GetY() == -1);
+  assert(data_set.MaxFeatureId() == 4);
+  assert(SfDataSet(true).MaxFeatureId() == 0);
 
   // Load a data set from a file, using a bias term.
   SfDataSet data_set2(string("sf-data-set_test.dat"), 5, false);
@@ -35,5 +43,167 @@ int main (int argc, char** argv) {
   assert(data_set2.VectorAt(0).ValueAt(0) == 0);
   assert(data_set2.VectorAt(1).GetY() == -1);
 
+  // Parsing in parallel gives the same examples in the same order, even
+  // with more threads than there are lines.
+  for (int num_threads = 2; num_threads <= 5; ++num_threads) {
+    SfDataSet data_set3(string("sf-data-set_test.dat"), 5, true, num_threads);
+    assert(data_set3.NumExamples() == 2);
+    assert(data_set3.AsString() == data_set.AsString());
+    assert(data_set3.MaxFeatureId() == 4);
+  }
+
+  // Examples added one at a time keep their own group ids and comments,
+  // and views of earlier examples see the same features as before.
+  SfDataSet data_set4(true);
+  data_set4.AddVector("1 qid:7 1:0.5 3:2 #first");
+  data_set4.AddVector("-1 qid:8 2:1");
+  data_set4.AddVector("2 qid:7 4:-1 #third");
+  assert(data_set4.NumExamples() == 3);
+  assert(data_set4.GroupIdAt(0) == "7");
+  assert(data_set4.GroupIdAt(1) == "8");
+  assert(data_set4.GroupIdAt(2) == "7");
+  assert(data_set4.NumGroups() == 2);
+  assert(data_set4.GroupAt(0) == 0);
+  assert(data_set4.GroupAt(1) == 1);
+  assert(data_set4.GroupAt(2) == 0);
+  assert(data_set4.CommentAt(0) == "first");
+  assert(data_set4.CommentAt(1) == "");
+  assert(data_set4.CommentAt(2) == "third");
+  SfSparseVectorView x0 = data_set4.VectorAt(0);
+  assert(x0.NumFeatures() == 3);
+  assert(x0.FeatureAt(2) == 3 && x0.ValueAt(2) == 2);
+  assert(x0.GetSquaredNorm() == 1 + 0.25 + 4);
+  assert(data_set4.VectorAt(1).NumFeatures() == 2);
+  assert(data_set4.VectorAt(2).GetY() == 2);
+
+  // Rank partners are the examples of the same group with other labels,
+  // ordered by label, and the index is rebuilt once examples are added.
+  assert(data_set4.RankIndex().NumPartners(0) == 1);
+  assert(data_set4.RankIndex().PartnerAt(0, 0) == 2);
+  assert(data_set4.RankIndex().NumPartners(1) == 0);
+  data_set4.AddVector("1 qid:7 5:1");
+  data_set4.AddVector("0 qid:7 5:1");
+  const SfRankIndex& rank_index = data_set4.RankIndex();
+  assert(rank_index.NumExamples() == 5);
+  assert(rank_index.NumPartners(0) == 2);
+  assert(rank_index.PartnerAt(0, 0) == 4);
+  assert(rank_index.PartnerAt(0, 1) == 2);
+  assert(rank_index.NumPartners(2) == 3);
+  assert(rank_index.PartnerAt(2, 0) == 4);
+  assert(rank_index.PartnerAt(2, 1) == 0);
+  assert(rank_index.PartnerAt(2, 2) == 3);
+  assert(rank_index.NumPartners(4) == 3);
+  assert(rank_index.PartnerAt(4, 0) == 0);
+  assert(rank_index.NumRankableGroups() == 1);
+  assert(rank_index.RankableGroupSize(0) == 4);
+  assert(rank_index.RankableGroupExampleAt(0, 0) == 4);
+  assert(rank_index.RankableGroupExampleAt(0, 3) == 2);
+
+  // Examples are partitioned by the sign of their labels.
+  assert(data_set4.Positives().size() == 3);
+  assert(data_set4.Positives()[2] == 3);
+  assert(data_set4.Negatives().size() == 2);
+  assert(data_set4.Negatives()[0] == 1 && data_set4.Negatives()[1] == 4);
+  data_set4.AddVector("3 qid:8 5:1");
+  assert(data_set4.Positives().size() == 4);
+  assert(data_set4.Positives()[3] == 5);
+
+  // A binary copy of the data loads as the same examples, with the bias
+  // term set as requested when loading rather than when writing.  The
+  // binary loader rejects the -1 ids of the text fixture, so the copy is
+  // of the same examples without them.
+  SfDataSet text_data_set(true);
+  text_data_set.AddVector("1 1:1 2:2.5 4:-2 #happy");
+  text_data_set.AddVector("-1 qid:3 1:-1 2:-2.5 4:2 #sad");
+  SfDataSet text_data_set2(false);
+  text_data_set2.AddVector("1 1:1 2:2.5 4:-2 #happy");
+  text_data_set2.AddVector("-1 qid:3 1:-1 2:-2.5 4:2 #sad");
+  text_data_set.WriteBinaryFile("sf-data-set_test.bin");
+  SfDataSet binary_data_set(string("sf-data-set_test.bin"), 5, true);
+  assert(binary_data_set.AsString() == text_data_set.AsString());
+  assert(binary_data_set.MaxFeatureId() == 4);
+  assert(binary_data_set.GroupIdAt(1) == "3");
+  SfDataSet binary_data_set2(string("sf-data-set_test.bin"), 5, false);
+  assert(binary_data_set2.AsString() == text_data_set2.AsString());
+  assert(binary_data_set2.VectorAt(0).GetSquaredNorm() ==
+	 text_data_set2.VectorAt(0).GetSquaredNorm());
+  assert(binary_data_set2.CommentAt(1) == "sad");
+
+  // An explicit 0: feature beside the bias loads back from binary too.
+  SfDataSet zero_data_set(true);
+  zero_data_set.AddVector("1 0:2 1:1");
+  zero_data_set.WriteBinaryFile("sf-data-set_test.bin");
+  SfDataSet binary_zero_data_set(string("sf-data-set_test.bin"), 5, true);
+  assert(binary_zero_data_set.AsString() == zero_data_set.AsString());
+  remove("sf-data-set_test.bin");
+
+  // A gzip-compressed copy of the data loads as the same examples.
+  std::ifstream text_stream("sf-data-set_test.dat");
+  string text((std::istreambuf_iterator<char>(text_stream)),
+	      std::istreambuf_iterator<char>());
+  gzFile gzip_file = gzopen("sf-data-set_test.gz", "wb");
+  assert(gzip_file != NULL);
+  assert(gzwrite(gzip_file, text.data(), text.size()) ==
+	 static_cast<int>(text.size()));
+  assert(gzclose(gzip_file) == Z_OK);
+  SfDataSet gzip_data_set(string("sf-data-set_test.gz"), 5, true, 2);
+  assert(gzip_data_set.AsString() == data_set.AsString());
+  remove("sf-data-set_test.gz");
+
+  // Shards take the listed examples, with their group ids, comments,
+  // labels and norms.
+  vector<long int> examples_0;
+  vector<long int> examples_1;
+  for (int i = 0; i < 6; ++i) {
+    (i % 2 == 0 ? examples_0 : examples_1).push_back(i);
+  }
+  SfDataSet shard_0(data_set4, examples_0);
+  SfDataSet shard_1(data_set4, examples_1);
+  assert(shard_0.NumExamples() == 3);
+  assert(shard_1.NumExamples() == 3);
+  for (int i = 0; i < 3; ++i) {
+    assert(shard_0.VectorAt(i).AsString() ==
+	   data_set4.VectorAt(2 * i).AsString());
+    assert(shard_0.VectorAt(i).GetSquaredNorm() ==
+	   data_set4.VectorAt(2 * i).GetSquaredNorm());
+    assert(shard_1.VectorAt(i).AsString() ==
+	   data_set4.VectorAt(2 * i + 1).AsString());
+  }
+  assert(shard_0.NumGroups() == 1);
+  assert(shard_0.GroupIdAt(2) == "7");
+  assert(shard_1.GroupIdAt(0) == "8");
+  assert(shard_1.GroupIdAt(1) == "7");
+  assert(shard_0.CommentAt(0) == "first");
+  assert(shard_0.CommentAt(1) == "third");
+  assert(shard_1.CommentAt(0) == "");
+  assert(shard_0.MaxFeatureId() == 5);
+  assert(shard_0.RankIndex().NumPartners(0) == 2);
+  vector<long int> reversed;
+  reversed.push_back(5);
+  reversed.push_back(0);
+  SfDataSet shard_2(data_set4, reversed);
+  assert(shard_2.NumExamples() == 2);
+  assert(shard_2.VectorAt(0).AsString() == data_set4.VectorAt(5).AsString());
+  assert(shard_2.CommentAt(1) == "first");
+
+  // A NaN label can not be ranked, so building the rank index exits with
+  // an error rather than looping forever.  The alarm turns a hang into a
+  // failure.
+  SfDataSet nan_data_set(true);
+  nan_data_set.AddVector("1 qid:1 1:1");
+  nan_data_set.AddVector("nan qid:1 2:1");
+  nan_data_set.AddVector("0 qid:1 3:1");
+  nan_data_set.AddVector("2 qid:1 4:1");
+  pid_t child = fork();
+  assert(child >= 0);
+  if (child == 0) {
+    alarm(10);
+    nan_data_set.RankIndex();
+    exit(0);
+  }
+  int status;
+  assert(waitpid(child, &status, 0) == child);
+  assert(WIFEXITED(status) && WEXITSTATUS(status) == 1);
+
   std::cout << argv[0] << ": PASS" << std::endl;
 }
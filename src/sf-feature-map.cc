@@ -0,0 +1,143 @@
+//================================================================================//
+// Copyright 2026 The sofia-ml Authors                                            //
+//                                                                                //
+// Licensed under the Apache License, Version 2.0 (the "License");                //
+// you may not use this file except in compliance with the License.               //
+// You may obtain a copy of the License at                                        //
+//                                                                                //
+//      http://www.apache.org/licenses/LICENSE-2.0                                //
+//                                                                                //
+// Unless required by applicable law or agreed to in writing, software            //
+// distributed under the License is distributed on an "AS IS" BASIS,              //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.       //
+// See the License for the specific language governing permissions and            //
+// limitations under the License.                                                 //
+//================================================================================//
+//
+// sf-feature-map.cc
+//
+// Implementation of sf-feature-map.h
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <sstream>
+
+#include "sf-feature-map.h"
+
+// Orders (count, raw id) pairs by decreasing count, then increasing id.
+static bool MoreFrequent(const std::pair<long int, int>& a,
+			 const std::pair<long int, int>& b) {
+  if (a.first != b.first) return a.first > b.first;
+  return a.second < b.second;
+}
+
+// Orders feature value pairs by increasing id.
+static bool LessById(const FeatureValuePair& a, const FeatureValuePair& b) {
+  return a.id_ < b.id_;
+}
+
+//----------------------------------------------------------------//
+//------------------ SfFeatureMap Public Methods -----------------//
+//----------------------------------------------------------------//
+
+SfFeatureMap::SfFeatureMap()
+  : dense_to_raw_(1, 0) {
+}
+
+SfFeatureMap::SfFeatureMap(const string& feature_map_string)
+  : dense_to_raw_(1, 0) {
+  std::stringstream feature_map_stream(feature_map_string);
+  int raw_id;
+  while (feature_map_stream >> raw_id) {
+    if (raw_id == 0) {
+      std::cerr << "Error in feature map: id 0 is mapped." << std::endl;
+      exit(1);
+    }
+    dense_to_raw_.push_back(raw_id);
+  }
+  if (!feature_map_stream.eof()) {
+    std::cerr << "Error in feature map: " << feature_map_string << std::endl;
+    exit(1);
+  }
+  IndexRawIds(1);
+  for (unsigned int i = 1; i < raw_to_dense_.size(); ++i) {
+    if (raw_to_dense_[i].first == raw_to_dense_[i - 1].first) {
+      std::cerr << "Error in feature map: id " << raw_to_dense_[i].first
+		<< " is mapped twice." << std::endl;
+      exit(1);
+    }
+  }
+}
+
+void SfFeatureMap::AddFeatures(const SfDataSet& data_set) {
+  std::map<int, long int> counts;
+  for (long int i = 0; i < data_set.NumExamples(); ++i) {
+    SfSparseVectorView x = data_set.VectorAt(i);
+    for (int j = 0; j < x.NumFeatures(); ++j) {
+      if (DenseId(x.FeatureAt(j)) == -1) ++counts[x.FeatureAt(j)];
+    }
+  }
+
+  vector<std::pair<long int, int> > by_frequency;
+  by_frequency.reserve(counts.size());
+  for (std::map<int, long int>::const_iterator it = counts.begin();
+       it != counts.end();
+       ++it) {
+    by_frequency.push_back(std::make_pair(it->second, it->first));
+  }
+  std::sort(by_frequency.begin(), by_frequency.end(), MoreFrequent);
+
+  int first_dense_id = dense_to_raw_.size();
+  for (unsigned int i = 0; i < by_frequency.size(); ++i) {
+    dense_to_raw_.push_back(by_frequency[i].second);
+  }
+  IndexRawIds(first_dense_id);
+}
+
+void SfFeatureMap::MapVector(SfSparseVector* x) const {
+  vector<FeatureValuePair>& features = x->features_;
+  unsigned int num_kept = 0;
+  for (unsigned int i = 0; i < features.size(); ++i) {
+    int dense_id = DenseId(features[i].id_);
+    if (dense_id == -1) continue;
+    features[num_kept].id_ = dense_id;
+    features[num_kept].value_ = features[i].value_;
+    ++num_kept;
+  }
+  std::sort(features.begin(), features.begin() + num_kept, LessById);
+  if (num_kept < features.size()) {
+    features.resize(num_kept);
+    x->squared_norm_ = 0.0;
+    for (unsigned int i = 0; i < num_kept; ++i) {
+      x->squared_norm_ += features[i].value_ * features[i].value_;
+    }
+  }
+}
+
+string SfFeatureMap::AsString() const {
+  std::stringstream out_string_stream;
+  for (unsigned int i = 1; i < dense_to_raw_.size(); ++i) {
+    out_string_stream << dense_to_raw_[i];
+    if (i + 1 < dense_to_raw_.size()) {
+      out_string_stream << " ";
+    }
+  }
+  return out_string_stream.str();
+}
+
+//----------------------------------------------------------------//
+//----------------- SfFeatureMap Private Methods -----------------//
+//----------------------------------------------------------------//
+
+void SfFeatureMap::IndexRawIds(int first_dense_id) {
+  int num_indexed = raw_to_dense_.size();
+  for (unsigned int i = first_dense_id; i < dense_to_raw_.size(); ++i) {
+    raw_to_dense_.push_back(std::make_pair(dense_to_raw_[i], i));
+  }
+  std::sort(raw_to_dense_.begin() + num_indexed, raw_to_dense_.end());
+  std::inplace_merge(raw_to_dense_.begin(),
+		     raw_to_dense_.begin() + num_indexed,
+		     raw_to_dense_.end());
+}
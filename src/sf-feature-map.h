@@ -0,0 +1,94 @@
+//================================================================================//
+// Copyright 2026 The sofia-ml Authors                                            //
+//                                                                                //
+// Licensed under the Apache License, Version 2.0 (the "License");                //
+// you may not use this file except in compliance with the License.               //
+// You may obtain a copy of the License at                                        //
+//                                                                                //
+//      http://www.apache.org/licenses/LICENSE-2.0                                //
+//                                                                                //
+// Unless required by applicable law or agreed to in writing, software            //
+// distributed under the License is distributed on an "AS IS" BASIS,              //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.       //
+// See the License for the specific language governing permissions and            //
+// limitations under the License.                                                 //
+//================================================================================//
+//
+// sf-feature-map.h
+//
+// A map from raw feature ids, such as sparse 32-bit hashes, to dense ids
+// 1, 2, 3, ..., given in order of decreasing frequency in the data the map
+// is built from.  Training on the dense ids needs a weight vector only as
+// large as the number of distinct features, with the most frequently used
+// weights stored together at its start, so that fewer cache lines and
+// pages are touched by each inner product and update.
+//
+// The bias feature, id 0, is always mapped to itself.
+
+#ifndef SF_FEATURE_MAP_H__
+#define SF_FEATURE_MAP_H__
+
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "sf-data-set.h"
+#include "sf-sparse-vector.h"
+
+using std::string;
+using std::vector;
+
+class SfFeatureMap {
+ public:
+  // An empty map, which maps only the bias feature.
+  SfFeatureMap();
+
+  // Constructs a map from a string, which is identical in format to that
+  // produced by the AsString() member method.  Exits on a malformed string.
+  explicit SfFeatureMap(const string& feature_map_string);
+
+  // Maps each feature id in data_set that is not mapped already, giving
+  // them the next dense ids in order of decreasing frequency in data_set,
+  // with ties broken by raw id.
+  void AddFeatures(const SfDataSet& data_set);
+
+  // Returns the dense id for raw_id, or -1 if raw_id is not mapped.
+  int DenseId(int raw_id) const {
+    if (raw_id == 0) return 0;
+    // Dense ids start at 1, so (raw_id, 0) sorts before any entry for raw_id.
+    vector<std::pair<int, int> >::const_iterator it =
+      std::lower_bound(raw_to_dense_.begin(), raw_to_dense_.end(),
+		       std::make_pair(raw_id, 0));
+    return (it == raw_to_dense_.end() || it->first != raw_id) ?
+      -1 : it->second;
+  }
+
+  // Replaces the features of x with their dense ids, sorted by id as
+  // SfSparseVector requires.  Features that are not mapped are dropped, as
+  // a model trained on the map has zero weight for them.  The features are
+  // rewritten in place, so that no memory is allocated.
+  void MapVector(SfSparseVector* x) const;
+
+  // Number of mapped features, not counting the bias feature.
+  int NumFeatures() const { return dense_to_raw_.size() - 1; }
+
+  // True if only the bias feature is mapped.
+  bool Empty() const { return NumFeatures() == 0; }
+
+  // Returns the raw ids of dense ids 1, 2, 3, ..., space separated.
+  string AsString() const;
+
+ private:
+  // Adds (raw id, dense id) pairs for dense ids from first_dense_id on,
+  // keeping raw_to_dense_ sorted.
+  void IndexRawIds(int first_dense_id);
+
+  // (raw id, dense id) pairs, sorted by raw id for binary search, which
+  // keeps the pairs together in one array.
+  vector<std::pair<int, int> > raw_to_dense_;
+  // Raw id of each dense id, starting with the bias feature.
+  vector<int> dense_to_raw_;
+};
+
+#endif  // SF_FEATURE_MAP_H__
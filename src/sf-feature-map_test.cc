@@ -0,0 +1,88 @@
+//================================================================================//
+// Copyright 2026 The sofia-ml Authors                                            //
+//                                                                                //
+// Licensed under the Apache License, Version 2.0 (the "License");                //
+// you may not use this file except in compliance with the License.               //
+// You may obtain a copy of the License at                                        //
+//                                                                                //
+//      http://www.apache.org/licenses/LICENSE-2.0                                //
+//                                                                                //
+// Unless required by applicable law or agreed to in writing, software            //
+// distributed under the License is distributed on an "AS IS" BASIS,              //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.       //
+// See the License for the specific language governing permissions and            //
+// limitations under the License.                                                 //
+//================================================================================//
+//
+#include <assert.h>
+#include <iostream>
+#include "sf-feature-map.h"
+
+int main (int argc, char** argv) {
+  SfDataSet data_set(true);
+  data_set.AddVector("1 7:1 900000:2 #a");
+  data_set.AddVector("-1 900000:1 123456789:3");
+  data_set.AddVector("1 5:1 900000:0.5");
+
+  // Ids are numbered by decreasing frequency, with ties by raw id.
+  SfFeatureMap feature_map;
+  assert(feature_map.Empty());
+  assert(feature_map.DenseId(0) == 0);
+  feature_map.AddFeatures(data_set);
+  assert(feature_map.NumFeatures() == 4);
+  assert(feature_map.DenseId(0) == 0);
+  assert(feature_map.DenseId(900000) == 1);
+  assert(feature_map.DenseId(5) == 2);
+  assert(feature_map.DenseId(7) == 3);
+  assert(feature_map.DenseId(123456789) == 4);
+  assert(feature_map.DenseId(6) == -1);
+  assert(feature_map.AsString() == "900000 5 7 123456789");
+
+  // A map survives a round trip through a string.
+  SfFeatureMap feature_map_2(feature_map.AsString());
+  assert(feature_map_2.AsString() == feature_map.AsString());
+  assert(feature_map_2.DenseId(123456789) == 4);
+  assert(SfFeatureMap("").Empty());
+
+  // New features are added after those already mapped.
+  SfDataSet more_data(true);
+  more_data.AddVector("1 7:1 8:1");
+  feature_map_2.AddFeatures(more_data);
+  assert(feature_map_2.DenseId(7) == 3);
+  assert(feature_map_2.DenseId(8) == 5);
+
+  // Remapped examples keep their values, sorted by dense id.
+  data_set.RemapFeatures(feature_map);
+  assert(data_set.MaxFeatureId() == 4);
+  SfSparseVectorView x = data_set.VectorAt(0);
+  assert(x.NumFeatures() == 3);
+  assert(x.FeatureAt(0) == 0 && x.ValueAt(0) == 1);
+  assert(x.FeatureAt(1) == 1 && x.ValueAt(1) == 2);
+  assert(x.FeatureAt(2) == 3 && x.ValueAt(2) == 1);
+  assert(x.GetSquaredNorm() == 6);
+  assert(data_set.CommentAt(0) == "a");
+  assert(data_set.VectorAt(1).FeatureAt(2) == 4);
+
+  // Unmapped features are dropped, from vectors and data sets alike.
+  SfSparseVector y("1 5:2 6:1 900000:1", true);
+  feature_map.MapVector(&y);
+  assert(y.NumFeatures() == 3);
+  assert(y.FeatureAt(1) == 1 && y.ValueAt(1) == 1);
+  assert(y.FeatureAt(2) == 2 && y.ValueAt(2) == 2);
+  assert(y.GetSquaredNorm() == 6);
+  // Mapping keeps every mapped feature, reordered by dense id.
+  SfSparseVector z("1 7:1 900000:3 123456789:2", false);
+  feature_map.MapVector(&z);
+  assert(z.NumFeatures() == 4);
+  assert(z.FeatureAt(1) == 1 && z.ValueAt(1) == 3);
+  assert(z.FeatureAt(2) == 3 && z.ValueAt(2) == 1);
+  assert(z.FeatureAt(3) == 4 && z.ValueAt(3) == 2);
+  assert(z.GetSquaredNorm() == 14);
+  SfDataSet test_data(true);
+  test_data.AddVector("1 6:1 7:2");
+  test_data.RemapFeatures(feature_map);
+  assert(test_data.VectorAt(0).NumFeatures() == 2);
+  assert(test_data.VectorAt(0).GetSquaredNorm() == 5);
+
+  std::cout << argv[0] << ": PASS" << std::endl;
+}
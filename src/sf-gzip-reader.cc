@@ -0,0 +1,203 @@
+//================================================================================//
+// Copyright 2026 The sofia-ml Authors                                            //
+//                                                                                //
+// Licensed under the Apache License, Version 2.0 (the "License");                //
+// you may not use this file except in compliance with the License.               //
+// You may obtain a copy of the License at                                        //
+//                                                                                //
+//      http://www.apache.org/licenses/LICENSE-2.0                                //
+//                                                                                //
+// Unless required by applicable law or agreed to in writing, software            //
+// distributed under the License is distributed on an "AS IS" BASIS,              //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.       //
+// See the License for the specific language governing permissions and            //
+// limitations under the License.                                                 //
+//================================================================================//
+//
+// sf-gzip-reader.cc
+//
+// Implementation of sf-gzip-reader.h
+
+#include <errno.h>
+#include <unistd.h>
+#include <zlib.h>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include "sf-gzip-reader.h"
+
+// Number of decompressed blocks that may wait to be read.
+static const unsigned int kMaxQueuedBlocks = 4;
+
+// Size of each read of compressed data.
+static const long int kInputSize = 256 * 1024;
+
+//----------------------------------------------------------------//
+//------------------ SfGzipReader Public Methods -----------------//
+//----------------------------------------------------------------//
+
+bool SfGzipReader::IsGzip(const char* data, long int size) {
+  return size >= 2 &&
+    static_cast<unsigned char>(data[0]) == 0x1f &&
+    static_cast<unsigned char>(data[1]) == 0x8b;
+}
+
+SfGzipReader::SfGzipReader(int fd,
+			   const string& file_name,
+			   const char* prefix,
+			   long int prefix_size,
+			   long int block_size)
+  : fd_(fd),
+    file_name_(file_name),
+    prefix_(prefix, prefix_size),
+    block_size_(block_size < 1 ? 1 : block_size),
+    current_block_(NULL),
+    current_offset_(0),
+    done_(false),
+    stopping_(false) {
+  pthread_mutex_init(&mutex_, NULL);
+  pthread_cond_init(&block_queued_, NULL);
+  pthread_cond_init(&block_taken_, NULL);
+  if (pthread_create(&thread_, NULL, RunDecompress, this) != 0) {
+    std::cerr << "Error creating decompressing thread." << std::endl;
+    exit(1);
+  }
+}
+
+SfGzipReader::~SfGzipReader() {
+  pthread_mutex_lock(&mutex_);
+  stopping_ = true;
+  pthread_cond_signal(&block_taken_);
+  pthread_mutex_unlock(&mutex_);
+  pthread_join(thread_, NULL);
+
+  delete current_block_;
+  while (!queue_.empty()) {
+    delete queue_.front();
+    queue_.pop_front();
+  }
+  pthread_cond_destroy(&block_taken_);
+  pthread_cond_destroy(&block_queued_);
+  pthread_mutex_destroy(&mutex_);
+}
+
+long int SfGzipReader::Read(char* buffer, long int size) {
+  if (current_block_ == NULL ||
+      current_offset_ == static_cast<long int>(current_block_->size())) {
+    delete current_block_;
+    current_block_ = NULL;
+    current_offset_ = 0;
+    pthread_mutex_lock(&mutex_);
+    while (queue_.empty() && !done_) {
+      pthread_cond_wait(&block_queued_, &mutex_);
+    }
+    if (!queue_.empty()) {
+      current_block_ = queue_.front();
+      queue_.pop_front();
+      pthread_cond_signal(&block_taken_);
+    }
+    pthread_mutex_unlock(&mutex_);
+    if (current_block_ == NULL) return 0;
+  }
+
+  long int num_copied = current_block_->size() - current_offset_;
+  if (num_copied > size) num_copied = size;
+  memcpy(buffer, &(*current_block_)[current_offset_], num_copied);
+  current_offset_ += num_copied;
+  return num_copied;
+}
+
+//----------------------------------------------------------------//
+//----------------- SfGzipReader Private Methods -----------------//
+//----------------------------------------------------------------//
+
+void* SfGzipReader::RunDecompress(void* reader) {
+  static_cast<SfGzipReader*>(reader)->Decompress();
+  return NULL;
+}
+
+void SfGzipReader::Decompress() {
+  z_stream stream;
+  memset(&stream, 0, sizeof(stream));
+  // Adding 16 to the window bits expects a gzip header and trailer.
+  if (inflateInit2(&stream, 16 + MAX_WBITS) != Z_OK) {
+    DieGzipFormat("can not start decompressing");
+  }
+
+  vector<char> input(kInputSize);
+  memcpy(&input[0], prefix_.data(), prefix_.size());
+  stream.next_in = reinterpret_cast<Bytef*>(&input[0]);
+  stream.avail_in = prefix_.size();
+  bool at_eof = false;
+  // True between gzip members, where the data may validly end.
+  bool at_member_end = false;
+
+  while (true) {
+    vector<char>* block = new vector<char>(block_size_);
+    stream.next_out = reinterpret_cast<Bytef*>(&(*block)[0]);
+    stream.avail_out = block_size_;
+
+    while (stream.avail_out > 0) {
+      if (stream.avail_in == 0 && !at_eof) {
+	// Hand over what has been decompressed before waiting for more
+	// input, which may be slow to arrive on a pipe.
+	if (static_cast<long int>(stream.avail_out) < block_size_) break;
+	ssize_t num_read;
+	do {
+	  num_read = read(fd_, &input[0], kInputSize);
+	} while (num_read < 0 && errno == EINTR);
+	if (num_read < 0) {
+	  std::cerr << "Error reading file " << file_name_ << std::endl;
+	  exit(1);
+	}
+	at_eof = num_read == 0;
+	stream.next_in = reinterpret_cast<Bytef*>(&input[0]);
+	stream.avail_in = num_read;
+      }
+      if (stream.avail_in == 0 && at_eof) {
+	if (!at_member_end) DieGzipFormat("unexpected end of data");
+	break;
+      }
+      if (at_member_end) {
+	// Another gzip member follows the one just finished.
+	inflateReset(&stream);
+	at_member_end = false;
+      }
+      int result = inflate(&stream, Z_NO_FLUSH);
+      if (result == Z_STREAM_END) {
+	at_member_end = true;
+      } else if (result != Z_OK && result != Z_BUF_ERROR) {
+	DieGzipFormat(stream.msg != NULL ? stream.msg : "corrupt data");
+      }
+    }
+    block->resize(block_size_ - stream.avail_out);
+    bool at_end = at_eof && stream.avail_in == 0 && at_member_end;
+
+    pthread_mutex_lock(&mutex_);
+    while (queue_.size() >= kMaxQueuedBlocks && !stopping_) {
+      pthread_cond_wait(&block_taken_, &mutex_);
+    }
+    if (stopping_) {
+      pthread_mutex_unlock(&mutex_);
+      delete block;
+      break;
+    }
+    if (block->empty()) {
+      delete block;
+    } else {
+      queue_.push_back(block);
+    }
+    done_ = at_end;
+    pthread_cond_signal(&block_queued_);
+    pthread_mutex_unlock(&mutex_);
+    if (at_end) break;
+  }
+  inflateEnd(&stream);
+}
+
+void SfGzipReader::DieGzipFormat(const char* reason) {
+  std::cerr << "Error decompressing gzip file " << file_name_ << ": "
+	    << reason << std::endl;
+  exit(1);
+}
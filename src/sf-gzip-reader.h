@@ -0,0 +1,101 @@
+//================================================================================//
+// Copyright 2026 The sofia-ml Authors                                            //
+//                                                                                //
+// Licensed under the Apache License, Version 2.0 (the "License");                //
+// you may not use this file except in compliance with the License.               //
+// You may obtain a copy of the License at                                        //
+//                                                                                //
+//      http://www.apache.org/licenses/LICENSE-2.0                                //
+//                                                                                //
+// Unless required by applicable law or agreed to in writing, software            //
+// distributed under the License is distributed on an "AS IS" BASIS,              //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.       //
+// See the License for the specific language governing permissions and            //
+// limitations under the License.                                                 //
+//================================================================================//
+//
+// sf-gzip-reader.h
+//
+// Decompresses gzip data from a file descriptor on a background thread,
+// keeping a bounded number of decompressed blocks ready ahead of the
+// reader.  Decompression thus overlaps with whatever the reader does with
+// the data, such as parsing it, rather than adding to it.  Files made of
+// several concatenated gzip members, as from "cat a.gz b.gz", are read as
+// the concatenation of their contents.
+
+#ifndef SF_GZIP_READER_H__
+#define SF_GZIP_READER_H__
+
+#include <pthread.h>
+#include <deque>
+#include <string>
+#include <vector>
+
+using std::string;
+using std::vector;
+
+class SfGzipReader {
+ public:
+  // Returns true if the size bytes at data begin with the gzip magic
+  // number.  At least two bytes are needed to tell.
+  static bool IsGzip(const char* data, long int size);
+
+  // Starts decompressing the gzip data that is the prefix_size bytes at
+  // prefix, which have already been read from fd, followed by the rest of
+  // fd.  Blocks of up to block_size decompressed bytes are produced.  The
+  // caller still owns fd, and must not read from it again; file_name is
+  // used only in error messages.
+  SfGzipReader(int fd,
+	       const string& file_name,
+	       const char* prefix,
+	       long int prefix_size,
+	       long int block_size);
+
+  // Stops the decompressing thread, even if the data has not all been read.
+  ~SfGzipReader();
+
+  // Copies up to size bytes of decompressed data into buffer, waiting for
+  // a block to be decompressed if need be, and returns the number of bytes
+  // copied.  Returns 0 only at the end of the data.  Exits if the data is
+  // not valid gzip data.
+  long int Read(char* buffer, long int size);
+
+ private:
+  // Thread body, calling Decompress() on the given reader.
+  static void* RunDecompress(void* reader);
+
+  // Decompresses fd_ into blocks, adding them to the queue.
+  void Decompress();
+
+  // Prints an error about the data in file_name_ and exits.
+  void DieGzipFormat(const char* reason);
+
+  int fd_;
+  string file_name_;
+  string prefix_;
+  long int block_size_;
+
+  // The block being read from, and the offset of the next unread byte.
+  // Only touched by Read().
+  vector<char>* current_block_;
+  long int current_offset_;
+
+  // Guarded by mutex_.
+  std::deque<vector<char>*> queue_;
+  // True once the decompressing thread has queued its last block.
+  bool done_;
+  // True once the decompressing thread should stop early.
+  bool stopping_;
+
+  pthread_mutex_t mutex_;
+  pthread_cond_t block_queued_;
+  pthread_cond_t block_taken_;
+  pthread_t thread_;
+
+  // Disallowed.
+  SfGzipReader();
+  SfGzipReader(const SfGzipReader&);
+  void operator=(const SfGzipReader&);
+};
+
+#endif  // SF_GZIP_READER_H__
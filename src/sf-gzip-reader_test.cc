@@ -0,0 +1,93 @@
+//================================================================================//
+// Copyright 2026 The sofia-ml Authors                                            //
+//                                                                                //
+// Licensed under the Apache License, Version 2.0 (the "License");                //
+// you may not use this file except in compliance with the License.               //
+// You may obtain a copy of the License at                                        //
+//                                                                                //
+//      http://www.apache.org/licenses/LICENSE-2.0                                //
+//                                                                                //
+// Unless required by applicable law or agreed to in writing, software            //
+// distributed under the License is distributed on an "AS IS" BASIS,              //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.       //
+// See the License for the specific language governing permissions and            //
+// limitations under the License.                                                 //
+//================================================================================//
+//
+#include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <zlib.h>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include "sf-gzip-reader.h"
+#include "sf-line-reader.h"
+
+// Appends contents to file_name as one gzip member.
+void AppendGzipMember(const char* file_name, const string& contents) {
+  gzFile file = gzopen(file_name, "ab");
+  assert(file != NULL);
+  assert(gzwrite(file, contents.data(), contents.size()) ==
+	 static_cast<int>(contents.size()));
+  assert(gzclose(file) == Z_OK);
+}
+
+int main (int argc, char** argv) {
+  const char* file_name = "sf-gzip-reader_test.gz";
+  remove(file_name);
+  string first_member = "1 1:1 #a\n-1 2:1";
+  string second_member(" 3:0.5\n");
+  for (int i = 0; i < 1000; ++i) second_member += "1 4:1\n";
+  AppendGzipMember(file_name, first_member);
+  AppendGzipMember(file_name, second_member);
+
+  assert(SfGzipReader::IsGzip("\x1f\x8b", 2));
+  assert(!SfGzipReader::IsGzip("\x1f", 1));
+  assert(!SfGzipReader::IsGzip("1 1:1", 5));
+
+  // Concatenated members decompress to their concatenated contents, in
+  // blocks of no more than the given size.
+  int fd = open(file_name, O_RDONLY);
+  assert(fd >= 0);
+  char prefix[3];
+  assert(read(fd, prefix, 3) == 3);
+  SfGzipReader* gzip_reader = new SfGzipReader(fd, file_name, prefix, 3, 7);
+  string contents;
+  char buffer[5];
+  long int num_read;
+  while ((num_read = gzip_reader->Read(buffer, 5)) > 0) {
+    assert(num_read <= 5);
+    contents.append(buffer, num_read);
+  }
+  assert(contents == first_member + second_member);
+  assert(gzip_reader->Read(buffer, 5) == 0);
+  delete gzip_reader;
+  close(fd);
+
+  // A reader may be destroyed before it has been read to the end.
+  fd = open(file_name, O_RDONLY);
+  assert(read(fd, prefix, 2) == 2);
+  gzip_reader = new SfGzipReader(fd, file_name, prefix, 2, 1);
+  assert(gzip_reader->Read(buffer, 1) == 1 && buffer[0] == '1');
+  delete gzip_reader;
+  close(fd);
+
+  // SfLineReader recognizes compressed files by their contents.
+  SfLineReader line_reader(file_name, 4);
+  const char* line_begin;
+  const char* line_end;
+  assert(line_reader.NextLine(&line_begin, &line_end));
+  assert(string(line_begin, line_end) == "1 1:1 #a");
+  assert(line_reader.NextLine(&line_begin, &line_end));
+  assert(string(line_begin, line_end) == "-1 2:1 3:0.5");
+  int num_lines = 0;
+  while (line_reader.NextLine(&line_begin, &line_end)) {
+    assert(string(line_begin, line_end) == "1 4:1");
+    ++num_lines;
+  }
+  assert(num_lines == 1000);
+
+  remove(file_name);
+  std::cout << argv[0] << ": PASS" << std::endl;
+}
@@ -58,10 +58,10 @@ SfHashWeightVector::SfHashWeightVector(int hash_mask_bits,
 }
 
 SfHashWeightVector::~SfHashWeightVector() {
-  delete[] weights_;
+  // The weights are freed by ~SfWeightVector(), which runs after this.
 }
 
-float SfHashWeightVector::InnerProduct(const SfSparseVector& x,
+float SfHashWeightVector::InnerProduct(const SfSparseVectorView& x,
 				       float x_scale) const {
   float inner_product = 0.0;
   for (int i = 0; i < x.NumFeatures(); ++i) {
@@ -82,7 +82,7 @@ float SfHashWeightVector::InnerProduct(const SfSparseVector& x,
   return inner_product;
 }
 
-void SfHashWeightVector::AddVector(const SfSparseVector& x,
+void SfHashWeightVector::AddVector(const SfSparseVectorView& x,
 				   float x_scale) {
   float inner_product = 0.0;
   float norm_x = 0.0;
@@ -118,3 +118,14 @@ void SfHashWeightVector::AddVector(const SfSparseVector& x,
   }
   squared_norm_ += norm_x + (2.0 * scale_ * inner_product); 
 }
+
+bool SfHashWeightVector::TakeStep(const SfSparseVectorView& x,
+				  SfStepRule* rule) {
+  return TakeStepWith(x, rule);
+}
+
+bool SfHashWeightVector::TakeRankStep(const SfSparseVectorView& a,
+				      const SfSparseVectorView& b,
+				      SfStepRule* rule) {
+  return TakeRankStepWith(a, b, rule);
+}
@@ -45,18 +45,52 @@ class SfHashWeightVector : public SfWeightVector {
   SfHashWeightVector(int hash_mask_bits,
 		     const string& weight_vector_string);
 
-  // Frees the array of weights.
+  // The array of weights is freed by ~SfWeightVector().
   virtual ~SfHashWeightVector();
 
   // Computes inner product of <phi(x_scale * x), w>, where phi()
   // is a vector composed of all features in x and the cross-product
   // of all features in x, where each of these features is hashed
   // to some new feature id from 0 to 2^num_bits_for_hash_ - 1.
-  virtual float InnerProduct(const SfSparseVector& x,
+  virtual float InnerProduct(const SfSparseVectorView& x,
 			     float x_scale = 1.0) const;
   
   // w += phi(x_scale * x), where phi is defined as for InnerProduct above. 
-  virtual void AddVector(const SfSparseVector& x, float x_scale);
+  virtual void AddVector(const SfSparseVectorView& x, float x_scale);
+
+  // As for SfWeightVector, but with the hashed inner product and update.
+  virtual bool TakeStep(const SfSparseVectorView& x, SfStepRule* rule);
+  virtual bool TakeRankStep(const SfSparseVectorView& a,
+			    const SfSparseVectorView& b,
+			    SfStepRule* rule);
+
+  // As for SfWeightVector, bound at compile time to the methods above.
+  template <class Rule>
+  bool TakeStepWith(const SfSparseVectorView& x, Rule* rule) {
+    float wx = SfHashWeightVector::InnerProduct(x);
+    float x_scale;
+    if (!rule->Decide(wx, this, &x_scale)) return false;
+    SfHashWeightVector::AddVector(x, x_scale);
+    return true;
+  }
+  template <class Rule>
+  bool TakeRankStepWith(const SfSparseVectorView& a,
+			const SfSparseVectorView& b,
+			Rule* rule) {
+    float wx = SfHashWeightVector::InnerProduct(a) +
+      SfHashWeightVector::InnerProduct(b, -1.0);
+    float x_scale;
+    if (!rule->Decide(wx, this, &x_scale)) return false;
+    SfHashWeightVector::AddVector(a, x_scale);
+    SfHashWeightVector::AddVector(b, -x_scale);
+    return true;
+  }
+
+  // Does nothing, as every feature id is hashed into the existing weights.
+  virtual void GrowToFit(int max_feature_id) {}
+
+  // Does nothing, as the weights used depend on the hashed features.
+  virtual void PrefetchWeights(const SfSparseVectorView& x) const {}
 
  private:
   // Disallowed.
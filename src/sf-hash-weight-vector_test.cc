@@ -0,0 +1,50 @@
+//================================================================================//
+// Copyright 2026 The sofia-ml Authors                                            //
+//                                                                                //
+// Licensed under the Apache License, Version 2.0 (the "License");                //
+// you may not use this file except in compliance with the License.               //
+// You may obtain a copy of the License at                                        //
+//                                                                                //
+//      http://www.apache.org/licenses/LICENSE-2.0                                //
+//                                                                                //
+// Unless required by applicable law or agreed to in writing, software            //
+// distributed under the License is distributed on an "AS IS" BASIS,              //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.       //
+// See the License for the specific language governing permissions and            //
+// limitations under the License.                                                 //
+//================================================================================//
+//
+#include <assert.h>
+#include <cmath>
+#include <iostream>
+#include "sf-hash-weight-vector.h"
+
+// True if a and b agree to within a small relative error.
+bool Near(double a, double b) {
+  return fabs(a - b) <= 0.00001 * (fabs(a) + fabs(b)) + 0.0000001;
+}
+
+int main (int argc, char** argv) {
+  SfSparseVector x("1.0 1:1.0 2:2.0 4:3.0");
+
+  // Hashed features that collide are summed, so the inner product of w
+  // with the vector it was built from is the squared norm either way.
+  SfHashWeightVector* w = new SfHashWeightVector(4);
+  assert(w->GetDimensions() == 16);
+  assert(w->InnerProduct(x) == 0.0);
+  w->AddVector(x, 2.0);
+  assert(w->GetSquaredNorm() > 0.0);
+  assert(Near(w->InnerProduct(x, 2.0), w->GetSquaredNorm()));
+  w->ScaleBy(0.5);
+  assert(Near(w->InnerProduct(x), w->GetSquaredNorm()));
+
+  // The weights are freed once, by ~SfWeightVector().
+  delete w;
+
+  SfWeightVector* w_string = new SfHashWeightVector(2, "1 2 3 4");
+  assert(w_string->GetDimensions() == 4);
+  assert(w_string->ValueOf(3) == 4.0);
+  delete w_string;
+
+  std::cout << argv[0] << ": PASS" << std::endl;
+}
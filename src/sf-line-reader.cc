@@ -0,0 +1,151 @@
+//================================================================================//
+// Copyright 2026 The sofia-ml Authors                                            //
+//                                                                                //
+// Licensed under the Apache License, Version 2.0 (the "License");                //
+// you may not use this file except in compliance with the License.               //
+// You may obtain a copy of the License at                                        //
+//                                                                                //
+//      http://www.apache.org/licenses/LICENSE-2.0                                //
+//                                                                                //
+// Unless required by applicable law or agreed to in writing, software            //
+// distributed under the License is distributed on an "AS IS" BASIS,              //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.       //
+// See the License for the specific language governing permissions and            //
+// limitations under the License.                                                 //
+//================================================================================//
+//
+// sf-line-reader.cc
+//
+// Implementation of sf-line-reader.h
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include "sf-gzip-reader.h"
+#include "sf-line-reader.h"
+
+// Size of the blocks of data decompressed ahead of the reader.
+static const long int kGzipBlockSize = 1024 * 1024;
+
+//----------------------------------------------------------------//
+//------------------ SfLineReader Public Methods -----------------//
+//----------------------------------------------------------------//
+
+SfLineReader::SfLineReader(const string& file_name, long int buffer_size)
+  : gzip_reader_(NULL),
+    file_name_(file_name),
+    buffer_size_(buffer_size),
+    at_eof_(false) {
+  // Leave room to look for the gzip magic number.
+  if (buffer_size_ < 2) buffer_size_ = 2;
+  if (file_name == "-") {
+    fd_ = STDIN_FILENO;
+  } else {
+    fd_ = open(file_name.c_str(), O_RDONLY);
+  }
+  if (fd_ < 0) {
+    std::cerr << "Error reading file " << file_name << std::endl;
+    exit(1);
+  }
+  buffer_ = new char[buffer_size_];
+  data_begin_ = buffer_;
+  data_end_ = buffer_;
+
+  // Look at the first two bytes to tell whether the file is compressed.
+  long int num_read;
+  while (data_end_ - buffer_ < 2 &&
+	 (num_read = ReadFile(data_end_, 2 - (data_end_ - buffer_))) > 0) {
+    data_end_ += num_read;
+  }
+  if (SfGzipReader::IsGzip(buffer_, data_end_ - buffer_)) {
+    gzip_reader_ = new SfGzipReader(fd_, file_name_, buffer_, 2,
+				    kGzipBlockSize);
+    data_end_ = buffer_;
+  }
+}
+
+SfLineReader::~SfLineReader() {
+  // Stop decompressing before the file is closed.
+  delete gzip_reader_;
+  if (fd_ != STDIN_FILENO) close(fd_);
+  delete[] buffer_;
+}
+
+bool SfLineReader::NextLine(const char** line_begin, const char** line_end) {
+  char* search_from = data_begin_;
+  while (true) {
+    char* newline = static_cast<char*>(
+        memchr(search_from, '\n', data_end_ - search_from));
+    if (newline != NULL) {
+      *line_begin = data_begin_;
+      *line_end = newline;
+      data_begin_ = newline + 1;
+      return true;
+    }
+    if (at_eof_) {
+      // The last line of a file need not end with a newline.
+      if (data_begin_ == data_end_) return false;
+      *line_begin = data_begin_;
+      *line_end = data_end_;
+      data_begin_ = data_end_;
+      return true;
+    }
+    // No complete line is buffered; there is no need to search the
+    // partial line again once more data has been read in after it.
+    long int searched = data_end_ - data_begin_;
+    FillBuffer();
+    search_from = data_begin_ + searched;
+  }
+}
+
+bool SfLineReader::HasBufferedLine() const {
+  if (at_eof_) return true;
+  return memchr(data_begin_, '\n', data_end_ - data_begin_) != NULL;
+}
+
+//----------------------------------------------------------------//
+//----------------- SfLineReader Private Methods -----------------//
+//----------------------------------------------------------------//
+
+void SfLineReader::FillBuffer() {
+  long int unconsumed = data_end_ - data_begin_;
+  if (unconsumed == buffer_size_) {
+    // A single line fills the whole buffer, so make room for more.
+    char* new_buffer = new char[buffer_size_ * 2];
+    memcpy(new_buffer, data_begin_, unconsumed);
+    delete[] buffer_;
+    buffer_ = new_buffer;
+    buffer_size_ *= 2;
+  } else if (data_begin_ != buffer_) {
+    memmove(buffer_, data_begin_, unconsumed);
+  }
+  data_begin_ = buffer_;
+  data_end_ = buffer_ + unconsumed;
+
+  long int num_read = ReadData(data_end_, buffer_size_ - unconsumed);
+  data_end_ += num_read;
+  if (num_read == 0) at_eof_ = true;
+}
+
+long int SfLineReader::ReadData(char* destination, long int size) {
+  if (gzip_reader_ != NULL) return gzip_reader_->Read(destination, size);
+  return ReadFile(destination, size);
+}
+
+long int SfLineReader::ReadFile(char* destination, long int size) {
+  // Unlike fread(), read() returns whatever a pipe holds rather than
+  // waiting for the whole buffer to be filled.
+  ssize_t num_read;
+  do {
+    num_read = read(fd_, destination, size);
+  } while (num_read < 0 && errno == EINTR);
+  if (num_read < 0) {
+    std::cerr << "Error reading file " << file_name_ << std::endl;
+    exit(1);
+  }
+  return num_read;
+}
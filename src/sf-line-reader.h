@@ -0,0 +1,89 @@
+//================================================================================//
+// Copyright 2026 The sofia-ml Authors                                            //
+//                                                                                //
+// Licensed under the Apache License, Version 2.0 (the "License");                //
+// you may not use this file except in compliance with the License.               //
+// You may obtain a copy of the License at                                        //
+//                                                                                //
+//      http://www.apache.org/licenses/LICENSE-2.0                                //
+//                                                                                //
+// Unless required by applicable law or agreed to in writing, software            //
+// distributed under the License is distributed on an "AS IS" BASIS,              //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.       //
+// See the License for the specific language governing permissions and            //
+// limitations under the License.                                                 //
+//================================================================================//
+//
+// sf-line-reader.h
+//
+// Reads a text file one line at a time through a single reusable buffer.
+// Lines are returned as [begin, end) ranges pointing directly into the
+// buffer, so that no per-line string is ever allocated or copied.  The
+// buffer grows only if a single line is longer than the whole buffer.
+//
+// The file may be a pipe, or "-" for standard input.  Reads return as soon
+// as any data is available, so lines written to a pipe can be consumed as
+// they arrive.  Gzip-compressed data is recognized by its magic number and
+// decompressed on a separate thread, ahead of the lines being consumed.
+
+#ifndef SF_LINE_READER_H__
+#define SF_LINE_READER_H__
+
+#include <string>
+
+using std::string;
+
+class SfGzipReader;
+
+class SfLineReader {
+ public:
+  // Opens file_name for reading, using a buffer of buffer_size bytes.  A
+  // file_name of "-" reads from standard input.  Exits if the file can not
+  // be opened.
+  SfLineReader(const string& file_name, long int buffer_size);
+
+  // Closes the file and frees the buffer.
+  ~SfLineReader();
+
+  // Sets [*line_begin, *line_end) to the next line of the file, not
+  // including the trailing newline, and returns true.  Returns false once
+  // the end of the file has been reached.  The range points into the
+  // internal buffer, and is only valid until the next call to NextLine().
+  bool NextLine(const char** line_begin, const char** line_end);
+
+  // True if the next call to NextLine() can return without reading from
+  // the file, and so without waiting for more data to arrive on a pipe.
+  bool HasBufferedLine() const;
+
+ private:
+  // Moves any unconsumed data to the front of the buffer and reads more
+  // data in after it, doubling the buffer if it is already full.
+  void FillBuffer();
+
+  // Reads up to size bytes of data, decompressed if need be, into
+  // destination, and returns the number of bytes read, or 0 at the end of
+  // the file.  Exits on error.
+  long int ReadData(char* destination, long int size);
+
+  // Reads up to size bytes from fd_ into destination, as for read(), but
+  // retrying if interrupted and exiting on error.
+  long int ReadFile(char* destination, long int size);
+
+  int fd_;
+  // Decompresses the file, if it is gzip-compressed, and NULL otherwise.
+  SfGzipReader* gzip_reader_;
+  string file_name_;
+  char* buffer_;
+  long int buffer_size_;
+  // The unconsumed data in the buffer is [data_begin_, data_end_).
+  char* data_begin_;
+  char* data_end_;
+  bool at_eof_;
+
+  // Disallowed.
+  SfLineReader();
+  SfLineReader(const SfLineReader&);
+  void operator=(const SfLineReader&);
+};
+
+#endif  // SF_LINE_READER_H__
@@ -0,0 +1,50 @@
+//================================================================================//
+// Copyright 2026 The sofia-ml Authors                                            //
+//                                                                                //
+// Licensed under the Apache License, Version 2.0 (the "License");                //
+// you may not use this file except in compliance with the License.               //
+// You may obtain a copy of the License at                                        //
+//                                                                                //
+//      http://www.apache.org/licenses/LICENSE-2.0                                //
+//                                                                                //
+// Unless required by applicable law or agreed to in writing, software            //
+// distributed under the License is distributed on an "AS IS" BASIS,              //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.       //
+// See the License for the specific language governing permissions and            //
+// limitations under the License.                                                 //
+//================================================================================//
+//
+#include <assert.h>
+#include <iostream>
+#include "sf-line-reader.h"
+
+int main (int argc, char** argv) {
+  // Use a tiny buffer, so that lines straddle reads and the buffer must grow.
+  SfLineReader line_reader("sf-line-reader_test.dat", 4);
+  const char* line_begin;
+  const char* line_end;
+
+  // Nothing is read before the first line is asked for.
+  assert(!line_reader.HasBufferedLine());
+
+  assert(line_reader.NextLine(&line_begin, &line_end));
+  assert(string(line_begin, line_end) == "a b");
+
+  // Empty lines are returned as empty ranges.
+  assert(line_reader.NextLine(&line_begin, &line_end));
+  assert(line_begin == line_end);
+
+  assert(line_reader.NextLine(&line_begin, &line_end));
+  assert(string(line_begin, line_end) ==
+	 "the third line is longer than the buffer");
+
+  // The last line need not end with a newline.
+  assert(line_reader.NextLine(&line_begin, &line_end));
+  assert(string(line_begin, line_end) == "last line, no newline");
+
+  assert(!line_reader.NextLine(&line_begin, &line_end));
+  assert(line_reader.HasBufferedLine());
+  assert(!line_reader.NextLine(&line_begin, &line_end));
+
+  std::cout << argv[0] << ": PASS" << std::endl;
+}
@@ -0,0 +1,101 @@
+//================================================================================//
+// Copyright 2026 The sofia-ml Authors                                            //
+//                                                                                //
+// Licensed under the Apache License, Version 2.0 (the "License");                //
+// you may not use this file except in compliance with the License.               //
+// You may obtain a copy of the License at                                        //
+//                                                                                //
+//      http://www.apache.org/licenses/LICENSE-2.0                                //
+//                                                                                //
+// Unless required by applicable law or agreed to in writing, software            //
+// distributed under the License is distributed on an "AS IS" BASIS,              //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.       //
+// See the License for the specific language governing permissions and            //
+// limitations under the License.                                                 //
+//================================================================================//
+//
+// sf-mapped-file.cc
+//
+// Implementation of sf-mapped-file.h
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "sf-mapped-file.h"
+
+//----------------------------------------------------------------//
+//------------------ SfMappedFile Public Methods -----------------//
+//----------------------------------------------------------------//
+
+SfMappedFile::SfMappedFile()
+  : data_(NULL),
+    size_(0),
+    released_(NULL) {
+}
+
+SfMappedFile::~SfMappedFile() {
+  if (data_ != NULL && size_ > 0) {
+    munmap(data_, size_);
+  }
+}
+
+bool SfMappedFile::Open(const string& file_name) {
+  // "-" stands for standard input, which SfLineReader reads as a stream.
+  if (file_name == "-") return false;
+  int fd = open(file_name.c_str(), O_RDONLY);
+  if (fd < 0) return false;
+
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) != 0 || !S_ISREG(file_stat.st_mode)) {
+    close(fd);
+    return false;
+  }
+
+  size_ = file_stat.st_size;
+  if (size_ == 0) {
+    // An empty file can not be mapped, but has nothing to read anyway.
+    static char empty_file = '\0';
+    data_ = &empty_file;
+    released_ = data_;
+    close(fd);
+    return true;
+  }
+
+  void* data = mmap(NULL, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+  // The mapping holds its own reference to the file.
+  close(fd);
+  if (data == MAP_FAILED) {
+    size_ = 0;
+    return false;
+  }
+  data_ = static_cast<char*>(data);
+  released_ = data_;
+  madvise(data_, size_, MADV_SEQUENTIAL);
+  return true;
+}
+
+void SfMappedFile::Release(const char* position) {
+  if (size_ == 0) return;
+  long int page_size = sysconf(_SC_PAGESIZE);
+  char* release_end =
+    data_ + ((position - data_) / page_size) * page_size;
+  if (release_end > released_) {
+    madvise(released_, release_end - released_, MADV_DONTNEED);
+    released_ = release_end;
+  }
+}
+
+const char* SfMappedFile::ReleaseRange(const char* begin,
+				       const char* end) const {
+  if (size_ == 0) return begin;
+  long int page_size = sysconf(_SC_PAGESIZE);
+  long int first_page = ((begin - data_) + page_size - 1) / page_size;
+  long int end_page = (end - data_) / page_size;
+  if (end_page <= first_page) return begin;
+  madvise(data_ + first_page * page_size,
+	  (end_page - first_page) * page_size,
+	  MADV_DONTNEED);
+  return data_ + end_page * page_size;
+}
@@ -0,0 +1,72 @@
+//================================================================================//
+// Copyright 2026 The sofia-ml Authors                                            //
+//                                                                                //
+// Licensed under the Apache License, Version 2.0 (the "License");                //
+// you may not use this file except in compliance with the License.               //
+// You may obtain a copy of the License at                                        //
+//                                                                                //
+//      http://www.apache.org/licenses/LICENSE-2.0                                //
+//                                                                                //
+// Unless required by applicable law or agreed to in writing, software            //
+// distributed under the License is distributed on an "AS IS" BASIS,              //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.       //
+// See the License for the specific language governing permissions and            //
+// limitations under the License.                                                 //
+//================================================================================//
+//
+// sf-mapped-file.h
+//
+// A read-only memory mapping of a whole file, for parsing data in place
+// without copying it into a user-space buffer.  The mapping is advised for
+// sequential access, and pages that have already been consumed can be
+// released from this process with Release().  Released pages stay in the
+// page cache, so other processes reading the same file still share them.
+
+#ifndef SF_MAPPED_FILE_H__
+#define SF_MAPPED_FILE_H__
+
+#include <string>
+
+using std::string;
+
+class SfMappedFile {
+ public:
+  // Creates an object with no file mapped.
+  SfMappedFile();
+
+  // Unmaps the file, if any.
+  ~SfMappedFile();
+
+  // Maps the whole of file_name.  Returns false if the file can not be
+  // opened or mapped, for instance if it is a pipe rather than a regular
+  // file, or is "-" for standard input; callers should then fall back to
+  // reading it as a stream.
+  bool Open(const string& file_name);
+
+  // The mapped contents of the file are [Begin(), End()).
+  const char* Begin() const { return data_; }
+  const char* End() const { return data_ + size_; }
+  long int Size() const { return size_; }
+
+  // Drops all whole pages before position from this process's mapping.
+  // The caller must not read those pages again.
+  void Release(const char* position);
+
+  // Drops all whole pages within [begin, end) from this process's mapping,
+  // and returns the end of the last page dropped, or begin if none were.
+  // Unlike Release(), this keeps no state, so that separate threads may
+  // release disjoint ranges of the file at the same time.
+  const char* ReleaseRange(const char* begin, const char* end) const;
+
+ private:
+  char* data_;
+  long int size_;
+  // Everything before released_ has already been released.
+  char* released_;
+
+  // Disallowed.
+  SfMappedFile(const SfMappedFile&);
+  void operator=(const SfMappedFile&);
+};
+
+#endif  // SF_MAPPED_FILE_H__
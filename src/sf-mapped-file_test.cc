@@ -0,0 +1,49 @@
+//================================================================================//
+// Copyright 2026 The sofia-ml Authors                                            //
+//                                                                                //
+// Licensed under the Apache License, Version 2.0 (the "License");                //
+// you may not use this file except in compliance with the License.               //
+// You may obtain a copy of the License at                                        //
+//                                                                                //
+//      http://www.apache.org/licenses/LICENSE-2.0                                //
+//                                                                                //
+// Unless required by applicable law or agreed to in writing, software            //
+// distributed under the License is distributed on an "AS IS" BASIS,              //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.       //
+// See the License for the specific language governing permissions and            //
+// limitations under the License.                                                 //
+//================================================================================//
+//
+#include <assert.h>
+#include <iostream>
+#include "sf-mapped-file.h"
+
+int main (int argc, char** argv) {
+  SfMappedFile mapped_file;
+  assert(mapped_file.Open("sf-data-set_test.dat"));
+  assert(mapped_file.Size() == 58);
+  assert(mapped_file.End() - mapped_file.Begin() == 58);
+  assert(string(mapped_file.Begin(), mapped_file.Begin() + 28) ==
+	 "1 -1:1 1:1 2:2.5 4:-2 #happy");
+
+  // Releasing a partial page is a no-op, so the data is still readable.
+  mapped_file.Release(mapped_file.Begin() + 29);
+  assert(string(mapped_file.Begin() + 29, mapped_file.End()) ==
+	 "-1 -1:1 1:-1 2:-2.5 4:2 #sad\n");
+
+  // Likewise for a range holding no whole page.
+  assert(mapped_file.ReleaseRange(mapped_file.Begin() + 1,
+				  mapped_file.End()) ==
+	 mapped_file.Begin() + 1);
+  assert(string(mapped_file.Begin(), mapped_file.Begin() + 28) ==
+	 "1 -1:1 1:1 2:2.5 4:-2 #happy");
+
+  // Files that do not exist, and things that are not regular files, can
+  // not be mapped.
+  SfMappedFile missing_file;
+  assert(!missing_file.Open("no-such-file.dat"));
+  SfMappedFile directory;
+  assert(!directory.Open("."));
+
+  std::cout << argv[0] << ": PASS" << std::endl;
+}
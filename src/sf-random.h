@@ -0,0 +1,93 @@
+//================================================================================//
+// Copyright 2026 The sofia-ml Authors                                            //
+//                                                                                //
+// Licensed under the Apache License, Version 2.0 (the "License");                //
+// you may not use this file except in compliance with the License.               //
+// You may obtain a copy of the License at                                        //
+//                                                                                //
+//      http://www.apache.org/licenses/LICENSE-2.0                                //
+//                                                                                //
+// Unless required by applicable law or agreed to in writing, software            //
+// distributed under the License is distributed on an "AS IS" BASIS,              //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.       //
+// See the License for the specific language governing permissions and            //
+// limitations under the License.                                                 //
+//================================================================================//
+//
+// sf-random.h
+//
+// A small, fast pseudo-random number generator for the sampling done by
+// the training loops, in place of rand().  rand() keeps hidden global state,
+// which glibc guards with a lock, gives only 31 bits, and is reduced to a
+// range with %, which favors small values.  An SfRandom holds its own state,
+// so each thread that samples may own one, and draws bounded integers
+// without bias.
+//
+// The generator is xoshiro128** by D. Blackman and S. Vigna, seeded from a
+// single integer through splitmix64.  It is not suitable for cryptography.
+
+#ifndef SF_RANDOM_H__
+#define SF_RANDOM_H__
+
+#include <stdint.h>
+
+class SfRandom {
+ public:
+  // The same seed always gives the same sequence of draws.
+  explicit SfRandom(unsigned int seed) {
+    uint64_t splitmix_state = seed;
+    for (int i = 0; i < 4; i += 2) {
+      uint64_t z = (splitmix_state += 0x9e3779b97f4a7c15ULL);
+      z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+      z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+      z = z ^ (z >> 31);
+      state_[i] = static_cast<uint32_t>(z);
+      state_[i + 1] = static_cast<uint32_t>(z >> 32);
+    }
+  }
+
+  // Returns 32 uniformly random bits.
+  uint32_t RandUint32() {
+    uint32_t result = RotateLeft(state_[1] * 5, 7) * 9;
+    uint32_t t = state_[1] << 9;
+    state_[2] ^= state_[0];
+    state_[3] ^= state_[1];
+    state_[1] ^= state_[2];
+    state_[0] ^= state_[3];
+    state_[2] ^= t;
+    state_[3] = RotateLeft(state_[3], 11);
+    return result;
+  }
+
+  // Returns an integer uniformly at random from [0, num_vals), for
+  // num_vals > 0.  Uses D. Lemire's multiply-and-shift method, which only
+  // rarely needs a second draw to remove the bias of a plain reduction.
+  int RandInt(int num_vals) {
+    uint32_t range = static_cast<uint32_t>(num_vals);
+    uint64_t product = static_cast<uint64_t>(RandUint32()) * range;
+    uint32_t low_bits = static_cast<uint32_t>(product);
+    if (low_bits < range) {
+      uint32_t threshold = (0u - range) % range;
+      while (low_bits < threshold) {
+	product = static_cast<uint64_t>(RandUint32()) * range;
+	low_bits = static_cast<uint32_t>(product);
+      }
+    }
+    return static_cast<int>(product >> 32);
+  }
+
+  // Returns a float uniformly at random from [0, 1).
+  float RandFloat() {
+    // The top 24 bits fill a float's significand exactly.
+    return (RandUint32() >> 8) * (1.0f / 16777216.0f);
+  }
+
+ private:
+  static uint32_t RotateLeft(uint32_t x, int k) {
+    return (x << k) | (x >> (32 - k));
+  }
+
+  uint32_t state_[4];
+};
+
+#endif  // SF_RANDOM_H__
@@ -0,0 +1,70 @@
+//================================================================================//
+// Copyright 2026 The sofia-ml Authors                                            //
+//                                                                                //
+// Licensed under the Apache License, Version 2.0 (the "License");                //
+// you may not use this file except in compliance with the License.               //
+// You may obtain a copy of the License at                                        //
+//                                                                                //
+//      http://www.apache.org/licenses/LICENSE-2.0                                //
+//                                                                                //
+// Unless required by applicable law or agreed to in writing, software            //
+// distributed under the License is distributed on an "AS IS" BASIS,              //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.       //
+// See the License for the specific language governing permissions and            //
+// limitations under the License.                                                 //
+//================================================================================//
+//
+// sf-random_test.cc
+
+#include <assert.h>
+#include <iostream>
+#include <vector>
+
+#include "sf-random.h"
+
+using std::vector;
+
+int main (int argc, char** argv) {
+  // The same seed gives the same draws, and different seeds differ.
+  SfRandom random_a(1);
+  SfRandom random_b(1);
+  SfRandom random_c(2);
+  bool any_differ = false;
+  for (int i = 0; i < 100; ++i) {
+    unsigned int a = random_a.RandUint32();
+    assert(a == random_b.RandUint32());
+    if (a != random_c.RandUint32()) any_differ = true;
+  }
+  assert(any_differ);
+
+  // A seed of 0 still gives a working generator.
+  SfRandom random_zero(0);
+  assert(random_zero.RandUint32() != random_zero.RandUint32());
+
+  // Bounded draws stay in range and hit every value about equally often.
+  SfRandom random(100);
+  vector<int> counts(7, 0);
+  for (int i = 0; i < 70000; ++i) {
+    int value = random.RandInt(7);
+    assert(value >= 0 && value < 7);
+    ++counts[value];
+  }
+  for (int i = 0; i < 7; ++i) {
+    assert(counts[i] > 9500 && counts[i] < 10500);
+  }
+  assert(random.RandInt(1) == 0);
+  // Ranges beyond RAND_MAX on some platforms are fine too.
+  int large = random.RandInt(2147483647);
+  assert(large >= 0 && large < 2147483647);
+
+  // Floats lie in [0, 1) and average about one half.
+  float sum = 0.0;
+  for (int i = 0; i < 10000; ++i) {
+    float value = random.RandFloat();
+    assert(value >= 0.0 && value < 1.0);
+    sum += value;
+  }
+  assert(sum / 10000 > 0.48 && sum / 10000 < 0.52);
+
+  std::cout << argv[0] << ": PASS" << std::endl;
+}
@@ -0,0 +1,90 @@
+//================================================================================//
+// Copyright 2026 The sofia-ml Authors                                            //
+//                                                                                //
+// Licensed under the Apache License, Version 2.0 (the "License");                //
+// you may not use this file except in compliance with the License.               //
+// You may obtain a copy of the License at                                        //
+//                                                                                //
+//      http://www.apache.org/licenses/LICENSE-2.0                                //
+//                                                                                //
+// Unless required by applicable law or agreed to in writing, software            //
+// distributed under the License is distributed on an "AS IS" BASIS,              //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.       //
+// See the License for the specific language governing permissions and            //
+// limitations under the License.                                                 //
+//================================================================================//
+//
+// sf-shared-weight-vector.cc
+//
+// Implementation of sf-shared-weight-vector.h
+
+#include <cstdlib>
+#include <iostream>
+
+#include "sf-shared-weight-vector.h"
+
+//----------------------------------------------------------------//
+//------------- SfSharedWeightVector Public Methods --------------//
+//----------------------------------------------------------------//
+
+SfSharedWeightVector::SfSharedWeightVector(SfWeightVector* shared)
+  : SfWeightVector(1),
+    shared_(shared) {
+  // Replace the array of one weight made above with the shared weights.
+  delete[] weights_;
+  weights_ = shared_->weights_;
+  dimensions_ = shared_->dimensions_;
+  SyncFromShared();
+}
+
+SfSharedWeightVector::~SfSharedWeightVector() {
+  // Keep ~SfWeightVector() from freeing the shared weights.
+  weights_ = NULL;
+}
+
+void SfSharedWeightVector::AddChangesToShared() {
+  double scaling = scale_ / synced_scale_;
+  double added_squared_norm =
+    squared_norm_ - synced_squared_norm_ * scaling * scaling;
+  // The weights added here are also scaled as the shared vector has been
+  // since the sync, by the steps of other views.
+  double shared_scaling = shared_->scale_ / synced_scale_;
+  shared_->ScaleBy(scaling);
+  shared_->squared_norm_ +=
+    added_squared_norm * shared_scaling * shared_scaling;
+  // Never let rounding leave a negative squared norm.
+  if (shared_->squared_norm_ < 0.0) shared_->squared_norm_ = 0.0;
+  SyncFromShared();
+}
+
+void SfSharedWeightVector::SyncFromShared() {
+  scale_ = shared_->scale_;
+  squared_norm_ = shared_->squared_norm_;
+  synced_scale_ = scale_;
+  synced_squared_norm_ = squared_norm_;
+}
+
+bool SfSharedWeightVector::NeedsRescale() const {
+  // The same threshold as ScaleBy() uses.
+  return scale_ < 0.00000000001;
+}
+
+void SfSharedWeightVector::RescaleWeights() {
+  SfWeightVector::ScaleToOne();
+  RecomputeSquaredNorm();
+}
+
+void SfSharedWeightVector::GrowToFit(int max_feature_id) {
+  if (max_feature_id < dimensions_) return;
+  std::cerr << "Feature " << max_feature_id
+	    << " exceeds dimensionality of shared weight vector: "
+	    << dimensions_ << std::endl;
+  exit(1);
+}
+
+//----------------------------------------------------------------//
+//------------- SfSharedWeightVector Protected Methods -----------//
+//----------------------------------------------------------------//
+
+void SfSharedWeightVector::ScaleToOne() {
+}
@@ -0,0 +1,120 @@
+//================================================================================//
+// Copyright 2026 The sofia-ml Authors                                            //
+//                                                                                //
+// Licensed under the Apache License, Version 2.0 (the "License");                //
+// you may not use this file except in compliance with the License.               //
+// You may obtain a copy of the License at                                        //
+//                                                                                //
+//      http://www.apache.org/licenses/LICENSE-2.0                                //
+//                                                                                //
+// Unless required by applicable law or agreed to in writing, software            //
+// distributed under the License is distributed on an "AS IS" BASIS,              //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.       //
+// See the License for the specific language governing permissions and            //
+// limitations under the License.                                                 //
+//================================================================================//
+//
+// sf-shared-weight-vector.h
+//
+// A weight vector that shares the array of weights of another, so that
+// several threads may each take steps on their own SfSharedWeightVector,
+// all updating the same weights at once without locks, as in "Hogwild!"
+// (Niu, Recht, Re and Wright, 2011).  An update by one thread may now and
+// then overwrite a concurrent update of the same weight by another; with
+// sparse examples such collisions are rare, and are accepted.
+//
+// Only the weights are shared.  Updating the scale_ and squared_norm_ of
+// the shared vector on every step of every thread would need a lock, or
+// at least make every thread contend for the same cache line on every
+// step.  Instead each SfSharedWeightVector keeps its own scale_ and
+// squared_norm_, which follow the steps taken on it, and now and then
+// hands its changes to them back to the shared vector with
+// AddChangesToShared(), and takes up the result with SyncFromShared().
+// In between, the scaling done by steps on other threads is not yet seen.
+//
+// Rescaling the weights to a scale_ of 1 rewrites every weight, which can
+// not be done while other threads take steps.  An SfSharedWeightVector
+// never does so itself; the caller does so, with RescaleWeights(), at a
+// time when no thread is taking steps.
+
+#ifndef SF_SHARED_WEIGHT_VECTOR_H__
+#define SF_SHARED_WEIGHT_VECTOR_H__
+
+#include "sf-weight-vector.h"
+
+class SfSharedWeightVector : public SfWeightVector {
+ public:
+  // Shares the weights of shared, which must outlive this, starting from
+  // its scale_ and squared_norm_.
+  explicit SfSharedWeightVector(SfWeightVector* shared);
+
+  // Leaves the shared weights to be freed by their owner.
+  virtual ~SfSharedWeightVector();
+
+  // Scales the shared vector as this has been scaled since it was last
+  // synced, and adds to its squared_norm_ the change in squared norm that
+  // is not due to that scaling.  Then takes up the result, as
+  // SyncFromShared().  The scaling done by each view thus applies to the
+  // weights added by every view between syncs, as if every view had added
+  // its weights before any scaled them.
+  void AddChangesToShared();
+
+  // Takes up the scale_ and squared_norm_ of the shared vector.
+  void SyncFromShared();
+
+  // True if the weights should be rescaled before more steps are taken,
+  // as for ScaleBy().
+  bool NeedsRescale() const;
+
+  // Multiplies each weight by scale_, sets scale_ to 1, and sums the
+  // squared norm afresh, dropping the drift of many syncs.  No thread may
+  // be taking steps on the weights meanwhile, and views of this must be
+  // synced again before they take more.
+  void RescaleWeights();
+
+  // Exits if the weights would need to grow, as the shared array of
+  // weights can not be replaced.
+  virtual void GrowToFit(int max_feature_id);
+
+  // As for SfWeightVector, bound at compile time to the methods of this
+  // class, so that a step taken through ExactBinding<SfSharedWeightVector>
+  // uses any of them that this class overrides.
+  template <class Rule>
+  bool TakeStepWith(const SfSparseVectorView& x, Rule* rule) {
+    float wx = SfSharedWeightVector::InnerProduct(x);
+    float x_scale;
+    if (!rule->Decide(wx, this, &x_scale)) return false;
+    SfSharedWeightVector::AddVector(x, x_scale);
+    return true;
+  }
+  template <class Rule>
+  bool TakeRankStepWith(const SfSparseVectorView& a,
+			const SfSparseVectorView& b,
+			Rule* rule) {
+    float wx = SfSharedWeightVector::InnerProduct(a) +
+      SfSharedWeightVector::InnerProduct(b, -1.0);
+    float x_scale;
+    if (!rule->Decide(wx, this, &x_scale)) return false;
+    SfSharedWeightVector::AddVector(a, x_scale);
+    SfSharedWeightVector::AddVector(b, -x_scale);
+    return true;
+  }
+
+ protected:
+  // Does nothing, as other threads may be taking steps on the weights; see
+  // RescaleWeights().
+  virtual void ScaleToOne();
+
+ private:
+  SfWeightVector* shared_;
+  // The scale_ and squared_norm_ taken up at the last sync.
+  double synced_scale_;
+  double synced_squared_norm_;
+
+  // Disallowed.
+  SfSharedWeightVector();
+  SfSharedWeightVector(const SfSharedWeightVector&);
+  void operator=(const SfSharedWeightVector&);
+};
+
+#endif  // SF_SHARED_WEIGHT_VECTOR_H__
@@ -0,0 +1,159 @@
+//================================================================================//
+// Copyright 2026 The sofia-ml Authors                                            //
+//                                                                                //
+// Licensed under the Apache License, Version 2.0 (the "License");                //
+// you may not use this file except in compliance with the License.               //
+// You may obtain a copy of the License at                                        //
+//                                                                                //
+//      http://www.apache.org/licenses/LICENSE-2.0                                //
+//                                                                                //
+// Unless required by applicable law or agreed to in writing, software            //
+// distributed under the License is distributed on an "AS IS" BASIS,              //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.       //
+// See the License for the specific language governing permissions and            //
+// limitations under the License.                                                 //
+//================================================================================//
+//
+#include <assert.h>
+#include <cmath>
+#include <iostream>
+#include "sf-shared-weight-vector.h"
+
+// True if a and b agree to within a small relative error.
+bool Near(double a, double b) {
+  return fabs(a - b) <= 0.00001 * (fabs(a) + fabs(b)) + 0.0000001;
+}
+
+// Steps by 1 - wx, remembering the wx it was given.
+class ResidualRule : public SfStepRule {
+ public:
+  virtual bool Decide(float wx, SfWeightVector* w, float* x_scale) {
+    wx_ = wx;
+    *x_scale = 1.0 - wx;
+    return true;
+  }
+  float wx_;
+};
+
+int main (int argc, char** argv) {
+  SfSparseVector x("1.0 0:1 1:1.0 2:2.0 4:3.0");
+  SfSparseVector y("1.0 1:-0.5 3:1.5");
+
+  // Steps on a view change the shared weights at once, and the scale and
+  // squared norm once they are added back.
+  SfWeightVector w(string("0.5 1 -1 2 0.25"));
+  SfWeightVector serial(w);
+  {
+    SfSharedWeightVector view(&w);
+    assert(view.GetDimensions() == 5);
+    assert(view.GetSquaredNorm() == w.GetSquaredNorm());
+    assert(view.InnerProduct(x) == w.InnerProduct(x));
+
+    view.ScaleBy(0.5);
+    view.AddVector(x, 2.0);
+    serial.ScaleBy(0.5);
+    serial.AddVector(x, 2.0);
+    assert(view.InnerProduct(y) == serial.InnerProduct(y));
+    assert(view.GetSquaredNorm() == serial.GetSquaredNorm());
+
+    view.AddChangesToShared();
+    for (int i = 0; i < 5; ++i) {
+      assert(w.ValueOf(i) == serial.ValueOf(i));
+    }
+    assert(Near(w.GetSquaredNorm(), serial.GetSquaredNorm()));
+
+    // Adding the changes again adds nothing more.
+    view.AddChangesToShared();
+    for (int i = 0; i < 5; ++i) {
+      assert(w.ValueOf(i) == serial.ValueOf(i));
+    }
+    assert(Near(w.GetSquaredNorm(), serial.GetSquaredNorm()));
+  }
+  // The view leaves the shared weights in place.
+  assert(w.ValueOf(4) == serial.ValueOf(4));
+
+  // The scaling done by each of two views applies to the weights added by
+  // both.
+  SfWeightVector w_2(string("1 0 0 0 0"));
+  {
+    SfSharedWeightVector view_a(&w_2);
+    SfSharedWeightVector view_b(&w_2);
+    view_a.ScaleBy(0.5);
+    view_a.AddVector(SfSparseVector("1 2:1"), 1.0);
+    view_b.ScaleBy(0.25);
+    view_b.AddVector(SfSparseVector("1 3:1"), 1.0);
+    view_a.AddChangesToShared();
+    view_b.AddChangesToShared();
+    assert(w_2.ValueOf(0) == 0.125);
+    assert(w_2.ValueOf(2) == 0.25);
+    assert(w_2.ValueOf(3) == 0.5);
+    assert(Near(w_2.GetSquaredNorm(), 0.125 * 0.125 + 0.25 * 0.25 + 0.5 * 0.5));
+
+    // A synced view sees the steps of both.
+    view_a.SyncFromShared();
+    for (int i = 0; i < 5; ++i) {
+      assert(view_a.ValueOf(i) == w_2.ValueOf(i));
+    }
+    assert(view_a.GetSquaredNorm() == w_2.GetSquaredNorm());
+  }
+
+  // A view never rescales the shared weights itself.
+  SfWeightVector w_3(string("2 4"));
+  {
+    SfSharedWeightVector view(&w_3);
+    assert(!view.NeedsRescale());
+    for (int i = 0; i < 12; ++i) {
+      view.ScaleBy(0.1);
+    }
+    assert(view.NeedsRescale());
+    assert(w_3.ValueOf(1) == 4.0);
+    float value_1 = view.ValueOf(1);
+    view.RescaleWeights();
+    assert(!view.NeedsRescale());
+    assert(Near(view.ValueOf(1), value_1));
+    assert(Near(view.GetSquaredNorm(), 20.0 * 1e-24));
+  }
+
+  // Rescaling sums the squared norm afresh, dropping the rounding error
+  // that many syncs gather.
+  SfWeightVector w_5(5);
+  {
+    SfSharedWeightVector view(&w_5);
+    for (int i = 0; i < 10000; ++i) {
+      view.ScaleBy(0.99);
+      view.AddVector(i % 2 == 0 ? x : y, 0.1);
+      view.AddChangesToShared();
+    }
+    view.RescaleWeights();
+    double squared_norm = 0.0;
+    for (int i = 0; i < 5; ++i) {
+      squared_norm += static_cast<double>(view.ValueOf(i)) * view.ValueOf(i);
+    }
+    assert(view.GetSquaredNorm() == squared_norm);
+  }
+
+  // Steps bound to the view take the same steps as the virtual ones.
+  SfWeightVector w_6(string("0.5 1 -1 2 0.25"));
+  SfWeightVector serial_6(w_6);
+  {
+    SfSharedWeightVector view(&w_6);
+    ResidualRule view_rule;
+    ResidualRule serial_rule;
+    assert(view.TakeStepWith(x, &view_rule));
+    assert(serial_6.TakeStep(x, &serial_rule));
+    assert(view_rule.wx_ == serial_rule.wx_);
+    assert(view.TakeRankStepWith(x, y, &view_rule));
+    assert(serial_6.TakeRankStep(x, y, &serial_rule));
+    assert(view_rule.wx_ == serial_rule.wx_);
+    for (int i = 0; i < 5; ++i) {
+      assert(view.ValueOf(i) == serial_6.ValueOf(i));
+    }
+  }
+
+  // Growing within the dimensions is allowed.
+  SfSharedWeightVector view_4(&w_3);
+  view_4.GrowToFit(1);
+  assert(view_4.GetDimensions() == 2);
+
+  std::cout << argv[0] << ": PASS" << std::endl;
+}
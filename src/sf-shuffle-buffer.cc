@@ -0,0 +1,97 @@
+//================================================================================//
+// Copyright 2026 The sofia-ml Authors                                            //
+//                                                                                //
+// Licensed under the Apache License, Version 2.0 (the "License");                //
+// you may not use this file except in compliance with the License.               //
+// You may obtain a copy of the License at                                        //
+//                                                                                //
+//      http://www.apache.org/licenses/LICENSE-2.0                                //
+//                                                                                //
+// Unless required by applicable law or agreed to in writing, software            //
+// distributed under the License is distributed on an "AS IS" BASIS,              //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.       //
+// See the License for the specific language governing permissions and            //
+// limitations under the License.                                                 //
+//================================================================================//
+//
+// sf-shuffle-buffer.cc
+//
+// Implementation of sf-shuffle-buffer.h
+
+#include <assert.h>
+
+#include "sf-shuffle-buffer.h"
+
+//----------------------------------------------------------------//
+//----------------- SfShuffleBuffer Public Methods ---------------//
+//----------------------------------------------------------------//
+
+SfShuffleBuffer::SfShuffleBuffer(long int max_bytes)
+  : num_bytes_(0),
+    max_bytes_(max_bytes),
+    max_feature_id_(0) {
+}
+
+SfShuffleBuffer::~SfShuffleBuffer() {
+  for (unsigned int i = 0; i < examples_.size(); ++i) {
+    delete examples_[i];
+  }
+}
+
+void SfShuffleBuffer::Add(const char* begin,
+			  const char* end,
+			  bool use_bias_term) {
+  SfSparseVector* x = new SfSparseVector(begin, end, use_bias_term);
+  examples_.push_back(x);
+  num_bytes_ += BytesUsed(*x);
+  UpdateMaxFeatureId(*x);
+}
+
+void SfShuffleBuffer::Replace(int i,
+			      const char* begin,
+			      const char* end,
+			      bool use_bias_term) {
+  assert(i >= 0 && i < Size());
+  num_bytes_ -= BytesUsed(*examples_[i]);
+  examples_[i]->Parse(begin, end, use_bias_term);
+  num_bytes_ += BytesUsed(*examples_[i]);
+  UpdateMaxFeatureId(*examples_[i]);
+}
+
+void SfShuffleBuffer::Add(const SfSparseVectorView& x) {
+  SfSparseVector* copy = new SfSparseVector(x);
+  examples_.push_back(copy);
+  num_bytes_ += BytesUsed(*copy);
+  UpdateMaxFeatureId(*copy);
+}
+
+void SfShuffleBuffer::Replace(int i, const SfSparseVectorView& x) {
+  assert(i >= 0 && i < Size());
+  num_bytes_ -= BytesUsed(*examples_[i]);
+  examples_[i]->Assign(x);
+  num_bytes_ += BytesUsed(*examples_[i]);
+  UpdateMaxFeatureId(*examples_[i]);
+}
+
+void SfShuffleBuffer::Remove(int i) {
+  assert(i >= 0 && i < Size());
+  num_bytes_ -= BytesUsed(*examples_[i]);
+  delete examples_[i];
+  examples_[i] = examples_.back();
+  examples_.pop_back();
+}
+
+//----------------------------------------------------------------//
+//---------------- SfShuffleBuffer Private Methods ---------------//
+//----------------------------------------------------------------//
+
+long int SfShuffleBuffer::BytesUsed(const SfSparseVector& x) {
+  return sizeof(x) + sizeof(&x) +
+    x.NumFeatures() * sizeof(FeatureValuePair) +
+    x.GetGroupId().size() + x.GetComment().size();
+}
+
+void SfShuffleBuffer::UpdateMaxFeatureId(const SfSparseVector& x) {
+  int x_max_feature_id = SfSparseVectorView(x).MaxFeatureId();
+  if (x_max_feature_id > max_feature_id_) max_feature_id_ = x_max_feature_id;
+}
@@ -0,0 +1,96 @@
+//================================================================================//
+// Copyright 2026 The sofia-ml Authors                                            //
+//                                                                                //
+// Licensed under the Apache License, Version 2.0 (the "License");                //
+// you may not use this file except in compliance with the License.               //
+// You may obtain a copy of the License at                                        //
+//                                                                                //
+//      http://www.apache.org/licenses/LICENSE-2.0                                //
+//                                                                                //
+// Unless required by applicable law or agreed to in writing, software            //
+// distributed under the License is distributed on an "AS IS" BASIS,              //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.       //
+// See the License for the specific language governing permissions and            //
+// limitations under the License.                                                 //
+//================================================================================//
+//
+// sf-shuffle-buffer.h
+//
+// A bounded pool of examples, used to train on a stream of examples that
+// is too large to hold in memory.  Examples are added until the pool
+// holds about max_bytes of data; after that, each new example replaces
+// one already in the pool, chosen at random by the caller, which trains
+// on the example it evicts.  This shuffles a stream locally, within a
+// window the size of the pool.
+//
+// Each slot of the pool keeps its own storage, so replacing an example
+// reuses memory rather than allocating it.
+
+#ifndef SF_SHUFFLE_BUFFER_H__
+#define SF_SHUFFLE_BUFFER_H__
+
+#include <vector>
+
+#include "sf-sparse-vector.h"
+
+using std::vector;
+
+class SfShuffleBuffer {
+ public:
+  // An empty buffer, which is full once it holds max_bytes of examples.
+  // At least one example is always held.
+  SfShuffleBuffer(long int max_bytes);
+
+  ~SfShuffleBuffer();
+
+  // Number of examples held.
+  int Size() const { return examples_.size(); }
+
+  // Approximate number of bytes of memory used by the examples held.
+  long int NumBytes() const { return num_bytes_; }
+
+  // Largest feature id of any example ever added, or 0 if none has been.
+  int MaxFeatureId() const { return max_feature_id_; }
+
+  // True once no more examples should be added.
+  bool IsFull() const {
+    return !examples_.empty() && num_bytes_ >= max_bytes_;
+  }
+
+  // Returns the example in slot i.
+  const SfSparseVector& At(int i) const { return *examples_[i]; }
+
+  // Adds the example parsed from the svm-light string [begin, end), using
+  // a bias term iff use_bias_term is true.
+  void Add(const char* begin, const char* end, bool use_bias_term);
+
+  // Replaces the example in slot i with the one parsed from [begin, end).
+  void Replace(int i, const char* begin, const char* end, bool use_bias_term);
+
+  // As above, but for an example that has already been parsed.  Only the
+  // features, label and squared norm of x are kept.
+  void Add(const SfSparseVectorView& x);
+  void Replace(int i, const SfSparseVectorView& x);
+
+  // Removes the example in slot i, moving the last example into its place.
+  void Remove(int i);
+
+ private:
+  // Approximate number of bytes of memory used by x.
+  static long int BytesUsed(const SfSparseVector& x);
+
+  // Raises max_feature_id_ to the largest feature id of x, if need be.
+  void UpdateMaxFeatureId(const SfSparseVector& x);
+
+  vector<SfSparseVector*> examples_;
+  long int num_bytes_;
+  long int max_bytes_;
+  int max_feature_id_;
+
+  // Disallowed.
+  SfShuffleBuffer();
+  SfShuffleBuffer(const SfShuffleBuffer&);
+  void operator=(const SfShuffleBuffer&);
+};
+
+#endif  // SF_SHUFFLE_BUFFER_H__
@@ -0,0 +1,78 @@
+//================================================================================//
+// Copyright 2026 The sofia-ml Authors                                            //
+//                                                                                //
+// Licensed under the Apache License, Version 2.0 (the "License");                //
+// you may not use this file except in compliance with the License.               //
+// You may obtain a copy of the License at                                        //
+//                                                                                //
+//      http://www.apache.org/licenses/LICENSE-2.0                                //
+//                                                                                //
+// Unless required by applicable law or agreed to in writing, software            //
+// distributed under the License is distributed on an "AS IS" BASIS,              //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.       //
+// See the License for the specific language governing permissions and            //
+// limitations under the License.                                                 //
+//================================================================================//
+//
+#include <assert.h>
+#include <cstring>
+#include <iostream>
+#include "sf-shuffle-buffer.h"
+
+// Adds the example in the NUL-terminated string s to the buffer.
+void Add(const char* s, SfShuffleBuffer* buffer) {
+  buffer->Add(s, s + strlen(s), true);
+}
+
+int main (int argc, char** argv) {
+  // A buffer too small for any example still holds one.
+  SfShuffleBuffer tiny_buffer(1);
+  assert(!tiny_buffer.IsFull());
+  Add("1 1:1", &tiny_buffer);
+  assert(tiny_buffer.Size() == 1);
+  assert(tiny_buffer.IsFull());
+
+  SfShuffleBuffer buffer(1000000);
+  Add("1 1:1 2:2", &buffer);
+  Add("-1 3:1", &buffer);
+  Add("2 4:0.5 #c", &buffer);
+  assert(buffer.Size() == 3);
+  assert(!buffer.IsFull());
+  assert(buffer.At(1).GetY() == -1);
+  assert(buffer.At(2).GetComment() == "c");
+  assert(buffer.MaxFeatureId() == 4);
+
+  // Replacing an example keeps the byte count in step.
+  long int num_bytes = buffer.NumBytes();
+  const char* longer = "3 1:1 2:1 3:1 4:1";
+  buffer.Replace(1, longer, longer + strlen(longer), true);
+  assert(buffer.At(1).GetY() == 3);
+  assert(buffer.At(1).NumFeatures() == 5);
+  assert(buffer.NumBytes() ==
+	 num_bytes + 3 * static_cast<long int>(sizeof(FeatureValuePair)));
+
+  // Parsed examples are copied in, without their comments.
+  SfSparseVector parsed("4 1:2 #d", true);
+  buffer.Replace(2, parsed);
+  assert(buffer.At(2).GetY() == 4);
+  assert(buffer.At(2).NumFeatures() == 2);
+  assert(buffer.At(2).ValueAt(1) == 2);
+  assert(buffer.At(2).GetComment() == "");
+  buffer.Add(parsed);
+  assert(buffer.Size() == 4);
+  assert(buffer.At(3).GetSquaredNorm() == parsed.GetSquaredNorm());
+  buffer.Remove(3);
+  buffer.Replace(2, "2 4:0.5 #c", "2 4:0.5 #c" + 10, true);
+
+  // Removing moves the last example into the gap.
+  buffer.Remove(0);
+  assert(buffer.Size() == 2);
+  assert(buffer.At(0).GetY() == 2);
+  assert(buffer.At(1).GetY() == 3);
+  buffer.Remove(1);
+  buffer.Remove(0);
+  assert(buffer.Size() == 0);
+  assert(buffer.NumBytes() == 0);
+
+  std::cout << argv[0] << ": PASS" << std::endl;
+}
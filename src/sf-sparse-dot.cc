@@ -0,0 +1,417 @@
+//================================================================================//
+// Copyright 2026 The sofia-ml Authors                                            //
+//                                                                                //
+// Licensed under the Apache License, Version 2.0 (the "License");                //
+// you may not use this file except in compliance with the License.               //
+// You may obtain a copy of the License at                                        //
+//                                                                                //
+//      http://www.apache.org/licenses/LICENSE-2.0                                //
+//                                                                                //
+// Unless required by applicable law or agreed to in writing, software            //
+// distributed under the License is distributed on an "AS IS" BASIS,              //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.       //
+// See the License for the specific language governing permissions and            //
+// limitations under the License.                                                 //
+//================================================================================//
+//
+// sf-sparse-dot.cc
+//
+// Implementation of sf-sparse-dot.h
+//
+// The vector kernels are compiled for their instruction sets with target
+// attributes, rather than for the whole build, so that one binary runs on
+// any x86-64 CPU and picks the widest kernel it supports.  Multiplies and
+// adds are kept as separate instructions, never fused, so that every
+// kernel rounds exactly as the scalar one does.
+
+#include "sf-sparse-dot.h"
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define SF_SPARSE_DOT_X86
+#include <immintrin.h>
+#endif
+
+// Each lane-order kernel keeps this many running sums.
+static const int kNumLanes = 8;
+
+typedef float (*SparseDotKernel)(const float* weights,
+				 const FeatureValuePair* features,
+				 int num_features);
+typedef float (*SparseAddAndDotKernel)(float* weights,
+				       const FeatureValuePair* features,
+				       int num_features,
+				       float x_scale,
+				       double weight_scale);
+
+// Adds the lanes pairwise, in the order given in sf-sparse-dot.h.
+static inline float AddLanes(const float* lanes) {
+  return ((lanes[0] + lanes[4]) + (lanes[2] + lanes[6])) +
+    ((lanes[1] + lanes[5]) + (lanes[3] + lanes[7]));
+}
+
+float SfSparseDotSequential(const float* weights,
+			    const FeatureValuePair* features,
+			    int num_features) {
+  float inner_product = 0.0;
+  for (int i = 0; i < num_features; ++i) {
+    inner_product += weights[features[i].id_] * features[i].value_;
+  }
+  return inner_product;
+}
+
+float SfSparseDotLanes(const float* weights,
+		       const FeatureValuePair* features,
+		       int num_features) {
+  float lanes[kNumLanes] = {0, 0, 0, 0, 0, 0, 0, 0};
+  int i = 0;
+  for (; i + kNumLanes <= num_features; i += kNumLanes) {
+    for (int k = 0; k < kNumLanes; ++k) {
+      lanes[k] += weights[features[i + k].id_] * features[i + k].value_;
+    }
+  }
+  if (i < num_features) {
+    // The vector kernels pad the last block with zero products.
+    for (int k = 0; k < kNumLanes; ++k) {
+      lanes[k] += (i + k < num_features) ?
+	weights[features[i + k].id_] * features[i + k].value_ : 0.0f;
+    }
+  }
+  return AddLanes(lanes);
+}
+
+float SfSparseAddAndDotSequential(float* weights,
+				  const FeatureValuePair* features,
+				  int num_features,
+				  float x_scale,
+				  double weight_scale) {
+  float inner_product = 0.0;
+  for (int i = 0; i < num_features; ++i) {
+    float x_value = features[i].value_ * x_scale;
+    float* weight = weights + features[i].id_;
+    inner_product += *weight * x_value;
+    *weight += x_value / weight_scale;
+  }
+  return inner_product;
+}
+
+float SfSparseAddAndDotLanes(float* weights,
+			     const FeatureValuePair* features,
+			     int num_features,
+			     float x_scale,
+			     double weight_scale) {
+  float lanes[kNumLanes] = {0, 0, 0, 0, 0, 0, 0, 0};
+  for (int i = 0; i < num_features; ++i) {
+    float x_value = features[i].value_ * x_scale;
+    float* weight = weights + features[i].id_;
+    lanes[i % kNumLanes] += *weight * x_value;
+    *weight += x_value / weight_scale;
+  }
+  // As in SfSparseDotLanes(), for the zero products that pad the last block.
+  if (num_features % kNumLanes != 0) {
+    for (int k = num_features % kNumLanes; k < kNumLanes; ++k) {
+      lanes[k] += 0.0f;
+    }
+  }
+  return AddLanes(lanes);
+}
+
+#ifdef SF_SPARSE_DOT_X86
+
+bool SfCpuHasAvx2() {
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2");
+}
+
+bool SfCpuHasAvx512() {
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx512f") &&
+    __builtin_cpu_supports("avx512cd");
+}
+
+// Splits the 8 pairs held in first and second into their ids and values.
+__attribute__((target("avx2")))
+static inline void SplitPairsAvx2(__m256 first, __m256 second,
+				  __m256i* ids, __m256* values) {
+  // Within each 128 bit half, takes the even (id) and odd (value) floats,
+  // giving ids 0 1 4 5 | 2 3 6 7, and then puts the pairs back in order.
+  __m256 even = _mm256_shuffle_ps(first, second, _MM_SHUFFLE(2, 0, 2, 0));
+  __m256 odd = _mm256_shuffle_ps(first, second, _MM_SHUFFLE(3, 1, 3, 1));
+  *ids = _mm256_castpd_si256(_mm256_permute4x64_pd(
+      _mm256_castps_pd(even), _MM_SHUFFLE(3, 1, 2, 0)));
+  *values = _mm256_castpd_ps(_mm256_permute4x64_pd(
+      _mm256_castps_pd(odd), _MM_SHUFFLE(3, 1, 2, 0)));
+}
+
+// As AddLanes().
+__attribute__((target("avx2")))
+static inline float AddLanesAvx2(__m256 lanes) {
+  // l0 + l4, l1 + l5, l2 + l6, l3 + l7.
+  __m128 half = _mm_add_ps(_mm256_castps256_ps128(lanes),
+			   _mm256_extractf128_ps(lanes, 1));
+  // (l0 + l4) + (l2 + l6), (l1 + l5) + (l3 + l7).
+  __m128 quarter = _mm_add_ps(half, _mm_movehl_ps(half, half));
+  return _mm_cvtss_f32(_mm_add_ss(quarter,
+				  _mm_shuffle_ps(quarter, quarter, 1)));
+}
+
+__attribute__((target("avx2")))
+float SfSparseDotAvx2(const float* weights,
+		      const FeatureValuePair* features,
+		      int num_features) {
+  const float* pairs = reinterpret_cast<const float*>(features);
+  __m256 lanes = _mm256_setzero_ps();
+  __m256i ids;
+  __m256 values;
+  int i = 0;
+  for (; i + kNumLanes <= num_features; i += kNumLanes) {
+    SplitPairsAvx2(_mm256_loadu_ps(pairs + 2 * i),
+		   _mm256_loadu_ps(pairs + 2 * i + 8),
+		   &ids, &values);
+    __m256 gathered = _mm256_i32gather_ps(weights, ids, 4);
+    lanes = _mm256_add_ps(lanes, _mm256_mul_ps(gathered, values));
+  }
+  if (i < num_features) {
+    // Loads only the remaining pairs, leaving zero ids and values in the
+    // lanes after them, whose weights are not gathered.
+    const __m256i lane_index = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    int num_floats = 2 * (num_features - i);
+    __m256 first = _mm256_maskload_ps(
+        pairs + 2 * i,
+	_mm256_cmpgt_epi32(_mm256_set1_epi32(num_floats), lane_index));
+    __m256 second = _mm256_setzero_ps();
+    if (num_floats > 8) {
+      second = _mm256_maskload_ps(
+          pairs + 2 * i + 8,
+	  _mm256_cmpgt_epi32(_mm256_set1_epi32(num_floats - 8), lane_index));
+    }
+    SplitPairsAvx2(first, second, &ids, &values);
+    __m256i mask = _mm256_cmpgt_epi32(_mm256_set1_epi32(num_features - i),
+				      lane_index);
+    __m256 gathered = _mm256_mask_i32gather_ps(_mm256_setzero_ps(), weights,
+					       ids, _mm256_castsi256_ps(mask),
+					       4);
+    lanes = _mm256_add_ps(lanes, _mm256_mul_ps(gathered, values));
+  }
+  return AddLanesAvx2(lanes);
+}
+
+// Returns the low (half 0) or high (half 1) 8 floats of products.  The
+// masked extract, unlike a plain one or a cast, leaves nothing undefined.
+#define HalfOfAvx512(products, half)					\
+  _mm256_castpd_ps(_mm512_mask_extractf64x4_pd(				\
+      _mm256_setzero_pd(), 0xFF, _mm512_castps_pd(products), (half)))
+
+__attribute__((target("avx512f")))
+float SfSparseDotAvx512(const float* weights,
+			const FeatureValuePair* features,
+			int num_features) {
+  const float* pairs = reinterpret_cast<const float*>(features);
+  const __m512i id_index = _mm512_setr_epi32(0, 2, 4, 6, 8, 10, 12, 14,
+					     16, 18, 20, 22, 24, 26, 28, 30);
+  const __m512i value_index = _mm512_setr_epi32(1, 3, 5, 7, 9, 11, 13, 15,
+						17, 19, 21, 23, 25, 27, 29,
+						31);
+  // Gathers 16 weights at a time, but sums into 8 lanes as the other
+  // kernels do: products i and i + 8 are added to lane i % 8 in turn.
+  __m256 lanes = _mm256_setzero_ps();
+  int i = 0;
+  for (; i + 2 * kNumLanes <= num_features; i += 2 * kNumLanes) {
+    __m512i first = _mm512_loadu_si512(pairs + 2 * i);
+    __m512i second = _mm512_loadu_si512(pairs + 2 * i + 16);
+    __m512i ids = _mm512_permutex2var_epi32(first, id_index, second);
+    __m512 values = _mm512_castsi512_ps(
+        _mm512_permutex2var_epi32(first, value_index, second));
+    __m512 gathered = _mm512_mask_i32gather_ps(_mm512_setzero_ps(), 0xFFFF,
+						ids, weights, 4);
+    __m512 products = _mm512_mul_ps(gathered, values);
+    lanes = _mm256_add_ps(lanes, HalfOfAvx512(products, 0));
+    lanes = _mm256_add_ps(lanes, HalfOfAvx512(products, 1));
+  }
+  if (i < num_features) {
+    int num_left = num_features - i;
+    int num_floats = 2 * num_left;
+    __mmask16 first_mask =
+      num_floats >= 16 ? 0xFFFF : (1 << num_floats) - 1;
+    __mmask16 second_mask =
+      num_floats > 16 ? (1 << (num_floats - 16)) - 1 : 0;
+    __m512i first = _mm512_maskz_loadu_epi32(first_mask, pairs + 2 * i);
+    __m512i second = _mm512_maskz_loadu_epi32(second_mask,
+					      pairs + 2 * i + 16);
+    __m512i ids = _mm512_permutex2var_epi32(first, id_index, second);
+    __m512 values = _mm512_castsi512_ps(
+        _mm512_permutex2var_epi32(first, value_index, second));
+    __m512 gathered = _mm512_mask_i32gather_ps(
+        _mm512_setzero_ps(), (1 << num_left) - 1, ids, weights, 4);
+    __m512 products = _mm512_mul_ps(gathered, values);
+    lanes = _mm256_add_ps(lanes, HalfOfAvx512(products, 0));
+    // A block of 8 zero products would not be added by the other kernels.
+    if (num_left > kNumLanes) {
+      lanes = _mm256_add_ps(lanes, HalfOfAvx512(products, 1));
+    }
+  }
+  return AddLanesAvx2(lanes);
+}
+
+// Returns half of weights + x_values / weight_scales, computed in double
+// precision and rounded back to float, as in SfSparseAddAndDotLanes().
+// Masked forms are used throughout, as for HalfOfAvx512().
+__attribute__((target("avx512f")))
+static inline __m256d AddInDoubleAvx512(__m512 weights,
+					__m512 x_values,
+					__m512d weight_scales,
+					int half) {
+  __m512d sum = _mm512_add_pd(
+      _mm512_maskz_cvtps_pd(0xFF, HalfOfAvx512(weights, half)),
+      _mm512_div_pd(_mm512_maskz_cvtps_pd(0xFF, HalfOfAvx512(x_values, half)),
+		    weight_scales));
+  return _mm256_castps_pd(_mm512_maskz_cvtpd_ps(0xFF, sum));
+}
+
+// As SfSparseDotAvx512(), but also scatters the updated weights back.  A
+// block whose ids repeat, as an explicit 0: feature beside the bias can,
+// would lose all but one update to a weight in the scatter, and would read
+// it before the earlier update.  Such a block is added one feature at a
+// time instead, as SfSparseAddAndDotLanes() does.
+__attribute__((target("avx512f,avx512cd")))
+float SfSparseAddAndDotAvx512(float* weights,
+			      const FeatureValuePair* features,
+			      int num_features,
+			      float x_scale,
+			      double weight_scale) {
+  const float* pairs = reinterpret_cast<const float*>(features);
+  const __m512i id_index = _mm512_setr_epi32(0, 2, 4, 6, 8, 10, 12, 14,
+					     16, 18, 20, 22, 24, 26, 28, 30);
+  const __m512i value_index = _mm512_setr_epi32(1, 3, 5, 7, 9, 11, 13, 15,
+						17, 19, 21, 23, 25, 27, 29,
+						31);
+  const __m512 x_scales = _mm512_set1_ps(x_scale);
+  const __m512d weight_scales = _mm512_set1_pd(weight_scale);
+  __m256 lanes = _mm256_setzero_ps();
+  for (int i = 0; i < num_features; i += 2 * kNumLanes) {
+    int num_left = num_features - i;
+    int num_floats = 2 * num_left;
+    __mmask16 mask = num_left >= 16 ? 0xFFFF : (1 << num_left) - 1;
+    __mmask16 first_mask =
+      num_floats >= 16 ? 0xFFFF : (1 << num_floats) - 1;
+    __mmask16 second_mask = num_floats >= 32 ? 0xFFFF :
+      num_floats > 16 ? (1 << (num_floats - 16)) - 1 : 0;
+    __m512i first = _mm512_maskz_loadu_epi32(first_mask, pairs + 2 * i);
+    __m512i second = _mm512_maskz_loadu_epi32(second_mask,
+					      pairs + 2 * i + 16);
+    __m512i ids = _mm512_permutex2var_epi32(first, id_index, second);
+    __m512 x_values = _mm512_mul_ps(_mm512_castsi512_ps(
+        _mm512_permutex2var_epi32(first, value_index, second)), x_scales);
+    __m512 products;
+    __m512i conflicts = _mm512_maskz_conflict_epi32(mask, ids);
+    if (_mm512_test_epi32_mask(conflicts, conflicts) != 0) {
+      // Padding products are formed as the masked gather forms them.
+      float block_products[2 * kNumLanes];
+      for (int j = 0; j < 2 * kNumLanes; ++j) {
+	if (j >= num_left) {
+	  block_products[j] = 0.0f * (0.0f * x_scale);
+	  continue;
+	}
+	float x_value = features[i + j].value_ * x_scale;
+	float* weight = weights + features[i + j].id_;
+	block_products[j] = *weight * x_value;
+	*weight += x_value / weight_scale;
+      }
+      products = _mm512_loadu_ps(block_products);
+    } else {
+      __m512 gathered = _mm512_mask_i32gather_ps(_mm512_setzero_ps(), mask,
+						  ids, weights, 4);
+      products = _mm512_mul_ps(gathered, x_values);
+      _mm512_mask_i32scatter_ps(
+          weights, mask, ids,
+	  _mm512_castpd_ps(_mm512_maskz_insertf64x4(
+	      0xFF,
+	      _mm512_maskz_insertf64x4(
+	          0xFF, _mm512_setzero_pd(),
+		  AddInDoubleAvx512(gathered, x_values, weight_scales, 0), 0),
+	      AddInDoubleAvx512(gathered, x_values, weight_scales, 1), 1)),
+	  4);
+    }
+    lanes = _mm256_add_ps(lanes, HalfOfAvx512(products, 0));
+    if (num_left > kNumLanes) {
+      lanes = _mm256_add_ps(lanes, HalfOfAvx512(products, 1));
+    }
+  }
+  return AddLanesAvx2(lanes);
+}
+
+#else  // SF_SPARSE_DOT_X86
+
+bool SfCpuHasAvx2() { return false; }
+bool SfCpuHasAvx512() { return false; }
+
+float SfSparseDotAvx2(const float* weights,
+		      const FeatureValuePair* features,
+		      int num_features) {
+  return SfSparseDotLanes(weights, features, num_features);
+}
+
+float SfSparseDotAvx512(const float* weights,
+			const FeatureValuePair* features,
+			int num_features) {
+  return SfSparseDotLanes(weights, features, num_features);
+}
+
+float SfSparseAddAndDotAvx512(float* weights,
+			      const FeatureValuePair* features,
+			      int num_features,
+			      float x_scale,
+			      double weight_scale) {
+  return SfSparseAddAndDotLanes(weights, features, num_features,
+				x_scale, weight_scale);
+}
+
+#endif  // SF_SPARSE_DOT_X86
+
+// Returns the fastest lane order kernel that the CPU supports.
+static SparseDotKernel FastestLaneKernel() {
+  if (SfCpuHasAvx512()) return SfSparseDotAvx512;
+  if (SfCpuHasAvx2()) return SfSparseDotAvx2;
+  return SfSparseDotLanes;
+}
+
+// As FastestLaneKernel(), for the update kernels.
+static SparseAddAndDotKernel FastestLaneAddAndDotKernel() {
+  if (SfCpuHasAvx512()) return SfSparseAddAndDotAvx512;
+  return SfSparseAddAndDotLanes;
+}
+
+static SparseDotKernel sparse_dot_kernel = FastestLaneKernel();
+static SparseAddAndDotKernel sparse_add_and_dot_kernel =
+  FastestLaneAddAndDotKernel();
+
+void SfSetSparseDotOrder(SfSparseDotOrder order) {
+  if (order == SF_SEQUENTIAL_ORDER) {
+    sparse_dot_kernel = SfSparseDotSequential;
+    sparse_add_and_dot_kernel = SfSparseAddAndDotSequential;
+  } else {
+    sparse_dot_kernel = FastestLaneKernel();
+    sparse_add_and_dot_kernel = FastestLaneAddAndDotKernel();
+  }
+}
+
+float SfSparseDot(const float* weights,
+		  const FeatureValuePair* features,
+		  int num_features) {
+  return sparse_dot_kernel(weights, features, num_features);
+}
+
+float SfSparseAddAndDot(float* weights,
+			const FeatureValuePair* features,
+			int num_features,
+			float x_scale,
+			double weight_scale) {
+  return sparse_add_and_dot_kernel(weights, features, num_features,
+				   x_scale, weight_scale);
+}
+
+const char* SfSparseDotKernelName() {
+  if (sparse_dot_kernel == SfSparseDotAvx512) return "avx512";
+  if (sparse_dot_kernel == SfSparseDotAvx2) return "avx2";
+  if (sparse_dot_kernel == SfSparseDotLanes) return "lanes";
+  return "sequential";
+}
@@ -0,0 +1,118 @@
+//================================================================================//
+// Copyright 2026 The sofia-ml Authors                                            //
+//                                                                                //
+// Licensed under the Apache License, Version 2.0 (the "License");                //
+// you may not use this file except in compliance with the License.               //
+// You may obtain a copy of the License at                                        //
+//                                                                                //
+//      http://www.apache.org/licenses/LICENSE-2.0                                //
+//                                                                                //
+// Unless required by applicable law or agreed to in writing, software            //
+// distributed under the License is distributed on an "AS IS" BASIS,              //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.       //
+// See the License for the specific language governing permissions and            //
+// limitations under the License.                                                 //
+//================================================================================//
+//
+// sf-sparse-dot.h
+//
+// Kernels for the sparse inner product of a dense array of weights with a
+// sparse vector, given as its FeatureValuePairs:
+//
+//   sum over i of weights[features[i].id_] * features[i].value_
+//
+// Floating point addition is not associative, so the result depends on the
+// order in which the products are summed.  Two orders are offered:
+//
+//  - Lane order, the default.  Product i is added into lane i % 8 of eight
+//    running sums, and the lanes are then added pairwise, as
+//    ((l0 + l4) + (l2 + l6)) + ((l1 + l5) + (l3 + l7)).  This is the order
+//    in which the AVX2 and AVX-512 kernels gather and sum the weights.  The
+//    fastest kernel that the CPU supports is chosen at run time, and the
+//    scalar fallback sums in exactly the same order, so results are
+//    bit-for-bit identical on every machine, provided the compiler does
+//    not fuse multiplies and adds (the Makefile builds with
+//    -ffp-contract=off).
+//
+//  - Sequential order.  Products are added one at a time, left to right,
+//    as earlier versions of sofia-ml did, so that their results can be
+//    reproduced bit-for-bit.  This order is not vectorized.
+//
+// The same orders apply to the update kernels, which add a scaled sparse
+// vector into the weights as SfWeightVector::AddVector() does, and sum the
+// inner product it needs along the way.
+
+#ifndef SF_SPARSE_DOT_H__
+#define SF_SPARSE_DOT_H__
+
+#include "sf-sparse-vector.h"
+
+enum SfSparseDotOrder { SF_LANE_ORDER, SF_SEQUENTIAL_ORDER };
+
+// Sets the order in which SfSparseDot() sums.  This should be done before
+// any training or prediction begins, and not while other threads may be
+// computing inner products.
+void SfSetSparseDotOrder(SfSparseDotOrder order);
+
+// Computes the sparse inner product described above, with the kernel
+// chosen for the current summation order and CPU.
+float SfSparseDot(const float* weights,
+		  const FeatureValuePair* features,
+		  int num_features);
+
+// For each feature i, adds (features[i].value_ * x_scale) / weight_scale
+// to weights[features[i].id_], in double precision as AddVector() does
+// for its double scale_, and returns the sparse inner product of the
+// weights as they were before with x_scale times the vector, summed in the
+// current order.  Feature ids may repeat, as an explicit 0: feature beside
+// the bias does; each repeat then reads the weight as the earlier one left
+// it, in every kernel.  On CPUs without AVX-512, which has no scatter, the
+// lane order kernel is the scalar one.
+float SfSparseAddAndDot(float* weights,
+			const FeatureValuePair* features,
+			int num_features,
+			float x_scale,
+			double weight_scale);
+
+// Name of the kernel that SfSparseDot() uses: "avx512", "avx2", "lanes" or
+// "sequential".
+const char* SfSparseDotKernelName();
+
+// The individual kernels, for tests and benchmarks.  SfSparseDotAvx2() may
+// only be called if SfCpuHasAvx2() is true, and SfSparseDotAvx512() and
+// SfSparseAddAndDotAvx512() only if SfCpuHasAvx512() is true.
+float SfSparseDotSequential(const float* weights,
+			    const FeatureValuePair* features,
+			    int num_features);
+float SfSparseDotLanes(const float* weights,
+		       const FeatureValuePair* features,
+		       int num_features);
+float SfSparseDotAvx2(const float* weights,
+		      const FeatureValuePair* features,
+		      int num_features);
+float SfSparseDotAvx512(const float* weights,
+			const FeatureValuePair* features,
+			int num_features);
+
+float SfSparseAddAndDotSequential(float* weights,
+				  const FeatureValuePair* features,
+				  int num_features,
+				  float x_scale,
+				  double weight_scale);
+float SfSparseAddAndDotLanes(float* weights,
+			     const FeatureValuePair* features,
+			     int num_features,
+			     float x_scale,
+			     double weight_scale);
+float SfSparseAddAndDotAvx512(float* weights,
+			      const FeatureValuePair* features,
+			      int num_features,
+			      float x_scale,
+			      double weight_scale);
+
+// True if the CPU, and this build, support the corresponding kernel.  The
+// AVX-512 kernels need both AVX512F and AVX512CD.
+bool SfCpuHasAvx2();
+bool SfCpuHasAvx512();
+
+#endif  // SF_SPARSE_DOT_H__
@@ -0,0 +1,149 @@
+//================================================================================//
+// Copyright 2026 The sofia-ml Authors                                            //
+//                                                                                //
+// Licensed under the Apache License, Version 2.0 (the "License");                //
+// you may not use this file except in compliance with the License.               //
+// You may obtain a copy of the License at                                        //
+//                                                                                //
+//      http://www.apache.org/licenses/LICENSE-2.0                                //
+//                                                                                //
+// Unless required by applicable law or agreed to in writing, software            //
+// distributed under the License is distributed on an "AS IS" BASIS,              //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.       //
+// See the License for the specific language governing permissions and            //
+// limitations under the License.                                                 //
+//================================================================================//
+//
+// sf-sparse-dot_benchmark.cc
+//
+// Measures the throughput, in millions of features per second, of each
+// sparse inner product kernel on rows of about 75 features, as in RCV1,
+// and of each update kernel, which also adds the row into the weights.
+// Weight vectors of two sizes are used: one that fits in the processor
+// cache, and one far larger, where most gathered weights miss the cache.
+//
+// Usage: ./sf-sparse-dot_benchmark
+
+#include <sys/time.h>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "sf-random.h"
+#include "sf-sparse-dot.h"
+
+using std::string;
+using std::vector;
+
+// Wall-clock time in seconds.
+double WallTime() {
+  struct timeval now;
+  gettimeofday(&now, NULL);
+  return now.tv_sec + now.tv_usec / 1000000.0;
+}
+
+// Times num_passes passes of kernel over every row of features, where row
+// r is [row_offsets[r], row_offsets[r + 1]).
+void Report(const string& name,
+	    float (*kernel)(const float*, const FeatureValuePair*, int),
+	    const vector<float>& weights,
+	    const vector<FeatureValuePair>& features,
+	    const vector<int>& row_offsets,
+	    int num_passes) {
+  double start = WallTime();
+  float total = 0.0;
+  for (int pass = 0; pass < num_passes; ++pass) {
+    for (unsigned int r = 0; r + 1 < row_offsets.size(); ++r) {
+      total += kernel(&weights[0], &features[row_offsets[r]],
+		      row_offsets[r + 1] - row_offsets[r]);
+    }
+  }
+  double num_secs = WallTime() - start;
+  double num_features = static_cast<double>(features.size()) * num_passes;
+  std::cout << "  " << name << ": " << num_features / num_secs / 1e6
+	    << " M features/s (sum " << total << ")" << std::endl;
+}
+
+// As Report(), for an update kernel.  Each pass adds the rows with the
+// opposite sign to the last, so that the weights do not drift.
+void ReportAddAndDot(const string& name,
+		     float (*kernel)(float*, const FeatureValuePair*, int,
+				     float, double),
+		     vector<float> weights,
+		     const vector<FeatureValuePair>& features,
+		     const vector<int>& row_offsets,
+		     int num_passes) {
+  double start = WallTime();
+  float total = 0.0;
+  for (int pass = 0; pass < num_passes; ++pass) {
+    float x_scale = (pass % 2 == 0) ? 0.001 : -0.001;
+    for (unsigned int r = 0; r + 1 < row_offsets.size(); ++r) {
+      total += kernel(&weights[0], &features[row_offsets[r]],
+		      row_offsets[r + 1] - row_offsets[r], x_scale, 0.9);
+    }
+  }
+  double num_secs = WallTime() - start;
+  double num_features = static_cast<double>(features.size()) * num_passes;
+  std::cout << "  " << name << ": " << num_features / num_secs / 1e6
+	    << " M features/s (sum " << total << ")" << std::endl;
+}
+
+// True if id is already among the features of the row that starts at
+// row_begin.
+bool InRow(const vector<FeatureValuePair>& features, int row_begin, int id) {
+  for (unsigned int i = row_begin; i < features.size(); ++i) {
+    if (features[i].id_ == id) return true;
+  }
+  return false;
+}
+
+int main (int argc, char** argv) {
+  SfRandom random(1);
+  int num_rows = 20000;
+  int dimensions[2] = {1 << 14, 1 << 26};
+  for (int d = 0; d < 2; ++d) {
+    vector<float> weights(dimensions[d]);
+    for (unsigned int j = 0; j < weights.size(); ++j) {
+      weights[j] = random.RandFloat() - 0.5;
+    }
+    vector<FeatureValuePair> features;
+    vector<int> row_offsets(1, 0);
+    for (int r = 0; r < num_rows; ++r) {
+      int num_features = 50 + random.RandInt(50);
+      for (int i = 0; i < num_features; ++i) {
+	// The ids of a row are distinct, as the update kernels require.
+	FeatureValuePair pair;
+	do {
+	  pair.id_ = random.RandInt(dimensions[d]);
+	} while (InRow(features, row_offsets.back(), pair.id_));
+	pair.value_ = random.RandFloat();
+	features.push_back(pair);
+      }
+      row_offsets.push_back(features.size());
+    }
+
+    std::cout << dimensions[d] << " weights:" << std::endl;
+    int num_passes = 100;
+    Report("sequential", SfSparseDotSequential, weights, features,
+	   row_offsets, num_passes);
+    Report("lanes", SfSparseDotLanes, weights, features,
+	   row_offsets, num_passes);
+    if (SfCpuHasAvx2()) {
+      Report("avx2", SfSparseDotAvx2, weights, features,
+	     row_offsets, num_passes);
+    }
+    if (SfCpuHasAvx512()) {
+      Report("avx512", SfSparseDotAvx512, weights, features,
+	     row_offsets, num_passes);
+    }
+    ReportAddAndDot("add sequential", SfSparseAddAndDotSequential, weights,
+		    features, row_offsets, num_passes);
+    ReportAddAndDot("add lanes", SfSparseAddAndDotLanes, weights,
+		    features, row_offsets, num_passes);
+    if (SfCpuHasAvx512()) {
+      ReportAddAndDot("add avx512", SfSparseAddAndDotAvx512, weights,
+		      features, row_offsets, num_passes);
+    }
+  }
+}
@@ -0,0 +1,196 @@
+//================================================================================//
+// Copyright 2026 The sofia-ml Authors                                            //
+//                                                                                //
+// Licensed under the Apache License, Version 2.0 (the "License");                //
+// you may not use this file except in compliance with the License.               //
+// You may obtain a copy of the License at                                        //
+//                                                                                //
+//      http://www.apache.org/licenses/LICENSE-2.0                                //
+//                                                                                //
+// Unless required by applicable law or agreed to in writing, software            //
+// distributed under the License is distributed on an "AS IS" BASIS,              //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.       //
+// See the License for the specific language governing permissions and            //
+// limitations under the License.                                                 //
+//================================================================================//
+//
+// sf-sparse-dot_test.cc
+
+#include <assert.h>
+#include <string.h>
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "sf-random.h"
+#include "sf-sparse-dot.h"
+
+using std::string;
+using std::vector;
+
+// True if a and b have exactly the same bits, so that -0.0 and 0.0 differ.
+bool SameBits(float a, float b) {
+  return memcmp(&a, &b, sizeof(float)) == 0;
+}
+
+int main (int argc, char** argv) {
+  // Weights of widely varying magnitude, so that the summation order
+  // changes the rounding.
+  SfRandom random(7);
+  vector<float> weights(1000);
+  for (unsigned int j = 0; j < weights.size(); ++j) {
+    weights[j] = (random.RandFloat() - 0.5) *
+      pow(10.0, random.RandInt(8) - 4.0);
+  }
+
+  bool any_order_differs = false;
+  for (int num_features = 0; num_features <= 70; ++num_features) {
+    for (int trial = 0; trial < 20; ++trial) {
+      vector<FeatureValuePair> features(num_features + 1);
+      float expected = 0.0;
+      for (int i = 0; i < num_features; ++i) {
+	features[i].id_ = random.RandInt(weights.size());
+	features[i].value_ = random.RandFloat() - 0.5;
+	expected += weights[features[i].id_] * features[i].value_;
+      }
+      const FeatureValuePair* x = &features[0];
+
+      // Sequential order sums left to right.
+      float sequential = SfSparseDotSequential(&weights[0], x, num_features);
+      assert(SameBits(sequential, expected));
+
+      // Every lane order kernel gives exactly the same bits.
+      float lanes = SfSparseDotLanes(&weights[0], x, num_features);
+      if (SfCpuHasAvx2()) {
+	assert(SameBits(SfSparseDotAvx2(&weights[0], x, num_features),
+			lanes));
+      }
+      if (SfCpuHasAvx512()) {
+	assert(SameBits(SfSparseDotAvx512(&weights[0], x, num_features),
+			lanes));
+      }
+      assert(fabs(lanes - sequential) <= 1e-3 * (1.0 + fabs(sequential)));
+      if (!SameBits(lanes, sequential)) any_order_differs = true;
+    }
+  }
+  assert(any_order_differs);
+
+  // Products of -0.0 keep their sign alike in every kernel.
+  float zero_weights[2] = {-0.0, 0.0};
+  FeatureValuePair zero_x[3] = {{0, 1.0}, {0, 2.0}, {0, 3.0}};
+  float zero = SfSparseDotLanes(zero_weights, zero_x, 3);
+  if (SfCpuHasAvx2()) {
+    assert(SameBits(SfSparseDotAvx2(zero_weights, zero_x, 3), zero));
+  }
+  if (SfCpuHasAvx512()) {
+    assert(SameBits(SfSparseDotAvx512(zero_weights, zero_x, 3), zero));
+  }
+
+  // The update kernels add the same weights, and sum their inner products
+  // as the dot kernels do.  Ids are distinct, as in an SfSparseVector.
+  for (int num_features = 0; num_features <= 70; ++num_features) {
+    vector<FeatureValuePair> features(num_features + 1);
+    int id = 0;
+    for (int i = 0; i < num_features; ++i) {
+      id += 1 + random.RandInt(10);
+      features[i].id_ = id;
+      features[i].value_ = random.RandFloat() - 0.5;
+    }
+    const FeatureValuePair* x = &features[0];
+    float x_scale = random.RandFloat() - 0.5;
+    // Not a float, as SfWeightVector::scale_ generally is not either.
+    double weight_scale = 1.0 / 3.0 + random.RandFloat();
+
+    // Sequential order sums left to right, as AddVector() once did.
+    vector<float> expected_weights(weights);
+    float expected = 0.0;
+    for (int i = 0; i < num_features; ++i) {
+      float x_value = x[i].value_ * x_scale;
+      expected += weights[x[i].id_] * x_value;
+      expected_weights[x[i].id_] += x_value / weight_scale;
+    }
+    vector<float> sequential_weights(weights);
+    float sequential = SfSparseAddAndDotSequential(
+        &sequential_weights[0], x, num_features, x_scale, weight_scale);
+    assert(SameBits(sequential, expected));
+    assert(sequential_weights == expected_weights);
+
+    // Every lane order kernel gives exactly the same bits.
+    vector<float> lane_weights(weights);
+    float lanes = SfSparseAddAndDotLanes(&lane_weights[0], x, num_features,
+					 x_scale, weight_scale);
+    assert(lane_weights == expected_weights);
+    assert(fabs(lanes - sequential) <= 1e-3 * (1.0 + fabs(sequential)));
+    if (SfCpuHasAvx512()) {
+      vector<float> avx512_weights(weights);
+      assert(SameBits(SfSparseAddAndDotAvx512(&avx512_weights[0], x,
+					      num_features, x_scale,
+					      weight_scale),
+		      lanes));
+      assert(avx512_weights == expected_weights);
+    }
+  }
+
+  // Ids may repeat, as when an explicit 0: feature follows the bias, and
+  // then each update sees the one before it, in the update kernels alike.
+  // Repeats fall both within and across the blocks of the AVX-512 kernel.
+  for (int num_features = 2; num_features <= 40; ++num_features) {
+    vector<FeatureValuePair> features(num_features);
+    for (int i = 0; i < num_features; ++i) {
+      features[i].id_ = random.RandInt(6);
+      features[i].value_ = random.RandFloat() - 0.5;
+    }
+    features[1].id_ = features[0].id_ = 0;
+    const FeatureValuePair* x = &features[0];
+    float x_scale = random.RandFloat() - 0.5;
+    double weight_scale = 1.0 / 3.0 + random.RandFloat();
+
+    vector<float> expected_weights(weights);
+    for (int i = 0; i < num_features; ++i) {
+      expected_weights[x[i].id_] += x[i].value_ * x_scale / weight_scale;
+    }
+    vector<float> sequential_weights(weights);
+    SfSparseAddAndDotSequential(&sequential_weights[0], x, num_features,
+				x_scale, weight_scale);
+    vector<float> lane_weights(weights);
+    float lanes = SfSparseAddAndDotLanes(&lane_weights[0], x, num_features,
+					 x_scale, weight_scale);
+    assert(lane_weights == sequential_weights);
+    for (int j = 0; j < 6; ++j) {
+      assert(fabs(lane_weights[j] - expected_weights[j]) <=
+	     1e-3 * (1.0 + fabs(expected_weights[j])));
+    }
+    if (SfCpuHasAvx512()) {
+      vector<float> avx512_weights(weights);
+      assert(SameBits(SfSparseAddAndDotAvx512(&avx512_weights[0], x,
+					      num_features, x_scale,
+					      weight_scale),
+		      lanes));
+      assert(avx512_weights == lane_weights);
+    }
+  }
+
+  // The bias and an explicit 0: feature, as "1 0:2 1:1" is read.
+  float w_dup[2] = {0.0, 0.0};
+  FeatureValuePair x_dup[3] = {{0, 1.0}, {0, 2.0}, {1, 1.0}};
+  SfSparseAddAndDotLanes(w_dup, x_dup, 3, 0.02, 1.0);
+  assert(w_dup[0] == (0.0f + 0.02f) + 0.04f);
+  if (SfCpuHasAvx512()) {
+    float w_dup_avx512[2] = {0.0, 0.0};
+    SfSparseAddAndDotAvx512(w_dup_avx512, x_dup, 3, 0.02, 1.0);
+    assert(SameBits(w_dup_avx512[0], w_dup[0]));
+    assert(SameBits(w_dup_avx512[1], w_dup[1]));
+  }
+
+  // SfSparseDot() uses the kernel for the order that was set.
+  FeatureValuePair x_2[2] = {{1, 2.0}, {3, 0.5}};
+  float w_4[4] = {0.0, 3.0, 0.0, -4.0};
+  SfSetSparseDotOrder(SF_SEQUENTIAL_ORDER);
+  assert(string(SfSparseDotKernelName()) == "sequential");
+  assert(SfSparseDot(w_4, x_2, 2) == 4.0);
+  SfSetSparseDotOrder(SF_LANE_ORDER);
+  assert(string(SfSparseDotKernelName()) != "sequential");
+  assert(SfSparseDot(w_4, x_2, 2) == 4.0);
+  std::cout << argv[0] << ": PASS" << std::endl;
+}
@@ -18,22 +18,212 @@
 // Implementation of sf-sparse-vector.h
 
 #include <cstring>
-#include <cstdio>
 #include <cstdlib>
 #include <iostream>
 #include <sstream>
 #include "sf-sparse-vector.h"
 
+//----------------------------------------------------------------//
+//------------------- Parsing Helper Functions -------------------//
+//----------------------------------------------------------------//
+
+// Powers of ten that are exactly representable as doubles.
+static const double kExactPowersOfTen[] = {
+  1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+  1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+// Longest number we will hand to the C library in the slow path.
+static const int kMaxNumberLength = 127;
+
+static inline bool IsSpace(char c) {
+  return c == ' ' || c == '\t' || c == '\n' ||
+    c == '\v' || c == '\f' || c == '\r';
+}
+
+static inline bool IsDigit(char c) {
+  return c >= '0' && c <= '9';
+}
+
+// Returns a pointer to the first non-space character in [position, end).
+static inline const char* SkipSpaces(const char* position, const char* end) {
+  while (position < end && IsSpace(*position)) ++position;
+  return position;
+}
+
+// Returns a pointer to the first space or '#' character in [position, end).
+static inline const char* SkipToken(const char* position, const char* end) {
+  while (position < end && !IsSpace(*position) && *position != '#')
+    ++position;
+  return position;
+}
+
+// Parses an integer the same way as atoi(), reading no further than end,
+// and advances *position past the digits read.
+static inline int ParseInt(const char** position, const char* end) {
+  const char* p = *position;
+  bool negative = false;
+  if (p < end && (*p == '-' || *p == '+')) {
+    negative = (*p == '-');
+    ++p;
+  }
+  unsigned int value = 0;
+  while (p < end && IsDigit(*p)) {
+    value = value * 10 + (*p - '0');
+    ++p;
+  }
+  *position = p;
+  return static_cast<int>(negative ? 0u - value : value);
+}
+
+// Hands the number starting at *position to strtod() or strtof(), using a
+// NUL-terminated copy so that we never read past end.
+static bool ParseWithLibrary(const char** position,
+			     const char* end,
+			     bool as_float,
+			     double* value) {
+  char number[kMaxNumberLength + 1];
+  int length = 0;
+  while ((*position) + length < end && length < kMaxNumberLength &&
+	 !IsSpace((*position)[length])) {
+    number[length] = (*position)[length];
+    ++length;
+  }
+  number[length] = '\0';
+  char* number_end;
+  if (as_float) {
+    *value = strtof(number, &number_end);
+  } else {
+    *value = strtod(number, &number_end);
+  }
+  if (number_end == number) return false;
+  *position += number_end - number;
+  return true;
+}
+
+// Parses a real number the same way as strtod(), reading no further than
+// end, and advances *position past the number.  Returns false, leaving
+// *position unchanged, if there is no number to parse.
+//
+// Plain decimals with at most 19 significant digits use Clinger's fast
+// path: when the digits fit in 53 bits and the power of ten is exact, a
+// single IEEE multiply or divide gives the correctly rounded result, which
+// is exactly what strtod() returns.  Anything else (long mantissas, large
+// exponents, inf, nan, hex floats) falls back to the C library.
+static bool ParseDouble(const char** position, const char* end,
+			double* value) {
+  const char* p = *position;
+  bool negative = false;
+  if (p < end && (*p == '-' || *p == '+')) {
+    negative = (*p == '-');
+    ++p;
+  }
+
+  unsigned long long mantissa = 0;
+  int significant_digits = 0;
+  int exponent = 0;
+  bool has_digits = false;
+  bool too_many_digits = false;
+  while (p < end && IsDigit(*p)) {
+    has_digits = true;
+    if (significant_digits < 19) {
+      mantissa = mantissa * 10 + (*p - '0');
+      if (mantissa != 0) ++significant_digits;
+    } else {
+      too_many_digits = true;
+    }
+    ++p;
+  }
+  if (p < end && *p == '.') {
+    ++p;
+    while (p < end && IsDigit(*p)) {
+      has_digits = true;
+      if (significant_digits < 19) {
+	mantissa = mantissa * 10 + (*p - '0');
+	if (mantissa != 0) ++significant_digits;
+	--exponent;
+      } else {
+	too_many_digits = true;
+      }
+      ++p;
+    }
+  }
+  // Digits followed by an x begin a hex float, as in "0x10".
+  if (!has_digits || (p < end && (*p == 'x' || *p == 'X'))) {
+    return ParseWithLibrary(position, end, false, value);
+  }
+
+  if (p < end && (*p == 'e' || *p == 'E')) {
+    const char* q = p + 1;
+    bool negative_exponent = false;
+    if (q < end && (*q == '-' || *q == '+')) {
+      negative_exponent = (*q == '-');
+      ++q;
+    }
+    // An 'e' with no digits after it is not part of the number.
+    if (q < end && IsDigit(*q)) {
+      int explicit_exponent = 0;
+      while (q < end && IsDigit(*q)) {
+	if (explicit_exponent < 100000) {
+	  explicit_exponent = explicit_exponent * 10 + (*q - '0');
+	}
+	++q;
+      }
+      exponent += negative_exponent ? -explicit_exponent : explicit_exponent;
+      p = q;
+    }
+  }
+
+  if (too_many_digits ||
+      mantissa > (1ULL << 53) ||
+      exponent < -22 || exponent > 22) {
+    return ParseWithLibrary(position, end, false, value);
+  }
+
+  double result = static_cast<double>(mantissa);
+  if (exponent < 0) {
+    result /= kExactPowersOfTen[-exponent];
+  } else {
+    result *= kExactPowersOfTen[exponent];
+  }
+  *value = negative ? -result : result;
+  *position = p;
+  return true;
+}
+
+// Parses a class label the same way as sscanf("%f").  The label is read as
+// a double first; unless that double is exactly representable as a float
+// (as labels almost always are), rounding it to float could differ from
+// strtof(), so we ask the C library instead.
+static bool ParseLabel(const char** position, const char* end, float* label) {
+  const char* start = *position;
+  double value;
+  if (!ParseDouble(position, end, &value)) return false;
+  if (static_cast<double>(static_cast<float>(value)) != value) {
+    *position = start;
+    if (!ParseWithLibrary(position, end, true, &value)) return false;
+  }
+  *label = static_cast<float>(value);
+  return true;
+}
+
 //----------------------------------------------------------------//
 //---------------- SfSparseVector Public Methods ----------------//
 //----------------------------------------------------------------//
+SfSparseVector::SfSparseVector()
+  : y_(0.0),
+    a_(0.0),
+    squared_norm_(0.0),
+    group_id_("") {
+}
+
 SfSparseVector::SfSparseVector(const char* in_string)
   : y_(0.0), 
     a_(0.0),
     squared_norm_(0.0),
     group_id_("") {
   NoBias();
-  Init(in_string);
+  Init(in_string, in_string + strlen(in_string));
 }
 
 SfSparseVector::SfSparseVector(const char* in_string,
@@ -47,16 +237,30 @@ SfSparseVector::SfSparseVector(const char* in_string,
   } else {
     NoBias();
   }
-  Init(in_string);
+  Init(in_string, in_string + strlen(in_string));
+}
+
+SfSparseVector::SfSparseVector(const char* begin,
+			       const char* end,
+			       bool use_bias_term)
+  : y_(0.0),
+    a_(0.0),
+    squared_norm_(0.0),
+    group_id_("") {
+  if (use_bias_term) {
+    SetBias();
+  } else {
+    NoBias();
+  }
+  Init(begin, end);
 }
 
-SfSparseVector::SfSparseVector(const SfSparseVector& a,
-				 const SfSparseVector& b,
-				 float y) 
+SfSparseVector::SfSparseVector(const SfSparseVectorView& a,
+			       const SfSparseVectorView& b,
+			       float y)
   : y_(y),
     a_(0.0),
     squared_norm_(0.0) {
-  group_id_ = a.GetGroupId();
   int a_i = 0;
   int b_i = 0;
   while (a_i < a.NumFeatures() || b_i < b.NumFeatures()) {
@@ -91,6 +295,40 @@ SfSparseVector::SfSparseVector(const SfSparseVector& a,
   }
 }
 
+SfSparseVector::SfSparseVector(const SfSparseVectorView& x)
+  : features_(x.Features(), x.Features() + x.NumFeatures()),
+    y_(x.GetY()),
+    a_(0.0),
+    squared_norm_(x.GetSquaredNorm()),
+    group_id_("") {
+}
+
+void SfSparseVector::Parse(const char* begin,
+			   const char* end,
+			   bool use_bias_term) {
+  features_.clear();
+  y_ = 0.0;
+  a_ = 0.0;
+  squared_norm_ = 0.0;
+  group_id_.clear();
+  comment_.clear();
+  if (use_bias_term) {
+    SetBias();
+  } else {
+    NoBias();
+  }
+  Init(begin, end);
+}
+
+void SfSparseVector::Assign(const SfSparseVectorView& x) {
+  features_.assign(x.Features(), x.Features() + x.NumFeatures());
+  y_ = x.GetY();
+  a_ = 0.0;
+  squared_norm_ = x.GetSquaredNorm();
+  group_id_.clear();
+  comment_.clear();
+}
+
 string SfSparseVector::AsString() const {
   std::stringstream out_stream;
   out_stream << y_ << " ";
@@ -103,6 +341,23 @@ string SfSparseVector::AsString() const {
   return out_stream.str();
 }
 
+int SfSparseVectorView::MaxFeatureId() const {
+  int max_feature_id = 0;
+  for (int i = 0; i < num_features_; ++i) {
+    if (features_[i].id_ > max_feature_id) max_feature_id = features_[i].id_;
+  }
+  return max_feature_id;
+}
+
+string SfSparseVectorView::AsString() const {
+  std::stringstream out_stream;
+  out_stream << y_ << " ";
+  for (int i = 0; i < NumFeatures(); ++i) {
+    out_stream << FeatureAt(i) << ":" << ValueAt(i) << " ";
+  }
+  return out_stream.str();
+}
+
 void SfSparseVector::PushPair(int id, float value) {
   if (id > 0 && NumFeatures() > 0 && id <= FeatureAt(NumFeatures() - 1) ) {
     std::cerr << id << " vs. " << FeatureAt(NumFeatures() - 1) << std::endl;
@@ -125,50 +380,47 @@ void SfSparseVector::DieFormat(const string& reason) {
   exit(1);
 }
 
-void SfSparseVector::Init(const char* in_string) {
-  int length = strlen(in_string);
-  if (length == 0) DieFormat("Empty example string.");
- 
+void SfSparseVector::Init(const char* begin, const char* end) {
+  const char* position = SkipSpaces(begin, end);
+  if (position == end) DieFormat("Empty example string.");
+
   // Get class label.
-  if (!sscanf(in_string, "%f", &y_))
+  if (!ParseLabel(&position, end, &y_))
     DieFormat("Class label must be real number.");
+  position = SkipSpaces(SkipToken(position, end), end);
 
   // Parse the group id, if any.
-  const char* position;
-  position = strchr(in_string, ' ') + 1;
-  if ((position[0] >= 'a' && position[0] <= 'z') ||
-      (position[0] >= 'A' && position[0] <= 'Z')) {
-    position = strchr(position, ':') + 1;
-    const char* end = strchr(position, ' ');
-    char group_id_c_string[1000];
-    strncpy(group_id_c_string, position, end - position);
-    group_id_ = group_id_c_string;
-    position = end + 1;
-  } 
+  if (position < end &&
+      ((position[0] >= 'a' && position[0] <= 'z') ||
+       (position[0] >= 'A' && position[0] <= 'Z'))) {
+    const char* colon = position;
+    while (colon < end && *colon != ':' && !IsSpace(*colon)) ++colon;
+    if (colon == end || *colon != ':')
+      DieFormat("Group id must be given as <prefix>:<id>.");
+    const char* group_id_end = SkipToken(colon + 1, end);
+    group_id_.assign(colon + 1, group_id_end);
+    position = SkipSpaces(group_id_end, end);
+  }
 
   // Get feature:value pairs.
-  for ( ;
-       (position < in_string + length 
-	&& position - 1 != NULL
-	&& position[0] != '#');
-       position = strchr(position, ' ') + 1) {
-    
-    // Consume multiple spaces, if needed.
-    if (position[0] == ' ' || position[0] == '\n' ||
-	position[0] == '\v' || position[0] == '\r') {
-      continue;
-    };
-    
-    // Parse the feature-value pair.
-    int id = atoi(position);
-    position = strchr(position, ':') + 1;
-    float value = atof(position);
+  while (position < end && position[0] != '#') {
+    int id = ParseInt(&position, end);
+    while (position < end && *position != ':' && !IsSpace(*position))
+      ++position;
+    if (position == end || *position != ':')
+      DieFormat("Features must be given as <feature>:<value>.");
+    ++position;
+
+    // As with atof(), a missing value is read as 0 and any trailing
+    // characters in the token are ignored.
+    double value = 0.0;
+    ParseDouble(&position, end, &value);
     PushPair(id, value);
+    position = SkipSpaces(SkipToken(position, end), end);
   }
 
   // Parse comment, if any.
-  position = strchr(in_string, '#');
-  if (position != NULL) {
-    comment_ = string(position + 1);
+  if (position < end) {
+    comment_.assign(position + 1, end);
   }
 }
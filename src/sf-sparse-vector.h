@@ -38,6 +38,9 @@
 //
 // Note that features must be sorted in ascending order, by feature id.
 // Also, feature id 0 is reserved for the bias term.
+//
+// Parsing is done in a single pass over the input, without any calls to
+// sscanf(), atoi() or atof(), and without copying the input string.
 
 #ifndef SF_SPARSE_VECTOR_H__
 #define SF_SPARSE_VECTOR_H__
@@ -58,8 +61,14 @@ struct FeatureValuePair {
   float value_;
 };
 
+class SfSparseVectorView;
+
 class SfSparseVector {
  public:
+  // Constructs an empty vector with label 0 and no features at all, not
+  // even a bias term.  Useful as a placeholder to be assigned to later.
+  SfSparseVector();
+
   // Construct a new vector from a string.  Input format is svm-light format:
   // <label> <feature>:<value> ... <feature:value> # comment<\n>
   // No bias term is used.
@@ -69,9 +78,29 @@ class SfSparseVector {
   // term to 1 iff use_bias_term is set to true.
   SfSparseVector(const char* in_string, bool use_bias_term);
 
+  // Constructs a new vector from the svm-light format string in the range
+  // [begin, end), which need not be NUL-terminated.  Sets the bias term
+  // to 1 iff use_bias_term is set to true.
+  SfSparseVector(const char* begin, const char* end, bool use_bias_term);
+
   // Construct a new vector that is the difference of two vectors, (a - b).
-  // This is useful for ranking problems, etc.
-  SfSparseVector(const SfSparseVector& a, const SfSparseVector& b, float y);
+  // This is useful for ranking problems, etc.  The new vector has no
+  // group id.
+  SfSparseVector(const SfSparseVectorView& a,
+		 const SfSparseVectorView& b,
+		 float y);
+
+  // Constructs a copy of the features, label and squared norm of x.
+  explicit SfSparseVector(const SfSparseVectorView& x);
+
+  // Replaces the contents of this vector with those parsed from the
+  // svm-light format string [begin, end), as for the constructor above,
+  // but reusing the storage already allocated by this vector.
+  void Parse(const char* begin, const char* end, bool use_bias_term);
+
+  // Replaces the contents of this vector with a copy of x, as for the
+  // constructor above, reusing the storage already allocated by this vector.
+  void Assign(const SfSparseVectorView& x);
 
   // Returns a string-format representation of the vector, in svm-light format.
   string AsString() const;
@@ -101,11 +130,15 @@ class SfSparseVector {
   void ClearFeatures() { features_.clear(); squared_norm_ = 0; }
 
  private:
+  friend class SfSparseVectorView;
+  // Rewrites feature ids in place, in SfFeatureMap::MapVector().
+  friend class SfFeatureMap;
+
   void AddToSquaredNorm(float addend) { squared_norm_ += addend; }
 
   // Common initialization method shared by constructors, adding vector data
-  // by parsing a string in SVM-light format.
-  void Init(const char* in_string);
+  // by parsing the string [begin, end) in SVM-light format.
+  void Init(const char* begin, const char* end);
 
   // Sets up the bias term, indexed by feature id 0.
   void SetBias() { PushPair(0, 1); }
@@ -141,4 +174,48 @@ class SfSparseVector {
   string comment_;
 };
 
+// A read-only view of a sparse vector whose features are stored elsewhere,
+// such as one example of an SfDataSet.  A SfSparseVector converts to a view
+// implicitly, so methods taking a view accept either.  Views are cheap to
+// copy, and remain valid only as long as the storage they point into.
+class SfSparseVectorView {
+ public:
+  // A view of num_features features starting at features.
+  SfSparseVectorView(const FeatureValuePair* features,
+		     int num_features,
+		     float y,
+		     float squared_norm)
+    : features_(features),
+      num_features_(num_features),
+      y_(y),
+      squared_norm_(squared_norm) {}
+
+  // A view of the features of x, valid until x is changed.
+  SfSparseVectorView(const SfSparseVector& x)
+    : features_(x.features_.empty() ? NULL : &x.features_[0]),
+      num_features_(x.features_.size()),
+      y_(x.y_),
+      squared_norm_(x.squared_norm_) {}
+
+  // Returns a string-format representation of the vector, in svm-light
+  // format, as for SfSparseVector::AsString().
+  string AsString() const;
+
+  // Returns the largest feature id, or 0 if there are no features.
+  int MaxFeatureId() const;
+
+  inline int NumFeatures() const { return num_features_; }
+  inline int FeatureAt(int i) const { return features_[i].id_; }
+  inline float ValueAt(int i) const { return features_[i].value_; }
+  inline const FeatureValuePair* Features() const { return features_; }
+  float GetY() const { return y_; }
+  float GetSquaredNorm() const { return squared_norm_; }
+
+ private:
+  const FeatureValuePair* features_;
+  int num_features_;
+  float y_;
+  float squared_norm_;
+};
+
 #endif // SF_SPARSE_VECTOR_H__
@@ -0,0 +1,226 @@
+//================================================================================//
+// Copyright 2026 The sofia-ml Authors                                            //
+//                                                                                //
+// Licensed under the Apache License, Version 2.0 (the "License");                //
+// you may not use this file except in compliance with the License.               //
+// You may obtain a copy of the License at                                        //
+//                                                                                //
+//      http://www.apache.org/licenses/LICENSE-2.0                                //
+//                                                                                //
+// Unless required by applicable law or agreed to in writing, software            //
+// distributed under the License is distributed on an "AS IS" BASIS,              //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.       //
+// See the License for the specific language governing permissions and            //
+// limitations under the License.                                                 //
+//================================================================================//
+//
+// sf-sparse-vector_benchmark.cc
+//
+// Measures parsing throughput, in MB/s, of SfDataSet loading a file of
+// svm-light data, against the original getline() + sscanf()/atoi()/atof()
+// parsing path, which is reproduced here for comparison.  The same data
+// is also parsed from a gzip-compressed copy, to show the cost of
+// decompressing it; throughput is given in uncompressed MB/s.
+//
+// Usage: ./sf-sparse-vector_benchmark [svm-light file]
+// With no file, a synthetic RCV1-like file is generated and used.
+
+#include <sys/time.h>
+#include <zlib.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "sf-data-set.h"
+
+using std::string;
+using std::vector;
+
+static const char* kSyntheticFileName = "sf-sparse-vector_benchmark.tmp";
+static const char* kGzipFileName = "sf-sparse-vector_benchmark.tmp.gz";
+
+// The original parsing path, kept only as a baseline for comparison.
+struct LegacyVector {
+  vector<FeatureValuePair> features_;
+  float y_;
+  float squared_norm_;
+  string group_id_;
+  string comment_;
+};
+
+void LegacyPushPair(int id, float value, LegacyVector* x) {
+  FeatureValuePair feature_value_pair;
+  feature_value_pair.id_ = id;
+  feature_value_pair.value_ = value;
+  x->features_.push_back(feature_value_pair);
+  x->squared_norm_ += value * value;
+}
+
+void LegacyInit(const char* in_string, LegacyVector* x) {
+  x->y_ = 0.0;
+  x->squared_norm_ = 0.0;
+  LegacyPushPair(0, 1, x);
+  int length = strlen(in_string);
+  if (length == 0) return;
+  sscanf(in_string, "%f", &x->y_);
+
+  const char* position;
+  position = strchr(in_string, ' ') + 1;
+  if ((position[0] >= 'a' && position[0] <= 'z') ||
+      (position[0] >= 'A' && position[0] <= 'Z')) {
+    position = strchr(position, ':') + 1;
+    const char* end = strchr(position, ' ');
+    char group_id_c_string[1000];
+    strncpy(group_id_c_string, position, end - position);
+    group_id_c_string[end - position] = '\0';
+    x->group_id_ = group_id_c_string;
+    position = end + 1;
+  }
+
+  // As in the original, but stopping when strchr() finds no more spaces.
+  while (position < in_string + length && position[0] != '#') {
+    if (position[0] != ' ' && position[0] != '\n' &&
+	position[0] != '\v' && position[0] != '\r') {
+      int id = atoi(position);
+      position = strchr(position, ':') + 1;
+      float value = atof(position);
+      LegacyPushPair(id, value, x);
+    }
+    position = strchr(position, ' ');
+    if (position == NULL) break;
+    ++position;
+  }
+
+  position = strchr(in_string, '#');
+  if (position != NULL) {
+    x->comment_ = string(position + 1);
+  }
+}
+
+long int LegacyLoad(const string& file_name) {
+  long int buffer_size = 40 * 1024 * 1024;
+  char* local_buffer = new char[buffer_size];
+  std::ifstream file_stream(file_name.c_str(), std::ifstream::in);
+  file_stream.rdbuf()->pubsetbuf(local_buffer, buffer_size);
+  vector<LegacyVector> vectors;
+  string line_string;
+  while (getline(file_stream, line_string)) {
+    LegacyVector x;
+    LegacyInit(line_string.c_str(), &x);
+    vectors.push_back(x);
+  }
+  delete[] local_buffer;
+  return vectors.size();
+}
+
+long int CurrentLoad(const string& file_name, int num_threads) {
+  SfDataSet data_set(file_name, 40, true, num_threads);
+  return data_set.NumExamples();
+}
+
+// Writes num_examples lines of sparse tf-idf style data, with roughly
+// 75 non-zero features per line drawn from 50000 feature ids.
+void WriteSyntheticFile(const string& file_name, int num_examples) {
+  FILE* file = fopen(file_name.c_str(), "w");
+  if (file == NULL) {
+    std::cerr << "Error writing file " << file_name << std::endl;
+    exit(1);
+  }
+  srand(1);
+  for (int i = 0; i < num_examples; ++i) {
+    fprintf(file, "%d qid:%d", (rand() % 2) ? 1 : -1, i / 20);
+    int id = 0;
+    for (int j = 0; j < 75; ++j) {
+      id += 1 + rand() % 1300;
+      fprintf(file, " %d:%.6g", id, static_cast<float>(rand()) / RAND_MAX);
+    }
+    fprintf(file, " #doc%d\n", i);
+  }
+  fclose(file);
+}
+
+// Writes a gzip-compressed copy of file_name to gzip_file_name.
+void WriteGzipCopy(const string& file_name, const string& gzip_file_name) {
+  FILE* file = fopen(file_name.c_str(), "r");
+  gzFile gzip_file = gzopen(gzip_file_name.c_str(), "wb");
+  if (file == NULL || gzip_file == NULL) {
+    std::cerr << "Error writing file " << gzip_file_name << std::endl;
+    exit(1);
+  }
+  char buffer[65536];
+  size_t num_read;
+  while ((num_read = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+    gzwrite(gzip_file, buffer, num_read);
+  }
+  gzclose(gzip_file);
+  fclose(file);
+}
+
+long int FileSize(const string& file_name) {
+  FILE* file = fopen(file_name.c_str(), "r");
+  if (file == NULL) {
+    std::cerr << "Error reading file " << file_name << std::endl;
+    exit(1);
+  }
+  fseek(file, 0, SEEK_END);
+  long int size = ftell(file);
+  fclose(file);
+  return size;
+}
+
+// Wall-clock time in seconds.  Processor time, as from clock(), would
+// count the time of all parsing threads together.
+double WallTime() {
+  struct timeval now;
+  gettimeofday(&now, NULL);
+  return now.tv_sec + now.tv_usec / 1000000.0;
+}
+
+void Report(const string& name, long int bytes, long int examples,
+	    double start) {
+  float num_secs = WallTime() - start;
+  std::cout << name << ": " << examples << " examples in " << num_secs
+	    << " s, " << (bytes / (1024.0 * 1024.0)) / num_secs << " MB/s"
+	    << std::endl;
+}
+
+int main (int argc, char** argv) {
+  string file_name;
+  if (argc > 1) {
+    file_name = argv[1];
+  } else {
+    file_name = kSyntheticFileName;
+    WriteSyntheticFile(file_name, 100000);
+  }
+  long int bytes = FileSize(file_name);
+  std::cout << "Parsing " << file_name << " (" << bytes << " bytes)"
+	    << std::endl;
+
+  // Warm the page cache so that both paths measure parsing, not disk.
+  CurrentLoad(file_name, 1);
+
+  double legacy_start = WallTime();
+  long int legacy_examples = LegacyLoad(file_name);
+  Report("getline + sscanf/atoi/atof", bytes, legacy_examples, legacy_start);
+
+  for (int num_threads = 1; num_threads <= 8; num_threads *= 2) {
+    double current_start = WallTime();
+    long int current_examples = CurrentLoad(file_name, num_threads);
+    std::ostringstream name;
+    name << "SfDataSet, " << num_threads << " thread(s)";
+    Report(name.str(), bytes, current_examples, current_start);
+  }
+
+  WriteGzipCopy(file_name, kGzipFileName);
+  double gzip_start = WallTime();
+  long int gzip_examples = CurrentLoad(kGzipFileName, 1);
+  Report("SfDataSet, gzip", bytes, gzip_examples, gzip_start);
+  remove(kGzipFileName);
+
+  if (argc <= 1) remove(kSyntheticFileName);
+}
@@ -15,6 +15,7 @@
 //================================================================================//
 //
 #include <assert.h>
+#include <cstdlib>
 #include <iostream>
 #include "sf-sparse-vector.h"
 
@@ -97,5 +98,47 @@ int main (int argc, char** argv) {
   assert(x8.FeatureAt(2) == 4);
   assert(x8.GetGroupId() == "");
 
+  // Test parsing from a range that is not NUL-terminated.
+  char x9_string [100] = "-1 qid:17 3:0.5 10:1e-2 12:-.25 #doc 9XXXX";
+  SfSparseVector x9(x9_string, x9_string + 38, false);
+  assert(x9.GetY() == -1.0);
+  assert(x9.GetGroupId() == "17");
+  assert(x9.NumFeatures() == 4);
+  assert(x9.FeatureAt(1) == 3 && x9.ValueAt(1) == 0.5);
+  assert(x9.FeatureAt(2) == 10 && x9.ValueAt(2) == static_cast<float>(0.01));
+  assert(x9.FeatureAt(3) == 12 && x9.ValueAt(3) == -0.25);
+  assert(x9.GetComment() == string("doc 9"));
+
+  // Test that values agree with atof(), including values that need more
+  // than the fast path, and that a group id may end the line.
+  char x10_string [200] =
+    "0.1 g:a 1:0.1 2:3.4028234663852886e38 3:0.30000000000000000001 "
+    "4:1e-40 5:123456789012345678901234 6:5e-324";
+  SfSparseVector x10(x10_string);
+  assert(x10.GetY() == 0.1f);
+  assert(x10.GetGroupId() == "a");
+  assert(x10.ValueAt(1) == static_cast<float>(atof("0.1")));
+  assert(x10.ValueAt(2) == static_cast<float>(atof("3.4028234663852886e38")));
+  assert(x10.ValueAt(3) == static_cast<float>(atof("0.30000000000000000001")));
+  assert(x10.ValueAt(4) == static_cast<float>(atof("1e-40")));
+  assert(x10.ValueAt(5) ==
+	 static_cast<float>(atof("123456789012345678901234")));
+  assert(x10.ValueAt(6) == static_cast<float>(atof("5e-324")));
+  SfSparseVector x11("2 qid:4");
+  assert(x11.GetY() == 2.0 && x11.GetGroupId() == "4");
+  assert(x11.NumFeatures() == 1);
+
+  // Hex floats agree with atof() too.
+  SfSparseVector x13("0x2 3:0x10 4:-0X1.8p1");
+  assert(x13.GetY() == static_cast<float>(atof("0x2")));
+  assert(x13.FeatureAt(1) == 3 && x13.ValueAt(1) == 16);
+  assert(x13.FeatureAt(2) == 4 && x13.ValueAt(2) == -3);
+
+  // Test tab-separated and carriage-return terminated input.
+  char x12_string [100] = "1\t1:1.0\t2:2.5\t4:-2\r";
+  SfSparseVector x12(x12_string);
+  assert(x12.GetSquaredNorm() == 11.25);
+  assert(x12.FeatureAt(3) == 4 && x12.ValueAt(3) == -2);
+
   std::cout << argv[0] << ": PASS" << std::endl;
 }
@@ -21,12 +21,14 @@
 //
 // Implementation of sf-weight-vector.h
 
+#include <algorithm>
 #include <cmath>
 #include <cstdlib>
 #include <iostream>
 #include <sstream>
 #include <string>
 
+#include "sf-sparse-dot.h"
 #include "sf-weight-vector.h"
 
 //----------------------------------------------------------------//
@@ -115,19 +117,16 @@ string SfWeightVector::AsString() {
   return out_string_stream.str();
 }
 
-float SfWeightVector::InnerProduct(const SfSparseVector& x,
+float SfWeightVector::InnerProduct(const SfSparseVectorView& x,
 				    float x_scale) const {
-  float inner_product = 0.0;
-  for (int i = 0; i < x.NumFeatures(); ++i) {
-    inner_product += weights_[x.FeatureAt(i)] * x.ValueAt(i);
-  }
+  float inner_product = SfSparseDot(weights_, x.Features(), x.NumFeatures());
   inner_product *= x_scale;
   inner_product *= scale_;
   return inner_product;
 }
 
-float SfWeightVector::InnerProductOnDifference(const SfSparseVector& a,
-					       const SfSparseVector& b,
+float SfWeightVector::InnerProductOnDifference(const SfSparseVectorView& a,
+					       const SfSparseVectorView& b,
 					       float x_scale) const {
   //   <x_scale * (a - b), w>
   // = <x_scale * a - x_scale * b, w>
@@ -139,8 +138,27 @@ float SfWeightVector::InnerProductOnDifference(const SfSparseVector& a,
   return inner_product;
 }
 
-void SfWeightVector::AddVector(const SfSparseVector& x, float x_scale) {
-  if (x.FeatureAt(x.NumFeatures() - 1) > dimensions_) {
+bool SfWeightVector::TakeStep(const SfSparseVectorView& x,
+			      SfStepRule* rule) {
+  return TakeStepWith(x, rule);
+}
+
+bool SfWeightVector::TakeRankStep(const SfSparseVectorView& a,
+				  const SfSparseVectorView& b,
+				  SfStepRule* rule) {
+  return TakeRankStepWith(a, b, rule);
+}
+
+void SfWeightVector::PrefetchWeights(const SfSparseVectorView& x) const {
+  for (int i = 0; i < x.NumFeatures(); ++i) {
+    if (x.FeatureAt(i) < dimensions_) {
+      __builtin_prefetch(weights_ + x.FeatureAt(i));
+    }
+  }
+}
+
+void SfWeightVector::AddVector(const SfSparseVectorView& x, float x_scale) {
+  if (x.FeatureAt(x.NumFeatures() - 1) >= dimensions_) {
     std::cerr << "Feature " << x.FeatureAt(x.NumFeatures() - 1) 
 	      << " exceeds dimensionality of weight vector: " 
 	      << dimensions_ << std::endl;
@@ -148,17 +166,26 @@ void SfWeightVector::AddVector(const SfSparseVector& x, float x_scale) {
     exit(1);
   }
 
-  float inner_product = 0.0;
-  for (int i = 0; i < x.NumFeatures(); ++i) {
-    float this_x_value = x.ValueAt(i) * x_scale;
-    int this_x_feature = x.FeatureAt(i);
-    inner_product += weights_[this_x_feature] * this_x_value;
-    weights_[this_x_feature] += this_x_value / scale_;
-  }
+  float inner_product = SfSparseAddAndDot(weights_, x.Features(),
+					  x.NumFeatures(), x_scale, scale_);
   squared_norm_ += x.GetSquaredNorm() * x_scale * x_scale +
     (2.0 * scale_ * inner_product); 
 }
 
+void SfWeightVector::GrowToFit(int max_feature_id) {
+  if (max_feature_id < dimensions_) return;
+  float* new_weights = new float[max_feature_id + 1];
+  for (int i = 0; i < dimensions_; ++i) {
+    new_weights[i] = weights_[i];
+  }
+  for (int i = dimensions_; i <= max_feature_id; ++i) {
+    new_weights[i] = 0;
+  }
+  delete[] weights_;
+  weights_ = new_weights;
+  dimensions_ = max_feature_id + 1;
+}
+
 void SfWeightVector::ScaleBy(double scaling_factor) {
   // Take care of any numerical difficulties.
   if (scale_ < 0.00000000001) ScaleToOne();
@@ -232,7 +259,7 @@ void SfWeightVector::ProjectToL1Ball(float lambda, float epsilon) {
 }
 
 
-void SfWeightVector::ProjectToL1Ball(float lambda) {
+void SfWeightVector::ProjectToL1Ball(float lambda, SfRandom* random) {
   // Bail out early if possible.
   float current_l1 = 0.0;
   for (int i = 0; i < dimensions_; ++i) {
@@ -261,7 +288,7 @@ void SfWeightVector::ProjectToL1Ball(float lambda) {
   while (U->size() > 0) {
     G->clear();
     L->clear();
-    int k = (*U)[static_cast<int>(rand() % U->size())];
+    int k = (*U)[random->RandInt(U->size())];
     float pivot_k = fabsf(ValueOf(k));
     float partial_sum_delta = fabsf(ValueOf(k));
     float partial_pivot_delta = 1.0;
@@ -304,6 +331,54 @@ void SfWeightVector::ProjectToL1Ball(float lambda) {
   scale_ = 1.0;
 }
 
+double SfWeightVector::AverageRange(const vector<SfWeightVector*>& replicas,
+				    int begin,
+				    int end) {
+  // The means are taken a chunk at a time, adding in one replica after
+  // another, so that each inner loop runs over contiguous weights and is
+  // vectorized.  The replicas are always added in the same order, so the
+  // result does not depend on which thread averages which range.
+  const int kChunkSize = 256;
+  float means[kChunkSize];
+  float inverse_num_replicas = 1.0 / replicas.size();
+  double squared_norm = 0.0;
+  for (int chunk = begin; chunk < end; chunk += kChunkSize) {
+    int size = std::min(kChunkSize, end - chunk);
+    for (int i = 0; i < size; ++i) {
+      means[i] = 0.0;
+    }
+    for (unsigned int r = 0; r < replicas.size(); ++r) {
+      const float* weights = replicas[r]->weights_ + chunk;
+      float scale = replicas[r]->scale_;
+      for (int i = 0; i < size; ++i) {
+	means[i] += weights[i] * scale;
+      }
+    }
+    for (int i = 0; i < size; ++i) {
+      means[i] *= inverse_num_replicas;
+      squared_norm += means[i] * means[i];
+    }
+    // Every replica gets the same means, bit for bit; the scales they were
+    // read with are set to 1 by FinishAveraging().
+    for (unsigned int r = 0; r < replicas.size(); ++r) {
+      std::copy(means, means + size, replicas[r]->weights_ + chunk);
+    }
+  }
+  return squared_norm;
+}
+
+void SfWeightVector::FinishAveraging(double squared_norm) {
+  scale_ = 1.0;
+  squared_norm_ = squared_norm;
+}
+
+void SfWeightVector::RecomputeSquaredNorm() {
+  double squared_norm = 0.0;
+  for (int i = 0; i < dimensions_; ++i) {
+    squared_norm += static_cast<double>(weights_[i]) * weights_[i];
+  }
+  squared_norm_ = squared_norm * scale_ * scale_;
+}
 
 //-----------------------------------------------------------------//
 //---------------- SfWeightVector Private Methods ----------------//
@@ -33,10 +33,26 @@
 #ifndef SF_WEIGHT_VECTOR_H__
 #define SF_WEIGHT_VECTOR_H__
 
+#include "sf-random.h"
 #include "sf-sparse-vector.h"
 
 using std::string;
 
+class SfSharedWeightVector;
+class SfWeightVector;
+
+// The update rule of one learner step on an example x, which may be the
+// difference of two examples for a rank step.  It decides the update once
+// the inner product <x, w> is known.  See TakeStep() below.
+class SfStepRule {
+ public:
+  virtual ~SfStepRule() {}
+
+  // Given wx = <x, w>, may scale w, and returns true, setting *x_scale, if
+  // x_scale * x is then to be added to w.
+  virtual bool Decide(float wx, SfWeightVector* w, float* x_scale) = 0;
+};
+
 class SfWeightVector {
  public:
   // Construct a weight vector of dimenson d, with all weights initialized to
@@ -58,16 +74,65 @@ class SfWeightVector {
   string AsString();
 
   // Computes inner product of <x_scale * x, w>
-  virtual float InnerProduct(const SfSparseVector& x,
+  virtual float InnerProduct(const SfSparseVectorView& x,
 			     float x_scale = 1.0) const;
 
   // Computes inner product of <x_scale * (a - b), w>
-  float InnerProductOnDifference(const SfSparseVector& a,
-				 const SfSparseVector& b,
+  float InnerProductOnDifference(const SfSparseVectorView& a,
+				 const SfSparseVectorView& b,
 				 float x_scale = 1.0) const;
 
   // w += x_scale * x
-  virtual void AddVector(const SfSparseVector& x, float x_scale);
+  virtual void AddVector(const SfSparseVectorView& x, float x_scale);
+
+  // One fused learner step on x: computes <x, w>, lets rule decide the
+  // update, and adds x_scale * x if it so decides, in back to back passes
+  // over x while its weights are still in cache.  The result is exactly
+  // that of InnerProduct(x), rule->Decide() and AddVector() in turn.
+  // Returns true if x was added.
+  virtual bool TakeStep(const SfSparseVectorView& x, SfStepRule* rule);
+
+  // As TakeStep(), for the difference x = a - b of two examples.  The
+  // result is exactly that of InnerProductOnDifference(a, b),
+  // rule->Decide(), AddVector(a, x_scale) and AddVector(b, -x_scale) in
+  // turn.  Returns true if x was added.
+  virtual bool TakeRankStep(const SfSparseVectorView& a,
+			    const SfSparseVectorView& b,
+			    SfStepRule* rule);
+
+  // As TakeStep() and TakeRankStep(), but bound at compile time to the
+  // methods of this class and to Rule, so that a caller that knows the
+  // exact types of the weight vector and of the rule has no virtual calls
+  // to make, and may have rule->Decide() inlined into the step.
+  template <class Rule>
+  bool TakeStepWith(const SfSparseVectorView& x, Rule* rule) {
+    float wx = SfWeightVector::InnerProduct(x);
+    float x_scale;
+    if (!rule->Decide(wx, this, &x_scale)) return false;
+    SfWeightVector::AddVector(x, x_scale);
+    return true;
+  }
+  template <class Rule>
+  bool TakeRankStepWith(const SfSparseVectorView& a,
+			const SfSparseVectorView& b,
+			Rule* rule) {
+    // As InnerProductOnDifference(), bound statically.
+    float wx = SfWeightVector::InnerProduct(a) +
+      SfWeightVector::InnerProduct(b, -1.0);
+    float x_scale;
+    if (!rule->Decide(wx, this, &x_scale)) return false;
+    SfWeightVector::AddVector(a, x_scale);
+    SfWeightVector::AddVector(b, -x_scale);
+    return true;
+  }
+
+  // Increases the dimensionality, if need be, so that feature ids up to
+  // max_feature_id may be used, with the new weights set to zero.
+  virtual void GrowToFit(int max_feature_id);
+
+  // Hints that the weights of the features of x will soon be used, so that
+  // they may be fetched into cache ahead of time.  Changes nothing.
+  virtual void PrefetchWeights(const SfSparseVectorView& x) const;
 
   // w *= scaling_factor
   void ScaleBy(double scaling_factor);
@@ -75,19 +140,41 @@ class SfWeightVector {
   // Returns value of element w_index, taking internal scaling into account.
   float ValueOf(int index) const;
 
-  // Project this vector into the L1 ball of radius lambda.
-  void ProjectToL1Ball(float lambda);
+  // Project this vector into the L1 ball of radius lambda, drawing the
+  // pivots of the search for the threshold from random.
+  void ProjectToL1Ball(float lambda, SfRandom* random);
 
   // Project this vector into the L1 ball of radius at most lambda, plus or
   // minus epsilon / 2.
   void ProjectToL1Ball(float lambda, float epsilon);
+
+  // Parameter mixing of replicas of one model, trained apart: sets weights
+  // [begin, end) of every replica to the mean of their values over all the
+  // replicas, and returns the sum of the squares of those means.  The
+  // replicas must have the same dimensionality.  Several threads may
+  // average disjoint ranges at once, as long as none takes steps on any
+  // replica meanwhile.  The means are stored as they are, so each replica
+  // is not valid until FinishAveraging() is given the sum of what every
+  // range returned, after every range has been averaged.
+  static double AverageRange(const vector<SfWeightVector*>& replicas,
+			     int begin,
+			     int end);
+
+  // Sets scale_ to 1, to match the means stored by AverageRange(), and
+  // sets the squared norm.
+  void FinishAveraging(double squared_norm);
   
+  // Sets the squared norm to that of the weights, summed afresh, dropping
+  // the rounding error that updating it step by step gathers.
+  void RecomputeSquaredNorm();
+
   // Getters.
   double GetSquaredNorm() const { return squared_norm_; }
   int GetDimensions() const { return dimensions_; }
 
  protected:
-  void ScaleToOne();
+  // Multiplies each weight by scale_, and sets scale_ to 1.
+  virtual void ScaleToOne();
 
   float* weights_;
   double scale_;
@@ -95,6 +182,9 @@ class SfWeightVector {
   int dimensions_;
 
  private:
+  // Shares weights_, and keeps scale_ and squared_norm_ in step.
+  friend class SfSharedWeightVector;
+
   // Disallowed.
   SfWeightVector();
 };
@@ -15,9 +15,23 @@
 //================================================================================//
 //
 #include <assert.h>
+#include <cmath>
 #include <iostream>
 #include "sf-weight-vector.h"
 
+// Scales w by 0.9, and adds 0.3 * x if wx is below 1.
+class TestRule : public SfStepRule {
+ public:
+  TestRule() : wx_(0.0) {}
+  virtual bool Decide(float wx, SfWeightVector* w, float* x_scale) {
+    wx_ = wx;
+    w->ScaleBy(0.9);
+    *x_scale = 0.3;
+    return wx < 1.0;
+  }
+  float wx_;
+};
+
 int main (int argc, char** argv) {
   SfWeightVector w_5(5);
   assert(w_5.GetDimensions() == 5);
@@ -43,6 +57,25 @@ int main (int argc, char** argv) {
   w_5.AsString();
   assert(w_5.GetSquaredNorm() == 15.0);
   assert(w_5.ValueOf(4) == 3.0);
+
+  // Growing keeps the existing weights, adding zero weights after them.
+  w_5.GrowToFit(4);
+  assert(w_5.GetDimensions() == 5);
+  w_5.GrowToFit(7);
+  assert(w_5.GetDimensions() == 8);
+  assert(w_5.ValueOf(4) == 3.0);
+  assert(w_5.ValueOf(7) == 0.0);
+  assert(w_5.GetSquaredNorm() == 15.0);
+  SfSparseVector x_7("1.0 7:1");
+  w_5.AddVector(x_7, 1.0);
+  assert(w_5.ValueOf(7) == 1.0);
+
+  // Prefetching changes nothing, even for features beyond the dimensions.
+  SfSparseVector x_9("1.0 4:1 9:1");
+  w_5.PrefetchWeights(x_9);
+  assert(w_5.GetDimensions() == 8);
+  assert(w_5.ValueOf(4) == 3.0);
+  assert(w_5.ValueOf(7) == 1.0);
   
   SfWeightVector w_3(string("3.0 2.0 -1.0"));
   assert(w_3.GetDimensions() == 3);
@@ -60,7 +93,8 @@ int main (int argc, char** argv) {
   assert(w_4.InnerProduct(ab_diff, 1.0) ==
          w_4.InnerProductOnDifference(a, b, 1.0));
 
-  w_4.ProjectToL1Ball(3.0);
+  SfRandom random(1);
+  w_4.ProjectToL1Ball(3.0, &random);
 
   assert(w_4.ValueOf(0) == 0);
   assert(w_4.ValueOf(1) == 0);
@@ -81,7 +115,7 @@ int main (int argc, char** argv) {
   assert(w_7.GetSquaredNorm() == w_6.GetSquaredNorm());
   assert(w_7.GetDimensions() == w_6.GetDimensions());
   
-  w_6.ProjectToL1Ball(20);
+  w_6.ProjectToL1Ball(20, &random);
   assert(w_6.ValueOf(0) == 0);
   assert(w_6.ValueOf(1) == 1);
   assert(w_6.ValueOf(2) == 2);
@@ -89,7 +123,7 @@ int main (int argc, char** argv) {
   assert(w_6.ValueOf(4) == -4);
   assert(w_6.ValueOf(5) == -5);
 
-  w_6.ProjectToL1Ball(6);
+  w_6.ProjectToL1Ball(6, &random);
   assert(w_6.ValueOf(0) == 0);
   assert(w_6.ValueOf(1) == 0);
   assert(w_6.ValueOf(2) == 0);
@@ -97,7 +131,7 @@ int main (int argc, char** argv) {
   assert(w_6.ValueOf(4) == -2);
   assert(w_6.ValueOf(5) == -3);
 
-  w_6.ProjectToL1Ball(0);
+  w_6.ProjectToL1Ball(0, &random);
   assert(w_6.ValueOf(0) == 0);
   assert(w_6.ValueOf(1) == 0);
   assert(w_6.ValueOf(2) == 0);
@@ -105,5 +139,89 @@ int main (int argc, char** argv) {
   assert(w_6.ValueOf(4) == 0);
   assert(w_6.ValueOf(5) == 0);
 
+  // A fused step gives exactly the result of the separate calls.
+  SfWeightVector w_fused(string("0.25 -0.5 0.75 0.125 2.0"));
+  SfWeightVector w_separate(w_fused);
+  SfSparseVector x_step("1 1:0.3 2:0.7 4:0.1");
+  for (int step = 0; step < 10; ++step) {
+    TestRule rule;
+    bool added = w_fused.TakeStep(x_step, &rule);
+    float wx = w_separate.InnerProduct(x_step);
+    assert(rule.wx_ == wx);
+    w_separate.ScaleBy(0.9);
+    assert(added == (wx < 1.0));
+    if (added) w_separate.AddVector(x_step, 0.3);
+    assert(w_fused.GetSquaredNorm() == w_separate.GetSquaredNorm());
+    for (int i = 0; i < 5; ++i) {
+      assert(w_fused.ValueOf(i) == w_separate.ValueOf(i));
+    }
+  }
+
+  // So does a fused rank step, on a and b that share a feature.
+  SfSparseVector a_step("1 1:0.3 3:0.9");
+  SfSparseVector b_step("-1 2:0.4 3:0.2 4:0.6");
+  for (int step = 0; step < 10; ++step) {
+    TestRule rule;
+    bool added = w_fused.TakeRankStep(a_step, b_step, &rule);
+    float wx = w_separate.InnerProductOnDifference(a_step, b_step);
+    assert(rule.wx_ == wx);
+    w_separate.ScaleBy(0.9);
+    assert(added == (wx < 1.0));
+    if (added) {
+      w_separate.AddVector(a_step, 0.3);
+      w_separate.AddVector(b_step, -0.3);
+    }
+    assert(w_fused.GetSquaredNorm() == w_separate.GetSquaredNorm());
+    for (int i = 0; i < 5; ++i) {
+      assert(w_fused.ValueOf(i) == w_separate.ValueOf(i));
+    }
+  }
+
+  // Averaging replicas with different scales, over two ranges that each
+  // span more than one chunk, leaves every replica at the means.
+  SfWeightVector replica_a(600);
+  SfWeightVector replica_b(600);
+  SfWeightVector replica_c(600);
+  SfSparseVector x_a("1 0:1 299:2 300:4 599:-1");
+  SfSparseVector x_b("1 0:2 299:-2 450:3");
+  replica_a.AddVector(x_a, 1.0);
+  replica_a.ScaleBy(0.5);
+  replica_b.AddVector(x_b, 1.0);
+  replica_b.ScaleBy(0.25);
+  replica_c.AddVector(x_a, 1.0);
+  replica_c.AddVector(x_b, 1.0);
+  vector<SfWeightVector*> replicas;
+  replicas.push_back(&replica_a);
+  replicas.push_back(&replica_b);
+  replicas.push_back(&replica_c);
+  // The means are summed in float, in replica order, as AverageRange()
+  // sums them.
+  float means[600];
+  double mean_squared_norms[2] = {0.0, 0.0};
+  for (int i = 0; i < 600; ++i) {
+    means[i] = 0.0;
+    for (unsigned int r = 0; r < replicas.size(); ++r) {
+      means[i] += replicas[r]->ValueOf(i);
+    }
+    means[i] *= static_cast<float>(1.0 / 3.0);
+    mean_squared_norms[i / 300] += means[i] * means[i];
+  }
+  double squared_norm = SfWeightVector::AverageRange(replicas, 0, 300) +
+    SfWeightVector::AverageRange(replicas, 300, 600);
+  assert(squared_norm == mean_squared_norms[0] + mean_squared_norms[1]);
+  for (unsigned int r = 0; r < replicas.size(); ++r) {
+    replicas[r]->FinishAveraging(squared_norm);
+    assert(replicas[r]->GetSquaredNorm() == squared_norm);
+    for (int i = 0; i < 600; ++i) {
+      assert(replicas[r]->ValueOf(i) == means[i]);
+    }
+  }
+  assert(fabs(replica_c.ValueOf(0) - 4.0 / 3.0) < 1e-6);
+
+  SfWeightVector w_norm(string("3 4"));
+  w_norm.ScaleBy(0.5);
+  w_norm.RecomputeSquaredNorm();
+  assert(w_norm.GetSquaredNorm() == 6.25);
+
   std::cout << argv[0] << ": PASS" << std::endl;
 }
@@ -147,7 +147,10 @@ bool ParseGeneralFlag(int argc,
   if (CMD_LINE_FLOATS.find(argv[*i]) != CMD_LINE_FLOATS.end() ||
       CMD_LINE_INTS.find(argv[*i]) != CMD_LINE_INTS.end() ||      
       CMD_LINE_STRINGS.find(argv[*i]) != CMD_LINE_STRINGS.end()) {
-    if (*i + 1 >= argc || (argv[*i + 1])[0] == '-') {
+    // A value may not look like a flag, except for "-", which commonly
+    // names standard input.
+    if (*i + 1 >= argc ||
+	((argv[*i + 1])[0] == '-' && (argv[*i + 1])[1] != '\0')) {
       std::cerr << "Error.  " << argv[*i] << " needs a value, but is given none."
 		<< std::endl;
       exit(1);
@@ -35,8 +35,12 @@ int main (int argc, char** argv) {
   AddFlag("--ask", "should we ask people stuff?", bool(false));
 
   // Fill in dummy data for testing.
-  char* cmdline[8] = { "./a.out", "--name", "no-name", "--number", "1",
-			  "--frac", "0.5", "--ask"};
+  char cmdline_strings[8][10] = { "./a.out", "--name", "no-name", "--number",
+				 "1", "--frac", "0.5", "--ask" };
+  char* cmdline[8];
+  for (int i = 0; i < 8; ++i) {
+    cmdline[i] = cmdline_strings[i];
+  }
   argv = cmdline;
   argc = 8;
 
@@ -47,5 +51,13 @@ int main (int argc, char** argv) {
   assert(CMD_LINE_INTS["--number"] == 1);
   assert(CMD_LINE_BOOLS["--ask"] == true);
 
+  // "-" is a value, not a flag.
+  char program[] = "./a.out";
+  char name_flag[] = "--name";
+  char dash[] = "-";
+  char* stdin_cmdline[3] = { program, name_flag, dash };
+  ParseFlags(3, stdin_cmdline);
+  assert(CMD_LINE_STRINGS["--name"] == string("-"));
+
   std::cout << test_name << ": PASS" << std::endl;
 }
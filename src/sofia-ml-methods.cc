@@ -22,12 +22,20 @@
 // Implementation of sofia-ml-methods.h
 
 #include "sofia-ml-methods.h"
-
+#include "sf-background-reader.h"
+#include "sf-hash-weight-vector.h"
+#include "sf-line-reader.h"
+#include "sf-random.h"
+#include "sf-shared-weight-vector.h"
+#include "sf-shuffle-buffer.h"
+
+#include <pthread.h>
+#include <algorithm>
 #include <climits>
 #include <cmath>
 #include <cstdlib>
 #include <iostream>
-#include <map>
+#include <typeinfo>
 #include <vector>
 
 // The MIN_SCALING_FACTOR is used to protect against combinations of
@@ -41,24 +49,7 @@ namespace sofia_ml {
   //         Helper functions (Not exposed in API)
   // --------------------------------------------------- //
 
-  int RandInt(int num_vals) {
-    return static_cast<int>(rand()) % num_vals;
-  }
-
-  float RandFloat() {
-    return static_cast<float>(rand()) / RAND_MAX;
-  }
-
-  const SfSparseVector& RandomExample(const SfDataSet& data_set) {
-    int num_examples = data_set.NumExamples();
-    int i = static_cast<int>(rand()) % num_examples;
-    if (i < 0) {
-      i += num_examples;
-    }
-    return data_set.VectorAt(i);
-  }
-
-  inline float GetEta (EtaType eta_type, float lambda, int i) {
+  inline float GetEta (EtaType eta_type, float lambda, long int i) {
     switch (eta_type) {
     case BASIC_ETA:
       return 10.0 / (i + 10.0);
@@ -76,7 +67,1394 @@ namespace sofia_ml {
     std::cerr << "Error in GetEta, we should never get here." << std::endl;
     return 0;
   }
+
+  // The examples used by one step of a loop: a alone for a classification
+  // step, or the pair (a, b) for a rank step.  Entries that are not used
+  // are -1, and a is -1 for a step that is to be skipped.
+  struct StepExamples {
+    int a;
+    int b;
+  };
+
+  // Each of the samplers below draws the examples for one step of a loop,
+  // making exactly the same calls to random as the loop once did inline.
+  // ForShard() makes a sampler of the same kind for a shard of the data set,
+  // for parameter mixing, and ForThread() one for thread index of
+  // num_threads that share the data set, for Hogwild; a sampler that draws
+  // each step independently is simply copied.  CanDraw() is false if the
+  // data set has none of the examples that the sampler needs.
+  // ShardsByGroup() is true if the sampler draws rank pairs, whose groups
+  // the shards should keep whole.
+
+  // Samples one example uniformly at random.
+  class ExampleSampler {
+   public:
+    explicit ExampleSampler(const SfDataSet& data_set)
+      : data_set_(data_set) {}
+    ExampleSampler ForShard(const SfDataSet& shard) const {
+      return ExampleSampler(shard);
+    }
+    ExampleSampler ForThread(int index, int num_threads,
+			     unsigned int shuffle_seed) const {
+      return *this;
+    }
+    bool CanDraw() const { return data_set_.NumExamples() > 0; }
+    bool ShardsByGroup() const { return false; }
+    void Draw(SfRandom* random, StepExamples* step) const {
+      step->a = random->RandInt(data_set_.NumExamples());
+      step->b = -1;
+    }
+   private:
+    const SfDataSet& data_set_;
+  };
+
+  // Samples one positive example as a and one negative example as b.
+  class PositiveNegativeSampler {
+   public:
+    explicit PositiveNegativeSampler(const SfDataSet& data_set)
+      : positives_(data_set.Positives()),
+	negatives_(data_set.Negatives()) {}
+    PositiveNegativeSampler ForShard(const SfDataSet& shard) const {
+      return PositiveNegativeSampler(shard);
+    }
+    PositiveNegativeSampler ForThread(int index, int num_threads,
+				      unsigned int shuffle_seed) const {
+      return *this;
+    }
+    bool CanDraw() const {
+      return !positives_.empty() && !negatives_.empty();
+    }
+    bool ShardsByGroup() const { return false; }
+    void Draw(SfRandom* random, StepExamples* step) const {
+      step->a = positives_[random->RandInt(positives_.size())];
+      step->b = negatives_[random->RandInt(negatives_.size())];
+    }
+   private:
+    const vector<long int>& positives_;
+    const vector<long int>& negatives_;
+  };
+
+  // Samples a uniformly at random and b from the rank partners of a.  The
+  // step is skipped if a has no rank partners.
+  class RankPairSampler {
+   public:
+    explicit RankPairSampler(const SfDataSet& data_set)
+      : data_set_(data_set),
+	rank_index_(data_set.RankIndex()) {}
+    RankPairSampler ForShard(const SfDataSet& shard) const {
+      return RankPairSampler(shard);
+    }
+    RankPairSampler ForThread(int index, int num_threads,
+			      unsigned int shuffle_seed) const {
+      return *this;
+    }
+    bool CanDraw() const { return rank_index_.NumRankableGroups() > 0; }
+    bool ShardsByGroup() const { return true; }
+    void Draw(SfRandom* random, StepExamples* step) const {
+      int a_index = random->RandInt(data_set_.NumExamples());
+      int range = rank_index_.NumPartners(a_index);
+      if (range == 0) {
+	step->a = -1;
+	step->b = -1;
+	return;
+      }
+      step->a = a_index;
+      step->b = rank_index_.PartnerAt(a_index, random->RandInt(range));
+    }
+   private:
+    const SfDataSet& data_set_;
+    const SfRankIndex& rank_index_;
+  };
+
+  // Samples a rankable group uniformly at random, then a from that group
+  // and b from the rank partners of a.  There must be a rankable group.
+  class QueryNormRankPairSampler {
+   public:
+    explicit QueryNormRankPairSampler(const SfDataSet& data_set)
+      : rank_index_(data_set.RankIndex()) {}
+    QueryNormRankPairSampler ForShard(const SfDataSet& shard) const {
+      return QueryNormRankPairSampler(shard);
+    }
+    QueryNormRankPairSampler ForThread(int index, int num_threads,
+				       unsigned int shuffle_seed) const {
+      return *this;
+    }
+    bool CanDraw() const { return rank_index_.NumRankableGroups() > 0; }
+    bool ShardsByGroup() const { return true; }
+    void Draw(SfRandom* random, StepExamples* step) const {
+      int group = random->RandInt(rank_index_.NumRankableGroups());
+      step->a = rank_index_.RankableGroupExampleAt(
+          group, random->RandInt(rank_index_.RankableGroupSize(group)));
+      int range = rank_index_.NumPartners(step->a);
+      step->b = rank_index_.PartnerAt(step->a, random->RandInt(range));
+    }
+   private:
+    const SfRankIndex& rank_index_;
+  };
+
+  // With probability rank_step_probability, draws a rank step from
+  // RankSampler, and otherwise a classification step.
+  template <class RankSampler>
+  class ClassificationAndRankSampler {
+   public:
+    ClassificationAndRankSampler(const SfDataSet& data_set,
+				 float rank_step_probability)
+      : example_sampler_(data_set),
+	rank_sampler_(data_set),
+	rank_step_probability_(rank_step_probability) {}
+    ClassificationAndRankSampler ForShard(const SfDataSet& shard) const {
+      return ClassificationAndRankSampler(shard, rank_step_probability_);
+    }
+    ClassificationAndRankSampler ForThread(int index, int num_threads,
+					   unsigned int shuffle_seed) const {
+      return *this;
+    }
+    bool CanDraw() const {
+      return example_sampler_.CanDraw() && rank_sampler_.CanDraw();
+    }
+    bool ShardsByGroup() const { return rank_sampler_.ShardsByGroup(); }
+    void Draw(SfRandom* random, StepExamples* step) const {
+      if (random->RandFloat() < rank_step_probability_) {
+	rank_sampler_.Draw(random, step);
+      } else {
+	example_sampler_.Draw(random, step);
+      }
+    }
+   private:
+    ExampleSampler example_sampler_;
+    RankSampler rank_sampler_;
+    float rank_step_probability_;
+  };
+
+  // Walks the examples one block of block_size examples at a time, taking
+  // the blocks in an order that is shuffled afresh at the start of each
+  // epoch.  A sampler made by ForThread() walks the same sequence of
+  // examples as every other thread's, as its shuffles all draw from a
+  // generator seeded with the same shuffle_seed, but takes only every
+  // num_threads-th example of it, from the index-th on.  So the threads
+  // take the steps of one walk between them, and each epoch still visits
+  // every example exactly once.
+  class EpochSampler {
+   public:
+    EpochSampler(long int num_examples, int block_size)
+      : num_examples_(num_examples),
+	block_size_(block_size),
+	block_order_((num_examples + block_size - 1) / block_size),
+	next_block_(block_order_.size()),
+	next_example_(0),
+	block_end_(0),
+	num_to_skip_(0),
+	stride_(1),
+	own_shuffle_random_(false),
+	shuffle_random_(0) {
+      for (unsigned int b = 0; b < block_order_.size(); ++b) {
+	block_order_[b] = b;
+      }
+    }
+    EpochSampler ForShard(const SfDataSet& shard) const {
+      return EpochSampler(shard.NumExamples(), block_size_);
+    }
+    EpochSampler ForThread(int index, int num_threads,
+			   unsigned int shuffle_seed) const {
+      EpochSampler sampler(num_examples_, block_size_);
+      sampler.num_to_skip_ = index;
+      sampler.stride_ = num_threads;
+      sampler.own_shuffle_random_ = true;
+      sampler.shuffle_random_ = SfRandom(shuffle_seed);
+      return sampler;
+    }
+    bool CanDraw() const { return num_examples_ > 0; }
+    bool ShardsByGroup() const { return false; }
+    void Draw(SfRandom* random, StepExamples* step) {
+      SfRandom* shuffle_random =
+	own_shuffle_random_ ? &shuffle_random_ : random;
+      for (long int k = num_to_skip_; k > 0; ) {
+	StartBlockIfDone(shuffle_random);
+	long int num_skipped = std::min(k, block_end_ - next_example_);
+	next_example_ += num_skipped;
+	k -= num_skipped;
+      }
+      num_to_skip_ = stride_ - 1;
+      StartBlockIfDone(shuffle_random);
+      step->a = next_example_;
+      step->b = -1;
+      ++next_example_;
+    }
+   private:
+    // Moves on to the next block once the current one is done.
+    void StartBlockIfDone(SfRandom* random) {
+      if (next_example_ != block_end_) return;
+      if (next_block_ == block_order_.size()) {
+	// Start each epoch with a fresh Fisher-Yates shuffle of the blocks.
+	for (int b = block_order_.size() - 1; b > 0; --b) {
+	  std::swap(block_order_[b], block_order_[random->RandInt(b + 1)]);
+	}
+	next_block_ = 0;
+      }
+      next_example_ =
+	static_cast<long int>(block_order_[next_block_]) * block_size_;
+      block_end_ = std::min(next_example_ + block_size_, num_examples_);
+      ++next_block_;
+    }
+
+    long int num_examples_;
+    int block_size_;
+    vector<int> block_order_;
+    unsigned int next_block_;
+    long int next_example_;
+    long int block_end_;
+    // Examples of the walk to pass over before the next one drawn.
+    int num_to_skip_;
+    int stride_;
+    bool own_shuffle_random_;
+    SfRandom shuffle_random_;
+  };
+
+  // The number of steps ahead of time that StepsAhead draws examples.
+  const int kStepsAhead = 8;
+
+  // Draws the examples for each of num_steps steps from sampler
+  // kStepsAhead steps before the step is taken.  The rows of the examples
+  // are prefetched as soon as they are drawn, and the weights that those
+  // rows touch halfway to their step, once the rows have arrived, so that
+  // the cache misses of upcoming steps overlap the work of the current
+  // one.  The examples are drawn in the order that the steps use them, so
+  // that training is exactly as if each step drew its own.  The weights
+  // are prefetched through Binding, as the steps are taken (see
+  // VirtualBinding below).
+  template <class Sampler, class Binding>
+  class StepsAhead {
+   public:
+    StepsAhead(const SfDataSet& data_set,
+	       const SfWeightVector& w,
+	       int num_steps,
+	       Sampler* sampler,
+	       SfRandom* random)
+      : data_set_(data_set),
+	w_(w),
+	num_steps_(num_steps),
+	sampler_(sampler),
+	random_(random),
+	num_drawn_(0),
+	num_taken_(0) {
+      while (num_drawn_ < num_steps_ && num_drawn_ < kStepsAhead) {
+	DrawNext();
+      }
+    }
+
+    // Returns the examples for the next step.
+    StepExamples Next() {
+      StepExamples step = steps_[num_taken_ % kStepsAhead];
+      int halfway = num_taken_ + kStepsAhead / 2;
+      if (halfway < num_drawn_) {
+	PrefetchWeights(steps_[halfway % kStepsAhead]);
+      }
+      ++num_taken_;
+      if (num_drawn_ < num_steps_) DrawNext();
+      return step;
+    }
+
+   private:
+    // Draws the examples for step num_drawn_, into the slot freed by the
+    // step kStepsAhead before it, and prefetches their rows.
+    void DrawNext() {
+      StepExamples* step = &steps_[num_drawn_ % kStepsAhead];
+      sampler_->Draw(random_, step);
+      if (step->a >= 0) data_set_.PrefetchVector(step->a);
+      if (step->b >= 0) data_set_.PrefetchVector(step->b);
+      ++num_drawn_;
+    }
+
+    void PrefetchWeights(const StepExamples& step) const {
+      if (step.a >= 0) {
+	Binding::PrefetchWeights(data_set_.VectorAt(step.a), w_);
+      }
+      if (step.b >= 0) {
+	Binding::PrefetchWeights(data_set_.VectorAt(step.b), w_);
+      }
+    }
+
+    const SfDataSet& data_set_;
+    const SfWeightVector& w_;
+    int num_steps_;
+    Sampler* sampler_;
+    SfRandom* random_;
+    int num_drawn_;
+    int num_taken_;
+    // Step s is held in steps_[s % kStepsAhead] from when it is drawn
+    // until it is taken.
+    StepExamples steps_[kStepsAhead];
+  };
   
+  // --------------------------------------------------- //
+  //                      Learners
+  // --------------------------------------------------- //
+
+  // Each learner below decides its update with an SfStepRule, given to
+  // SfWeightVector::TakeStep() for a single example x, or to TakeRankStep()
+  // for the difference x = a - b of a rank pair, which take the inner
+  // product and the update in one fused call.  The rules compute exactly
+  // what the steps once computed inline around separate InnerProduct(),
+  // InnerProductOnDifference() and AddVector() calls, and record whether
+  // x had loss.
+
+  // Returns ||a - b||^2, merging the features of a and b by id.
+  static float SquaredNormOfDifference(const SfSparseVectorView& a,
+				       const SfSparseVectorView& b) {
+    int i = 0;
+    int j = 0;
+    float squared_norm = 0;
+    while (i < a.NumFeatures() || j < b.NumFeatures()) {
+      int a_feature = (i < a.NumFeatures()) ? a.FeatureAt(i) : INT_MAX;
+      int b_feature = (j < b.NumFeatures()) ? b.FeatureAt(j) : INT_MAX;
+      if (a_feature < b_feature) {
+	squared_norm += a.ValueAt(i) * a.ValueAt(i);
+	++i;
+      } else if (b_feature < a_feature) {
+	squared_norm += b.ValueAt(j) * b.ValueAt(j);
+	++j;
+      } else {
+	squared_norm += (a.ValueAt(i) - b.ValueAt(j)) * (a.ValueAt(i) - b.ValueAt(j));
+	++i;
+	++j;
+      }
+    }
+    return squared_norm;
+  }
+
+  // Returns ||a||^2, or ||a - b||^2 if b is not NULL.
+  static float SquaredNormOf(const SfSparseVectorView& a,
+			     const SfSparseVectorView* b) {
+    return (b == NULL) ? a.GetSquaredNorm() : SquaredNormOfDifference(a, *b);
+  }
+
+  // The hinge loss step of Pegasos and SGD-SVM.
+  class HingeRule : public SfStepRule {
+   public:
+    HingeRule(float y, float eta, float lambda)
+      : y_(y), eta_(eta), lambda_(lambda) {}
+    virtual bool Decide(float wx, SfWeightVector* w, float* x_scale) {
+      float p = y_ * wx;
+      L2Regularize(eta_, lambda_, w);
+      // If x has non-zero loss, perform gradient step in direction of x.
+      if (p < 1.0 && y_ != 0.0) {
+	*x_scale = eta_ * y_;
+	return true;
+      }
+      return false;
+    }
+   private:
+    float y_;
+    float eta_;
+    float lambda_;
+  };
+
+  // The step on x = a, or on x = a - b if b is not NULL, as for
+  // PassiveAggressiveRule below.
+  class RommaRule : public SfStepRule {
+   public:
+    RommaRule(float y, const SfSparseVectorView& a, const SfSparseVectorView* b)
+      : y_(y), a_(a), b_(b), has_loss_(false) {}
+    virtual bool Decide(float wx, SfWeightVector* w, float* x_scale) {
+      float p = y_ * wx;
+      const float kVerySmallNumber = 0.0000000001;
+      has_loss_ = p < 1.0 && y_ != 0.0;
+      if (!has_loss_) return false;
+
+      // Perform gradient step in direction of x.
+      float xx = SquaredNormOf(a_, b_);
+      float ww = w->GetSquaredNorm();
+      float c = ((xx * ww) - p + kVerySmallNumber) /
+	((xx * ww) - (wx * wx) + kVerySmallNumber);
+
+      float d = (ww * (y_ - wx) + kVerySmallNumber) /
+	((xx * ww) - (wx * wx) + kVerySmallNumber);
+
+      // Avoid numerical problems caused by examples of extremely low magnitude.
+      if (c < 0.0) return false;
+      w->ScaleBy(c);
+      *x_scale = d;
+      return true;
+    }
+    bool HasLoss() const { return has_loss_; }
+   private:
+    float y_;
+    const SfSparseVectorView& a_;
+    const SfSparseVectorView* b_;
+    bool has_loss_;
+  };
+
+  // Adds step * x if y * wx is at most c.
+  class MarginPerceptronRule : public SfStepRule {
+   public:
+    MarginPerceptronRule(float y, float step, float c)
+      : y_(y), step_(step), c_(c) {}
+    virtual bool Decide(float wx, SfWeightVector* w, float* x_scale) {
+      if (y_ * wx <= c_) {
+	*x_scale = step_;
+	return true;
+      }
+      return false;
+    }
+   private:
+    float y_;
+    float step_;
+    float c_;
+  };
+
+  // The logistic loss step of LOGREG and LOGREG_PEGASOS.
+  class LogRegRule : public SfStepRule {
+   public:
+    LogRegRule(float y, float eta, float lambda)
+      : y_(y), eta_(eta), lambda_(lambda) {}
+    virtual bool Decide(float wx, SfWeightVector* w, float* x_scale) {
+      float loss = y_ / (1 + exp(y_ * wx));
+      L2Regularize(eta_, lambda_, w);
+      *x_scale = eta_ * loss;
+      return true;
+    }
+   private:
+    float y_;
+    float eta_;
+    float lambda_;
+  };
+
+  class LeastMeanSquaresRule : public SfStepRule {
+   public:
+    LeastMeanSquaresRule(float y, float eta, float lambda)
+      : y_(y), eta_(eta), lambda_(lambda) {}
+    virtual bool Decide(float wx, SfWeightVector* w, float* x_scale) {
+      float loss = y_ - wx;
+      L2Regularize(eta_, lambda_, w);
+      *x_scale = eta_ * loss;
+      return true;
+    }
+   private:
+    float y_;
+    float eta_;
+    float lambda_;
+  };
+
+  // The step on x = a, or on x = a - b if b is not NULL.  ||x||^2 is only
+  // computed once x is known to have loss.
+  class PassiveAggressiveRule : public SfStepRule {
+   public:
+    PassiveAggressiveRule(float y,
+			  const SfSparseVectorView& a,
+			  const SfSparseVectorView* b,
+			  float max_step)
+      : y_(y), a_(a), b_(b), max_step_(max_step), has_loss_(false) {}
+    virtual bool Decide(float wx, SfWeightVector* w, float* x_scale) {
+      float p = 1 - (y_ * wx);
+      has_loss_ = p < 1.0 && y_ != 0.0;
+      // If x has non-zero loss, perform gradient step in direction of x.
+      if (p > 0.0 && y_ != 0.0) {
+	float step = p / SquaredNormOf(a_, b_);
+	if (step > max_step_) step = max_step_;
+	*x_scale = step * y_;
+	return true;
+      }
+      return false;
+    }
+    bool HasLoss() const { return has_loss_; }
+   private:
+    float y_;
+    const SfSparseVectorView& a_;
+    const SfSparseVectorView* b_;
+    float max_step_;
+    bool has_loss_;
+  };
+
+  // A Binding takes the fused steps of the learners below on w, and
+  // prefetches the weights for them.
+  // VirtualBinding does so through the virtual TakeStep() and
+  // TakeRankStep(), and so works for any SfWeightVector.  ExactBinding<W>
+  // is for a w whose type is exactly W, and binds the whole step, the
+  // rule's Decide() included, at compile time.  Members that a subclass of
+  // W overrides would be skipped, so each class that is bound this way
+  // defines its own TakeStepWith() and TakeRankStepWith().
+  struct VirtualBinding {
+    template <class Rule>
+    static bool TakeStep(const SfSparseVectorView& x,
+			 Rule* rule,
+			 SfWeightVector* w) {
+      return w->TakeStep(x, rule);
+    }
+    template <class Rule>
+    static bool TakeRankStep(const SfSparseVectorView& a,
+			     const SfSparseVectorView& b,
+			     Rule* rule,
+			     SfWeightVector* w) {
+      return w->TakeRankStep(a, b, rule);
+    }
+    static void PrefetchWeights(const SfSparseVectorView& x,
+				const SfWeightVector& w) {
+      w.PrefetchWeights(x);
+    }
+  };
+
+  template <class W>
+  struct ExactBinding {
+    template <class Rule>
+    static bool TakeStep(const SfSparseVectorView& x,
+			 Rule* rule,
+			 SfWeightVector* w) {
+      return static_cast<W*>(w)->TakeStepWith(x, rule);
+    }
+    template <class Rule>
+    static bool TakeRankStep(const SfSparseVectorView& a,
+			     const SfSparseVectorView& b,
+			     Rule* rule,
+			     SfWeightVector* w) {
+      return static_cast<W*>(w)->TakeRankStepWith(a, b, rule);
+    }
+    static void PrefetchWeights(const SfSparseVectorView& x,
+				const SfWeightVector& w) {
+      // A hint only, taken a few steps ahead; binding it statically as well
+      // measured no faster, so it is left as a virtual call.
+      w.PrefetchWeights(x);
+    }
+  };
+
+  // Each learner below takes the steps of one LearnerType through a
+  // Binding, with the parameters of OneLearnerStep() and
+  // OneLearnerRankStep().  The loops are instantiated for each learner, so
+  // that the learner is chosen once per loop rather than once per step.
+
+  template <class Binding>
+  struct PegasosLearner {
+    bool Step(const SfSparseVectorView& x,
+	      float eta,
+	      float c,
+	      float lambda,
+	      SfWeightVector* w) const {
+      HingeRule rule(x.GetY(), eta, lambda);
+      bool has_loss = Binding::TakeStep(x, &rule, w);
+      PegasosProjection(lambda, w);
+      return has_loss;
+    }
+    bool RankStep(const SfSparseVectorView& a,
+		  const SfSparseVectorView& b,
+		  float eta,
+		  float c,
+		  float lambda,
+		  SfWeightVector* w) const {
+      float y = (a.GetY() > b.GetY()) ? 1.0 :
+	(a.GetY() < b.GetY()) ? -1.0 : 0.0;
+      HingeRule rule(y, eta, lambda);
+      bool has_loss = Binding::TakeRankStep(a, b, &rule, w);
+      PegasosProjection(lambda, w);
+      return has_loss;
+    }
+  };
+
+  template <class Binding>
+  struct MarginPerceptronLearner {
+    bool Step(const SfSparseVectorView& x,
+	      float eta,
+	      float c,
+	      float lambda,
+	      SfWeightVector* w) const {
+      MarginPerceptronRule rule(x.GetY(), eta * x.GetY(), c);
+      return Binding::TakeStep(x, &rule, w);
+    }
+    bool RankStep(const SfSparseVectorView& a,
+		  const SfSparseVectorView& b,
+		  float eta,
+		  float c,
+		  float lambda,
+		  SfWeightVector* w) const {
+      float y = (a.GetY() > b.GetY()) ? 1.0 :
+	(a.GetY() < b.GetY()) ? -1.0 : 0.0;
+      MarginPerceptronRule rule(y, eta, c);
+      return Binding::TakeRankStep(a, b, &rule, w);
+    }
+  };
+
+  // Here c is the maximum step size.
+  template <class Binding>
+  struct PassiveAggressiveLearner {
+    bool Step(const SfSparseVectorView& x,
+	      float eta,
+	      float c,
+	      float lambda,
+	      SfWeightVector* w) const {
+      PassiveAggressiveRule rule(x.GetY(), x, NULL, c);
+      Binding::TakeStep(x, &rule, w);
+      if (lambda > 0.0) {
+	PegasosProjection(lambda, w);
+      }
+      return rule.HasLoss();
+    }
+    bool RankStep(const SfSparseVectorView& a,
+		  const SfSparseVectorView& b,
+		  float eta,
+		  float c,
+		  float lambda,
+		  SfWeightVector* w) const {
+      float y = (a.GetY() > b.GetY()) ? 1.0 :
+	(a.GetY() < b.GetY()) ? -1.0 : 0.0;
+      PassiveAggressiveRule rule(y, a, &b, c);
+      bool has_loss = Binding::TakeRankStep(a, b, &rule, w);
+      if (lambda > 0.0) {
+	PegasosProjection(lambda, w);
+      }
+      return has_loss;
+    }
+  };
+
+  template <class Binding>
+  struct PegasosLogRegLearner {
+    bool Step(const SfSparseVectorView& x,
+	      float eta,
+	      float c,
+	      float lambda,
+	      SfWeightVector* w) const {
+      LogRegRule rule(x.GetY(), eta, lambda);
+      Binding::TakeStep(x, &rule, w);
+      PegasosProjection(lambda, w);
+      return (true);
+    }
+    bool RankStep(const SfSparseVectorView& a,
+		  const SfSparseVectorView& b,
+		  float eta,
+		  float c,
+		  float lambda,
+		  SfWeightVector* w) const {
+      float y = (a.GetY() > b.GetY()) ? 1.0 :
+	(a.GetY() < b.GetY()) ? -1.0 : 0.0;
+      LogRegRule rule(y, eta, lambda);
+      Binding::TakeRankStep(a, b, &rule, w);
+      PegasosProjection(lambda, w);
+      return (true);
+    }
+  };
+
+  template <class Binding>
+  struct LogRegLearner {
+    bool Step(const SfSparseVectorView& x,
+	      float eta,
+	      float c,
+	      float lambda,
+	      SfWeightVector* w) const {
+      LogRegRule rule(x.GetY(), eta, lambda);
+      Binding::TakeStep(x, &rule, w);
+      return (true);
+    }
+    bool RankStep(const SfSparseVectorView& a,
+		  const SfSparseVectorView& b,
+		  float eta,
+		  float c,
+		  float lambda,
+		  SfWeightVector* w) const {
+      float y = (a.GetY() > b.GetY()) ? 1.0 :
+	(a.GetY() < b.GetY()) ? -1.0 : 0.0;
+      LogRegRule rule(y, eta, lambda);
+      Binding::TakeRankStep(a, b, &rule, w);
+      return (true);
+    }
+  };
+
+  template <class Binding>
+  struct LeastMeanSquaresLearner {
+    bool Step(const SfSparseVectorView& x,
+	      float eta,
+	      float c,
+	      float lambda,
+	      SfWeightVector* w) const {
+      LeastMeanSquaresRule rule(x.GetY(), eta, lambda);
+      Binding::TakeStep(x, &rule, w);
+      PegasosProjection(lambda, w);
+      return (true);
+    }
+    bool RankStep(const SfSparseVectorView& a,
+		  const SfSparseVectorView& b,
+		  float eta,
+		  float c,
+		  float lambda,
+		  SfWeightVector* w) const {
+      float y = (a.GetY() - b.GetY());
+      LeastMeanSquaresRule rule(y, eta, lambda);
+      Binding::TakeRankStep(a, b, &rule, w);
+      PegasosProjection(lambda, w);
+      return (true);
+    }
+  };
+
+  template <class Binding>
+  struct SgdSvmLearner {
+    bool Step(const SfSparseVectorView& x,
+	      float eta,
+	      float c,
+	      float lambda,
+	      SfWeightVector* w) const {
+      HingeRule rule(x.GetY(), eta, lambda);
+      return Binding::TakeStep(x, &rule, w);
+    }
+    bool RankStep(const SfSparseVectorView& a,
+		  const SfSparseVectorView& b,
+		  float eta,
+		  float c,
+		  float lambda,
+		  SfWeightVector* w) const {
+      float y = (a.GetY() > b.GetY()) ? 1.0 :
+	(a.GetY() < b.GetY()) ? -1.0 : 0.0;
+      HingeRule rule(y, eta, lambda);
+      return Binding::TakeRankStep(a, b, &rule, w);
+    }
+  };
+
+  template <class Binding>
+  struct RommaLearner {
+    bool Step(const SfSparseVectorView& x,
+	      float eta,
+	      float c,
+	      float lambda,
+	      SfWeightVector* w) const {
+      RommaRule rule(x.GetY(), x, NULL);
+      Binding::TakeStep(x, &rule, w);
+      return rule.HasLoss();
+    }
+    bool RankStep(const SfSparseVectorView& a,
+		  const SfSparseVectorView& b,
+		  float eta,
+		  float c,
+		  float lambda,
+		  SfWeightVector* w) const {
+      float y = (a.GetY() > b.GetY()) ? 1.0 :
+	(a.GetY() < b.GetY()) ? -1.0 : 0.0;
+      RommaRule rule(y, a, &b);
+      Binding::TakeRankStep(a, b, &rule, w);
+      return rule.HasLoss();
+    }
+  };
+
+  // Takes the steps of the learner of learner_type, chosen on every step,
+  // through the virtual methods of w, for a w of a type that RunLoop()
+  // does not know.
+  class AnyLearner {
+   public:
+    explicit AnyLearner(LearnerType learner_type)
+      : learner_type_(learner_type) {}
+    bool Step(const SfSparseVectorView& x,
+	      float eta,
+	      float c,
+	      float lambda,
+	      SfWeightVector* w) const {
+      return OneLearnerStep(learner_type_, x, eta, c, lambda, w);
+    }
+    bool RankStep(const SfSparseVectorView& a,
+		  const SfSparseVectorView& b,
+		  float eta,
+		  float c,
+		  float lambda,
+		  SfWeightVector* w) const {
+      return OneLearnerRankStep(learner_type_, a, b, eta, c, lambda, w);
+    }
+   private:
+    LearnerType learner_type_;
+  };
+
+  // Runs loop on w with the learner of learner_type, taking its steps
+  // through Binding.
+  template <class Binding, class Loop>
+  void RunLoopWithBinding(const Loop& loop,
+			  LearnerType learner_type,
+			  SfWeightVector* w) {
+    switch (learner_type) {
+    case PEGASOS:
+      loop.template Run<Binding>(PegasosLearner<Binding>(), w);
+      return;
+    case MARGIN_PERCEPTRON:
+      loop.template Run<Binding>(MarginPerceptronLearner<Binding>(), w);
+      return;
+    case PASSIVE_AGGRESSIVE:
+      loop.template Run<Binding>(PassiveAggressiveLearner<Binding>(), w);
+      return;
+    case LOGREG_PEGASOS:
+      loop.template Run<Binding>(PegasosLogRegLearner<Binding>(), w);
+      return;
+    case LOGREG:
+      loop.template Run<Binding>(LogRegLearner<Binding>(), w);
+      return;
+    case LMS_REGRESSION:
+      loop.template Run<Binding>(LeastMeanSquaresLearner<Binding>(), w);
+      return;
+    case SGD_SVM:
+      loop.template Run<Binding>(SgdSvmLearner<Binding>(), w);
+      return;
+    case ROMMA:
+      loop.template Run<Binding>(RommaLearner<Binding>(), w);
+      return;
+    default:
+      std::cerr << "Error: learner_type " << learner_type
+		<< " not supported." << std::endl;
+      exit(0);
+    }
+  }
+
+  // Runs loop with the learner of learner_type, bound to the exact type of
+  // w.  Both are looked at only here, once for the whole loop, so that
+  // every step of the loop is bound at compile time.  A w of any other type
+  // takes its steps through AnyLearner instead.
+  template <class Loop>
+  void RunLoop(const Loop& loop, LearnerType learner_type, SfWeightVector* w) {
+    if (typeid(*w) == typeid(SfWeightVector)) {
+      RunLoopWithBinding<ExactBinding<SfWeightVector> >(loop, learner_type, w);
+    } else if (typeid(*w) == typeid(SfHashWeightVector)) {
+      RunLoopWithBinding<ExactBinding<SfHashWeightVector> >(loop,
+							    learner_type,
+							    w);
+    } else {
+      loop.template Run<VirtualBinding>(AnyLearner(learner_type), w);
+    }
+  }
+
+  // Does nothing, for a loop that runs on a single thread.
+  struct NoSync {
+    void BeforeStep(int k) {}
+  };
+
+  // The number of steps that each thread of a multi-threaded loop takes
+  // between syncs with the shared scale and squared norm of w.
+  const int kStepsBetweenSyncs = 512;
+
+  // The state shared by the threads of a multi-threaded loop, which train w
+  // together without locking its weights.  Each thread takes its steps on an
+  // SfSharedWeightVector of its own, sharing the weights of master_, which
+  // in turn shares those of w.  Every kStepsBetweenSyncs steps, a thread
+  // adds the scaling and change in squared norm of its steps to master_, and
+  // takes up the result (see SfSharedWeightVector).  mutex_ guards the scale
+  // and squared norm of master_, and the counts below.  A thread that finds
+  // the weights need rescaling waits on changed_ until no thread is taking
+  // steps, and threads waiting to take more steps let it go first.
+  class HogwildShared {
+   public:
+    // If project, the steps of the learner end in a Pegasos projection
+    // with lambda.
+    HogwildShared(SfWeightVector* w, bool project, float lambda)
+      : w_(w),
+	master_(w),
+	project_(project),
+	lambda_(lambda),
+	num_stepping_(0),
+	num_rescaling_(0) {
+      pthread_mutex_init(&mutex_, NULL);
+      pthread_cond_init(&changed_, NULL);
+    }
+
+    ~HogwildShared() {
+      pthread_cond_destroy(&changed_);
+      pthread_mutex_destroy(&mutex_);
+    }
+
+    SfSharedWeightVector* Master() { return &master_; }
+
+    // Called by a thread before it takes steps on view.
+    void StartSteps(SfSharedWeightVector* view) {
+      pthread_mutex_lock(&mutex_);
+      while (num_rescaling_ > 0) pthread_cond_wait(&changed_, &mutex_);
+      ++num_stepping_;
+      view->SyncFromShared();
+      pthread_mutex_unlock(&mutex_);
+    }
+
+    // Called by a thread once it has taken steps on view.
+    void FinishSteps(SfSharedWeightVector* view) {
+      pthread_mutex_lock(&mutex_);
+      view->AddChangesToShared();
+      // Each thread keeps its own view of w in the Pegasos ball, but the
+      // steps of all the threads together may not be.  Project once here,
+      // so that no thread need project the steps of the others.
+      if (project_) PegasosProjection(lambda_, &master_);
+      --num_stepping_;
+      if (master_.NeedsRescale()) {
+	++num_rescaling_;
+	while (num_stepping_ > 0) pthread_cond_wait(&changed_, &mutex_);
+	// Another thread may have rescaled while this one waited.
+	if (master_.NeedsRescale()) master_.RescaleWeights();
+	--num_rescaling_;
+	pthread_cond_broadcast(&changed_);
+      } else if (num_stepping_ == 0 && num_rescaling_ > 0) {
+	pthread_cond_broadcast(&changed_);
+      }
+      pthread_mutex_unlock(&mutex_);
+    }
+
+    // Hands the steps of all the threads on to w, once they have finished,
+    // with its squared norm summed afresh from the weights.
+    void Finish() {
+      master_.AddChangesToShared();
+      w_->RecomputeSquaredNorm();
+    }
+
+   private:
+    SfWeightVector* w_;
+    SfSharedWeightVector master_;
+    bool project_;
+    float lambda_;
+    int num_stepping_;
+    int num_rescaling_;
+    pthread_mutex_t mutex_;
+    pthread_cond_t changed_;
+
+    // Disallowed.
+    HogwildShared(const HogwildShared&);
+    void operator=(const HogwildShared&);
+  };
+
+  // The replicas of w that the threads of a parameter mixing loop train
+  // apart, one each, and the barrier at which the threads meet to average
+  // them.  Each thread averages its own range of the weights, over every
+  // replica.  The barrier is built from a mutex and a condition variable,
+  // as pthread_barrier_t is not available everywhere.
+  class ParameterMixing {
+   public:
+    explicit ParameterMixing(const vector<SfWeightVector*>& replicas)
+      : replicas_(replicas),
+	range_squared_norms_(replicas.size()),
+	num_waiting_(0),
+	generation_(0) {
+      pthread_mutex_init(&mutex_, NULL);
+      pthread_cond_init(&all_arrived_, NULL);
+    }
+
+    ~ParameterMixing() {
+      pthread_cond_destroy(&all_arrived_);
+      pthread_mutex_destroy(&mutex_);
+    }
+
+    // Called by every thread at once, each with its own index, to set
+    // every replica to the mean of the replicas.
+    void Mix(int index) {
+      // Wait for every thread to finish its steps.
+      Wait();
+      long int dimensions = replicas_[0]->GetDimensions();
+      int num_replicas = replicas_.size();
+      range_squared_norms_[index] = SfWeightVector::AverageRange(
+	  replicas_,
+	  dimensions * index / num_replicas,
+	  dimensions * (index + 1) / num_replicas);
+      // Wait for every range to be averaged.
+      Wait();
+      // Sum the ranges in the same order on every thread, for the same
+      // squared norm.
+      double squared_norm = 0.0;
+      for (int r = 0; r < num_replicas; ++r) {
+	squared_norm += range_squared_norms_[r];
+      }
+      replicas_[index]->FinishAveraging(squared_norm);
+    }
+
+   private:
+    // Returns once every thread has called Wait() as many times as this one.
+    void Wait() {
+      pthread_mutex_lock(&mutex_);
+      int generation = generation_;
+      if (++num_waiting_ == static_cast<int>(replicas_.size())) {
+	num_waiting_ = 0;
+	++generation_;
+	pthread_cond_broadcast(&all_arrived_);
+      } else {
+	while (generation == generation_) {
+	  pthread_cond_wait(&all_arrived_, &mutex_);
+	}
+      }
+      pthread_mutex_unlock(&mutex_);
+    }
+
+    vector<SfWeightVector*> replicas_;
+    vector<double> range_squared_norms_;
+    int num_waiting_;
+    int generation_;
+    pthread_mutex_t mutex_;
+    pthread_cond_t all_arrived_;
+
+    // Disallowed.
+    ParameterMixing(const ParameterMixing&);
+    void operator=(const ParameterMixing&);
+  };
+
+  // Takes num_iters steps of a learner on the examples that sampler draws
+  // for them: a classification step on a, for a step with no b, and
+  // otherwise a rank step on (a, b), or, if steps_on_each, a
+  // classification step on each of a and b in turn.  A step whose a is -1
+  // is skipped, though it still counts as one of the iterations.
+  template <class Sampler>
+  class SampledLoop {
+   public:
+    SampledLoop(const SfDataSet& training_set,
+		Sampler* sampler,
+		bool steps_on_each,
+		EtaType eta_type,
+		float lambda,
+		float c,
+		int num_iters,
+		SfRandom* random)
+      : training_set_(training_set),
+	sampler_(sampler),
+	steps_on_each_(steps_on_each),
+	eta_type_(eta_type),
+	lambda_(lambda),
+	c_(c),
+	num_iters_(num_iters),
+	random_(random) {}
+
+    // True if the sampler can draw the examples for a step.
+    bool CanDraw() const { return sampler_->CanDraw(); }
+
+    template <class Binding, class Learner>
+    void Run(const Learner& learner, SfWeightVector* w) const {
+      NoSync no_sync;
+      TakeSteps<Binding>(learner, sampler_, random_, 1, 1, num_iters_,
+			 &no_sync, w);
+    }
+
+    // As Run(), but with the steps taken on num_threads threads at once,
+    // through a HogwildShared.  Thread t takes steps t + 1,
+    // t + 1 + num_threads, t + 1 + 2 * num_threads, and so on, so that each
+    // step has the eta that it would have on a single thread.  Each thread
+    // draws its examples with a sampler made by ForThread(), and its own
+    // generator, both seeded from random.  The sampler must have been made
+    // before, so that any index of the data set that it uses has been
+    // built.  If project, the steps of learner end in a Pegasos projection.
+    template <class Binding, class Learner>
+    void RunOnThreads(const Learner& learner,
+		      int num_threads,
+		      bool project,
+		      SfWeightVector* w) const {
+      HogwildShared shared(w, project, lambda_);
+      unsigned int shuffle_seed = random_->RandUint32();
+      vector<HogwildThread<Binding, Learner>*> threads;
+      for (int t = 0; t < num_threads; ++t) {
+	threads.push_back(new HogwildThread<Binding, Learner>(
+	    this, learner, &shared, t, num_threads, shuffle_seed,
+	    random_->RandUint32()));
+      }
+      for (int t = 0; t < num_threads; ++t) {
+	if (pthread_create(&threads[t]->id, NULL,
+			   HogwildThread<Binding, Learner>::Start,
+			   threads[t]) != 0) {
+	  std::cerr << "Error creating training thread." << std::endl;
+	  exit(1);
+	}
+      }
+      for (int t = 0; t < num_threads; ++t) {
+	pthread_join(threads[t]->id, NULL);
+	delete threads[t];
+      }
+      shared.Finish();
+    }
+
+    // As Run(), but with the steps taken by parameter mixing on num_threads
+    // threads.  Thread t trains a replica of w on shard t of the training
+    // set, as drawn by DrawShards() from random, taking num_iters /
+    // num_threads of the steps, numbered from 1 for their eta, with a
+    // sampler of the same kind and its own generator, seeded from random
+    // after the shards are drawn.  Thread 0 trains w itself.
+    // Every mixing_interval steps, if that is above 0, and once all the
+    // steps are taken, every replica is set to the mean of the replicas.
+    // Each thread starts from the same w and takes up the same means, and
+    // the threads draw from nothing that they share, so the result does not
+    // depend on how the threads are scheduled.
+    template <class Binding, class Learner>
+    void RunMixed(const Learner& learner,
+		  int num_threads,
+		  int mixing_interval,
+		  SfWeightVector* w) const {
+      vector<SfWeightVector*> replicas(1, w);
+      for (int t = 1; t < num_threads; ++t) {
+	replicas.push_back(new SfWeightVector(*w));
+      }
+      ParameterMixing mixing(replicas);
+      // The shards, their samplers and their indexes are all made here,
+      // before any thread starts.
+      vector<vector<long int> > shards;
+      DrawShards(training_set_, num_threads, sampler_->ShardsByGroup(),
+		 random_, &shards);
+      vector<MixingThread<Binding, Learner>*> threads;
+      for (int t = 0; t < num_threads; ++t) {
+	threads.push_back(new MixingThread<Binding, Learner>(
+	    this, learner, &mixing, t, num_threads, mixing_interval,
+	    shards[t], random_->RandUint32(), replicas[t]));
+	if (!threads[t]->sampler.CanDraw()) {
+	  std::cerr << "Error: a shard of the training set has no examples "
+		    << "that this loop can sample; use fewer threads."
+		    << std::endl;
+	  exit(1);
+	}
+      }
+      for (int t = 0; t < num_threads; ++t) {
+	if (pthread_create(&threads[t]->id, NULL,
+			   MixingThread<Binding, Learner>::Start,
+			   threads[t]) != 0) {
+	  std::cerr << "Error creating training thread." << std::endl;
+	  exit(1);
+	}
+      }
+      for (int t = 0; t < num_threads; ++t) {
+	pthread_join(threads[t]->id, NULL);
+	delete threads[t];
+      }
+      for (int t = 1; t < num_threads; ++t) {
+	delete replicas[t];
+      }
+    }
+
+   private:
+    // One thread of RunMixed(), with its shard of the training set.
+    template <class Binding, class Learner>
+    struct MixingThread {
+      MixingThread(const SampledLoop* loop,
+		   const Learner& learner,
+		   ParameterMixing* mixing,
+		   int index,
+		   int num_threads,
+		   int mixing_interval,
+		   const vector<long int>& shard_examples,
+		   unsigned int seed,
+		   SfWeightVector* replica)
+	: learner(learner),
+	  mixing(mixing),
+	  index(index),
+	  mixing_interval(mixing_interval),
+	  // Every thread takes at least this many steps, and mixes only
+	  // before one of them, so that all threads mix equally often.
+	  min_steps(loop->num_iters_ / num_threads),
+	  num_steps(min_steps + (index < loop->num_iters_ % num_threads)),
+	  shard(loop->training_set_, shard_examples),
+	  sampler(loop->sampler_->ForShard(shard)),
+	  random(seed),
+	  replica(replica),
+	  shard_loop(shard, &sampler, loop->steps_on_each_, loop->eta_type_,
+		     loop->lambda_, loop->c_, num_steps, &random) {}
+
+      static void* Start(void* thread_pointer) {
+	MixingThread* thread = static_cast<MixingThread*>(thread_pointer);
+	thread->shard_loop.template TakeSteps<Binding>(
+	    thread->learner, &thread->sampler, &thread->random, 1, 1,
+	    thread->num_steps, thread, thread->replica);
+	thread->mixing->Mix(thread->index);
+	return NULL;
+      }
+
+      // Mixes the replicas every mixing_interval steps.
+      void BeforeStep(int k) {
+	if (mixing_interval > 0 && k > 0 && k < min_steps &&
+	    k % mixing_interval == 0) {
+	  mixing->Mix(index);
+	}
+      }
+
+      Learner learner;
+      ParameterMixing* mixing;
+      int index;
+      int mixing_interval;
+      int min_steps;
+      int num_steps;
+      SfDataSet shard;
+      Sampler sampler;
+      SfRandom random;
+      SfWeightVector* replica;
+      SampledLoop shard_loop;
+      pthread_t id;
+    };
+
+    // One thread of RunOnThreads(), and its view of w.
+    template <class Binding, class Learner>
+    struct HogwildThread {
+      HogwildThread(const SampledLoop* loop,
+		    const Learner& learner,
+		    HogwildShared* shared,
+		    int index,
+		    int num_threads,
+		    unsigned int shuffle_seed,
+		    unsigned int seed)
+	: loop(loop),
+	  learner(learner),
+	  shared(shared),
+	  sampler(loop->sampler_->ForThread(index, num_threads,
+					    shuffle_seed)),
+	  random(seed),
+	  view(shared->Master()),
+	  first_step(index + 1),
+	  num_threads(num_threads),
+	  num_steps((loop->num_iters_ - index + num_threads - 1) /
+		    num_threads) {}
+
+      static void* Start(void* thread_pointer) {
+	HogwildThread* thread = static_cast<HogwildThread*>(thread_pointer);
+	thread->shared->StartSteps(&thread->view);
+	thread->loop->template TakeSteps<Binding>(
+	    thread->learner, &thread->sampler, &thread->random,
+	    thread->first_step, thread->num_threads, thread->num_steps,
+	    thread, &thread->view);
+	thread->shared->FinishSteps(&thread->view);
+	return NULL;
+      }
+
+      // Syncs view every kStepsBetweenSyncs steps, and also as soon as its
+      // scale is small enough that the weights must be rescaled, which the
+      // view can not do itself.
+      void BeforeStep(int k) {
+	if ((k > 0 && k % kStepsBetweenSyncs == 0) || view.NeedsRescale()) {
+	  shared->FinishSteps(&view);
+	  shared->StartSteps(&view);
+	}
+      }
+
+      const SampledLoop* loop;
+      Learner learner;
+      HogwildShared* shared;
+      Sampler sampler;
+      SfRandom random;
+      SfSharedWeightVector view;
+      int first_step;
+      int num_threads;
+      int num_steps;
+      pthread_t id;
+    };
+
+    // Takes num_steps steps, drawn from sampler with random, calling
+    // sync->BeforeStep(k) before step k.  The steps are numbered first_step,
+    // first_step + step_stride, and so on, for their eta.
+    template <class Binding, class Learner, class Sync>
+    __attribute__((flatten))
+    void TakeSteps(const Learner& learner,
+		   Sampler* sampler,
+		   SfRandom* random,
+		   long int first_step,
+		   int step_stride,
+		   int num_steps,
+		   Sync* sync,
+		   SfWeightVector* w) const {
+      StepsAhead<Sampler, Binding> steps(training_set_, *w, num_steps,
+					 sampler, random);
+      long int i = first_step;
+      for (int k = 0; k < num_steps; ++k, i += step_stride) {
+	sync->BeforeStep(k);
+	StepExamples step = steps.Next();
+	if (step.a < 0) continue;
+	float eta = GetEta(eta_type_, lambda_, i);
+	SfSparseVectorView a = training_set_.VectorAt(step.a);
+	if (step.b < 0) {
+	  learner.Step(a, eta, c_, lambda_, w);
+	  continue;
+	}
+	SfSparseVectorView b = training_set_.VectorAt(step.b);
+	if (steps_on_each_) {
+	  learner.Step(a, eta, c_, lambda_, w);
+	  learner.Step(b, eta, c_, lambda_, w);
+	} else {
+	  learner.RankStep(a, b, eta, c_, lambda_, w);
+	}
+      }
+    }
+
+    const SfDataSet& training_set_;
+    Sampler* sampler_;
+    bool steps_on_each_;
+    EtaType eta_type_;
+    float lambda_;
+    float c_;
+    int num_iters_;
+    SfRandom* random_;
+  };
+
+  // Runs a SampledLoop on num_threads threads through HOGWILD, for
+  // RunLoopWithBinding().
+  template <class Loop>
+  class HogwildOnThreads {
+   public:
+    HogwildOnThreads(const Loop& loop, int num_threads, bool project)
+      : loop_(loop), num_threads_(num_threads), project_(project) {}
+
+    template <class Binding, class Learner>
+    void Run(const Learner& learner, SfWeightVector* w) const {
+      loop_.template RunOnThreads<Binding>(learner, num_threads_, project_,
+					   w);
+    }
+
+   private:
+    const Loop& loop_;
+    int num_threads_;
+    bool project_;
+  };
+
+  // Runs a SampledLoop on num_threads threads by parameter mixing, for
+  // RunLoopWithBinding().
+  template <class Loop>
+  class MixedOnThreads {
+   public:
+    MixedOnThreads(const Loop& loop, int num_threads, int mixing_interval)
+      : loop_(loop),
+	num_threads_(num_threads),
+	mixing_interval_(mixing_interval) {}
+
+    template <class Binding, class Learner>
+    void Run(const Learner& learner, SfWeightVector* w) const {
+      loop_.template RunMixed<Binding>(learner, num_threads_,
+				       mixing_interval_, w);
+    }
+
+   private:
+    const Loop& loop_;
+    int num_threads_;
+    int mixing_interval_;
+  };
+
+  // True if the steps of learner_type end in a Pegasos projection, which
+  // does nothing for a lambda of 0.
+  bool EndsStepsWithProjection(LearnerType learner_type) {
+    return learner_type == PEGASOS ||
+      learner_type == PASSIVE_AGGRESSIVE ||
+      learner_type == LOGREG_PEGASOS ||
+      learner_type == LMS_REGRESSION;
+  }
+
+  // Runs loop as RunLoop() does, or on num_threads threads at once, as
+  // thread_mode says, if num_threads is above 1.  Exits if the loop's
+  // sampler can draw no steps from the training set.  Only an SfWeightVector of
+  // exactly that type may be trained on more than one thread.  Parameter
+  // mixing steps replicas of that type, and HOGWILD steps an
+  // SfSharedWeightVector view of w on each thread, so each is bound to the
+  // type it steps.
+  template <class Sampler>
+  void RunSampledLoop(const SampledLoop<Sampler>& loop,
+		      LearnerType learner_type,
+		      int num_threads,
+		      ThreadMode thread_mode,
+		      int mixing_interval,
+		      SfWeightVector* w) {
+    if (!loop.CanDraw()) {
+      std::cerr << "Error: the training set has no examples that this loop "
+		<< "can sample." << std::endl;
+      exit(1);
+    }
+    if (num_threads <= 1) {
+      RunLoop(loop, learner_type, w);
+      return;
+    }
+    if (typeid(*w) != typeid(SfWeightVector)) {
+      std::cerr << "Error: only an unhashed weight vector may be trained on "
+		<< "more than one thread." << std::endl;
+      exit(1);
+    }
+    if (thread_mode == PARAMETER_MIXING) {
+      MixedOnThreads<SampledLoop<Sampler> >
+	on_threads(loop, num_threads, mixing_interval);
+      RunLoopWithBinding<ExactBinding<SfWeightVector> >(on_threads,
+							learner_type,
+							w);
+    } else {
+      HogwildOnThreads<SampledLoop<Sampler> >
+	on_threads(loop, num_threads, EndsStepsWithProjection(learner_type));
+      RunLoopWithBinding<ExactBinding<SfSharedWeightVector> >(on_threads,
+							      learner_type,
+							      w);
+    }
+  }
+
   // --------------------------------------------------- //
   //            Stochastic Loop Strategy Functions
   // --------------------------------------------------- //
@@ -87,46 +1465,59 @@ namespace sofia_ml {
 			   float lambda,
 			   float c,
 			   int num_iters,
-			   SfWeightVector* w) {
-    for (int i = 1; i <= num_iters; ++i) {
-      int random_example = static_cast<int>(rand()) % training_set.NumExamples();
-      const SfSparseVector& x = training_set.VectorAt(random_example);
-      float eta = GetEta(eta_type, lambda, i);
-      OneLearnerStep(learner_type, x, eta, c, lambda, w);
-    }
+			   SfRandom* random,
+			   SfWeightVector* w,
+			   int num_threads,
+			   ThreadMode thread_mode,
+			   int mixing_interval) {
+    ExampleSampler sampler(training_set);
+    SampledLoop<ExampleSampler> loop(training_set, &sampler, false,
+				     eta_type, lambda, c, num_iters, random);
+    RunSampledLoop(loop, learner_type, num_threads, thread_mode,
+		   mixing_interval, w);
   }  
 
+  void EpochOuterLoop(const SfDataSet& training_set,
+		      int block_size,
+		      LearnerType learner_type,
+		      EtaType eta_type,
+		      float lambda,
+		      float c,
+		      int num_iters,
+		      SfRandom* random,
+		      SfWeightVector* w,
+		      int num_threads,
+		      ThreadMode thread_mode,
+		      int mixing_interval) {
+    if (training_set.NumExamples() == 0) return;
+    if (block_size < 1) block_size = 1;
+    EpochSampler sampler(training_set.NumExamples(), block_size);
+    SampledLoop<EpochSampler> loop(training_set, &sampler, false,
+				   eta_type, lambda, c, num_iters, random);
+    RunSampledLoop(loop, learner_type, num_threads, thread_mode,
+		   mixing_interval, w);
+  }
+
   void BalancedStochasticOuterLoop(const SfDataSet& training_set,
 				   LearnerType learner_type,
 				   EtaType eta_type,
 				   float lambda,
 				   float c,
 				   int num_iters,
-				   SfWeightVector* w) {
-    // Create index of positives and negatives for fast sampling
-    // of disagreeing pairs.
-    vector<int> positives;
-    vector<int> negatives;
-    for (int i = 0; i < training_set.NumExamples(); ++i) {
-      if (training_set.VectorAt(i).GetY() > 0.0)
-	positives.push_back(i);
-      else
-	negatives.push_back(i);
-    }
-
-    // For each iteration, randomly sample one positive and one negative and
-    // take one gradient step for each.
-    for (int i = 1; i <= num_iters; ++i) {
-      float eta = GetEta(eta_type, lambda, i);
-
-      const SfSparseVector& pos_x =
-	training_set.VectorAt(positives[RandInt(positives.size())]);
-      OneLearnerStep(learner_type, pos_x, eta, c, lambda, w);
-
-      const SfSparseVector& neg_x =
-	training_set.VectorAt(negatives[RandInt(negatives.size())]);
-      OneLearnerStep(learner_type, neg_x, eta, c, lambda, w);
-    }
+				   SfRandom* random,
+				   SfWeightVector* w,
+				   int num_threads,
+				   ThreadMode thread_mode,
+				   int mixing_interval) {
+    // Use the data set's index of positives and negatives for fast sampling
+    // of disagreeing pairs.  For each iteration, randomly sample one
+    // positive and one negative and take one gradient step for each.
+    PositiveNegativeSampler sampler(training_set);
+    SampledLoop<PositiveNegativeSampler> loop(training_set, &sampler, true,
+					      eta_type, lambda, c, num_iters,
+					      random);
+    RunSampledLoop(loop, learner_type, num_threads, thread_mode,
+		   mixing_interval, w);
   }
 
   void StochasticRocLoop(const SfDataSet& training_set,
@@ -135,28 +1526,20 @@ namespace sofia_ml {
 			 float lambda,
 			 float c,
 			 int num_iters,
-			 SfWeightVector* w) {
-    // Create index of positives and negatives for fast sampling
-    // of disagreeing pairs.
-    vector<int> positives;
-    vector<int> negatives;
-    for (int i = 0; i < training_set.NumExamples(); ++i) {
-      if (training_set.VectorAt(i).GetY() > 0.0)
-	positives.push_back(i);
-      else
-	negatives.push_back(i);
-    }
-
-    // For each step, randomly sample one positive and one negative and
-    // take a pairwise gradient step.
-    for (int i = 1; i <= num_iters; ++i) {
-      float eta = GetEta(eta_type, lambda, i);
-      const SfSparseVector& pos_x =
-	training_set.VectorAt(positives[RandInt(positives.size())]);
-      const SfSparseVector& neg_x =
-	training_set.VectorAt(negatives[RandInt(negatives.size())]);
-      OneLearnerRankStep(learner_type, pos_x, neg_x, eta, c, lambda, w);
-    }
+			 SfRandom* random,
+			 SfWeightVector* w,
+			 int num_threads,
+			 ThreadMode thread_mode,
+			 int mixing_interval) {
+    // Use the data set's index of positives and negatives for fast sampling
+    // of disagreeing pairs.  For each step, randomly sample one positive and
+    // one negative and take a pairwise gradient step.
+    PositiveNegativeSampler sampler(training_set);
+    SampledLoop<PositiveNegativeSampler> loop(training_set, &sampler, false,
+					      eta_type, lambda, c, num_iters,
+					      random);
+    RunSampledLoop(loop, learner_type, num_threads, thread_mode,
+		   mixing_interval, w);
   }
 
   void StochasticClassificationAndRocLoop(const SfDataSet& training_set,
@@ -166,37 +1549,20 @@ namespace sofia_ml {
 					   float c,
 					   float rank_step_probability,
 					   int num_iters,
-					   SfWeightVector* w) {
-    // Create index of positives and negatives for fast sampling
-    // of disagreeing pairs.
-    vector<int> positives;
-    vector<int> negatives;
-    for (int i = 0; i < training_set.NumExamples(); ++i) {
-      if (training_set.VectorAt(i).GetY() > 0.0)
-	positives.push_back(i);
-      else
-	negatives.push_back(i);
-    }
-
-    for (int i = 1; i <= num_iters; ++i) {
-      float eta = GetEta(eta_type, lambda, i);
-      if (RandFloat() < rank_step_probability) {
-	// For each step, randomly sample one positive and one negative and
-	// take a pairwise gradient step.
-	const SfSparseVector& pos_x =
-	  training_set.VectorAt(positives[RandInt(positives.size())]);
-	const SfSparseVector& neg_x =
-	  training_set.VectorAt(negatives[RandInt(negatives.size())]);
-	OneLearnerRankStep(learner_type, pos_x, neg_x, eta, c, lambda, w);
-      } else {
-	// Take a classification step.
-	int random_example =
-	  static_cast<int>(rand()) % training_set.NumExamples();
-	const SfSparseVector& x = training_set.VectorAt(random_example);
-	float eta = GetEta(eta_type, lambda, i);
-	OneLearnerStep(learner_type, x, eta, c, lambda, w);      
-      }
-    }
+					   SfRandom* random,
+					   SfWeightVector* w,
+					   int num_threads,
+					   ThreadMode thread_mode,
+					   int mixing_interval) {
+    // Rank steps sample one positive and one negative, using the data set's
+    // index of positives and negatives.
+    ClassificationAndRankSampler<PositiveNegativeSampler>
+      sampler(training_set, rank_step_probability);
+    SampledLoop<ClassificationAndRankSampler<PositiveNegativeSampler> >
+      loop(training_set, &sampler, false, eta_type, lambda, c, num_iters,
+	   random);
+    RunSampledLoop(loop, learner_type, num_threads, thread_mode,
+		   mixing_interval, w);
   }
   
   void StochasticClassificationAndRankLoop(const SfDataSet& training_set,
@@ -206,50 +1572,18 @@ namespace sofia_ml {
 					   float c,
 					   float rank_step_probability,
 					   int num_iters,
-					   SfWeightVector* w) {
-    std::map<string, std::map<float, vector<int> > > group_id_y_to_index;
-    std::map<string, int> group_id_y_to_count;
-    for (int i = 0; i < training_set.NumExamples(); ++i) {
-      const string& group_id = training_set.VectorAt(i).GetGroupId();
-      group_id_y_to_index[group_id][training_set.VectorAt(i).GetY()].push_back(i);
-      group_id_y_to_count[group_id] += 1;
-    }
-    
-    for (int i = 1; i <= num_iters; ++i) {
-      if (RandFloat() < rank_step_probability) {
-	// Take a rank step.
-	const SfSparseVector& a = RandomExample(training_set);
-	const string& group_id = a.GetGroupId();
-	float a_y = a.GetY();
-	const std::map<float, vector<int> >& y_to_list =
-	  group_id_y_to_index[group_id];
-	int range = group_id_y_to_count[group_id] -
-	  group_id_y_to_index[group_id][a_y].size();
-	if (range == 0) continue;
-	unsigned int random_int = RandInt(range);
-	for (std::map<float, vector<int> >::const_iterator iter =
-	       y_to_list.begin();
-	     iter != y_to_list.end();
-	     iter++) {
-	  if (iter->first == a_y) continue;
-	  if (random_int < iter->second.size()) {
-	    const SfSparseVector& b = 
-	      training_set.VectorAt((iter->second)[random_int]);
-	    float eta = GetEta(eta_type, lambda, i);
-	    OneLearnerRankStep(learner_type, a, b, eta, c, lambda, w);
-	    break;
-	  }
-	  random_int -= iter->second.size();
-	}
-      } else {
-	// Take a classification step.
-	int random_example =
-	  static_cast<int>(rand()) % training_set.NumExamples();
-	const SfSparseVector& x = training_set.VectorAt(random_example);
-	float eta = GetEta(eta_type, lambda, i);
-	OneLearnerStep(learner_type, x, eta, c, lambda, w);
-      }
-    }
+					   SfRandom* random,
+					   SfWeightVector* w,
+					   int num_threads,
+					   ThreadMode thread_mode,
+					   int mixing_interval) {
+    ClassificationAndRankSampler<RankPairSampler>
+      sampler(training_set, rank_step_probability);
+    SampledLoop<ClassificationAndRankSampler<RankPairSampler> >
+      loop(training_set, &sampler, false, eta_type, lambda, c, num_iters,
+	   random);
+    RunSampledLoop(loop, learner_type, num_threads, thread_mode,
+		   mixing_interval, w);
   }
 
   void StochasticRankLoop(const SfDataSet& training_set,
@@ -258,39 +1592,16 @@ namespace sofia_ml {
 			 float lambda,
 			 float c,
 			 int num_iters,
-			 SfWeightVector* w) {
-    std::map<string, std::map<float, vector<int> > > group_id_y_to_index;
-    std::map<string, int> group_id_y_to_count;
-    for (int i = 0; i < training_set.NumExamples(); ++i) {
-      const string& group_id = training_set.VectorAt(i).GetGroupId();
-      group_id_y_to_index[group_id][training_set.VectorAt(i).GetY()].push_back(i);
-      group_id_y_to_count[group_id] += 1;
-    }
-    
-    for (int i = 1; i <= num_iters; ++i) {
-      const SfSparseVector& a = RandomExample(training_set);
-      const string& group_id = a.GetGroupId();
-      float a_y = a.GetY();
-      const std::map<float, vector<int> >& y_to_list =
-	group_id_y_to_index[group_id];
-      int range =
-	group_id_y_to_count[group_id] - group_id_y_to_index[group_id][a_y].size();
-      if (range == 0) continue;
-      unsigned int random_int = RandInt(range);
-      for (std::map<float, vector<int> >::const_iterator iter = y_to_list.begin();
-	   iter != y_to_list.end();
-	   iter++) {
-	if (iter->first == a_y) continue;
-	if (random_int < iter->second.size()) {
-	  const SfSparseVector& b = 
-	    training_set.VectorAt((iter->second)[random_int]);
-	  float eta = GetEta(eta_type, lambda, i);
-	  OneLearnerRankStep(learner_type, a, b, eta, c, lambda, w);
-	  break;
-	}
-	random_int -= iter->second.size();
-      }
-    }
+			 SfRandom* random,
+			 SfWeightVector* w,
+			 int num_threads,
+			 ThreadMode thread_mode,
+			 int mixing_interval) {
+    RankPairSampler sampler(training_set);
+    SampledLoop<RankPairSampler> loop(training_set, &sampler, false,
+				      eta_type, lambda, c, num_iters, random);
+    RunSampledLoop(loop, learner_type, num_threads, thread_mode,
+		   mixing_interval, w);
   }
 
   void StochasticQueryNormRankLoop(const SfDataSet& training_set,
@@ -299,58 +1610,228 @@ namespace sofia_ml {
 				   float lambda,
 				   float c,
 				   int num_iters,
-				   SfWeightVector* w) {
-    // Create a map of group id's to examples.
-    std::map<string, vector<int> > group_id_to_examples;
-    for (int i = 0; i < training_set.NumExamples(); ++i) {
-      const string& group_id = training_set.VectorAt(i).GetGroupId();
-      group_id_to_examples[group_id].push_back(i);
-    }
+				   SfRandom* random,
+				   SfWeightVector* w,
+				   int num_threads,
+				   ThreadMode thread_mode,
+				   int mixing_interval) {
+    // Groups whose examples all share one label have no rank pairs, and are
+    // left out, so that every iteration takes a step.
+    if (training_set.RankIndex().NumRankableGroups() == 0) return;
+    QueryNormRankPairSampler sampler(training_set);
+    SampledLoop<QueryNormRankPairSampler> loop(training_set, &sampler, false,
+					       eta_type, lambda, c, num_iters,
+					       random);
+    RunSampledLoop(loop, learner_type, num_threads, thread_mode,
+		   mixing_interval, w);
+  }
 
-    // Assign each group id a unique integer id.
-    std::map<int, vector<int>* > group_id_index;
-    int i = 0;
-    for (std::map<string, vector<int> >::iterator group_id_iter =
-	   group_id_to_examples.begin();
-	 group_id_iter != group_id_to_examples.end();
-	 ++group_id_iter) {
-      group_id_index[i] = &(group_id_iter->second);
-      ++i;
-    }
-
-    for (int i = 1; i <= num_iters; ++i) {
-      int group_id = RandInt(group_id_index.size());
-      vector<int>* group_index = group_id_index[group_id];
-      int group_index_size = group_index->size();
-      const SfSparseVector& a =
-	training_set.VectorAt((*group_index)[RandInt(group_index_size)]);
-
-      bool found_differing_pair = false;
-      int num_chances = 1000;
-      while (!found_differing_pair && --num_chances > 0) {
-	const SfSparseVector& b =
-	  training_set.VectorAt((*group_index)[RandInt(group_index_size)]);
-
-	found_differing_pair = a.GetY() != b.GetY();
-        if (found_differing_pair) {
-	  float eta = GetEta(eta_type, lambda, i);
-	  OneLearnerRankStep(learner_type, a, b, eta, c, lambda, w);
-	  break;
+  // Batches of examples parsed in the background by StreamingOuterLoop, and
+  // the number of them that may wait to be trained on.
+  const int kBackgroundBatchSize = 1000;
+  const int kMaxQueuedBatches = 4;
+
+  // Takes one step of learner on an example chosen uniformly at random
+  // from shuffle_buffer, counting the step in *i, and returns the example's
+  // slot so that the caller may replace or remove it.  First grows w to fit
+  // every example in the buffer, as for FitDimensionality().
+  template <class Learner>
+  int StepOnRandomExample(const Learner& learner,
+			  const SfShuffleBuffer& shuffle_buffer,
+			  int max_dimensionality,
+			  EtaType eta_type,
+			  float lambda,
+			  float c,
+			  long int* i,
+			  SfRandom* random,
+			  SfWeightVector* w) {
+    FitDimensionality(shuffle_buffer.MaxFeatureId(), max_dimensionality, w);
+    int slot = random->RandInt(shuffle_buffer.Size());
+    float eta = GetEta(eta_type, lambda, ++(*i));
+    learner.Step(shuffle_buffer.At(slot), eta, c, lambda, w);
+    return slot;
+  }
+
+  // The loop of StreamingOuterLoop, for RunLoop().
+  class StreamingLoop {
+   public:
+    StreamingLoop(const string& file_name,
+		  int buffer_mb,
+		  bool use_bias_term,
+		  bool parse_in_background,
+		  int max_dimensionality,
+		  int shuffle_buffer_mb,
+		  int num_passes,
+		  EtaType eta_type,
+		  float lambda,
+		  float c,
+		  const SfFeatureMap& feature_map,
+		  SfRandom* random)
+      : file_name_(file_name),
+	buffer_mb_(buffer_mb),
+	use_bias_term_(use_bias_term),
+	parse_in_background_(parse_in_background),
+	max_dimensionality_(max_dimensionality),
+	shuffle_buffer_mb_(shuffle_buffer_mb),
+	num_passes_(num_passes),
+	eta_type_(eta_type),
+	lambda_(lambda),
+	c_(c),
+	feature_map_(feature_map),
+	random_(random) {}
+
+    template <class Binding, class Learner>
+    void Run(const Learner& learner, SfWeightVector* w) const {
+      SfShuffleBuffer shuffle_buffer(shuffle_buffer_mb_ * 1024L * 1024L);
+      SfSparseVector x;
+      long int i = 0;
+      for (int pass = 0; pass < num_passes_; ++pass) {
+	if (parse_in_background_) {
+	  SfBackgroundReader reader(file_name_, buffer_mb_, use_bias_term_,
+				    kBackgroundBatchSize, kMaxQueuedBatches);
+	  SfDataSet* batch;
+	  while ((batch = reader.NextBatch()) != NULL) {
+	    if (!feature_map_.Empty()) batch->RemapFeatures(feature_map_);
+	    for (long int j = 0; j < batch->NumExamples(); ++j) {
+	      if (!shuffle_buffer.IsFull()) {
+		shuffle_buffer.Add(batch->VectorAt(j));
+		continue;
+	      }
+	      int slot = StepOnRandomExample(learner, shuffle_buffer,
+					     max_dimensionality_, eta_type_,
+					     lambda_, c_, &i, random_, w);
+	      shuffle_buffer.Replace(slot, batch->VectorAt(j));
+	    }
+	    delete batch;
+	  }
+	  continue;
+	}
+
+	SfLineReader line_reader(file_name_, buffer_mb_ * 1024L * 1024L);
+	const char* line_begin;
+	const char* line_end;
+	while (line_reader.NextLine(&line_begin, &line_end)) {
+	  if (!feature_map_.Empty()) {
+	    // Mapped examples are parsed here, rather than in the buffer.
+	    x.Parse(line_begin, line_end, use_bias_term_);
+	    feature_map_.MapVector(&x);
+	    if (!shuffle_buffer.IsFull()) {
+	      shuffle_buffer.Add(SfSparseVectorView(x));
+	      continue;
+	    }
+	    int slot = StepOnRandomExample(learner, shuffle_buffer,
+					   max_dimensionality_, eta_type_,
+					   lambda_, c_, &i, random_, w);
+	    shuffle_buffer.Replace(slot, SfSparseVectorView(x));
+	    continue;
+	  }
+	  if (!shuffle_buffer.IsFull()) {
+	    shuffle_buffer.Add(line_begin, line_end, use_bias_term_);
+	    continue;
+	  }
+	  int slot = StepOnRandomExample(learner, shuffle_buffer,
+					 max_dimensionality_, eta_type_,
+					 lambda_, c_, &i, random_, w);
+	  shuffle_buffer.Replace(slot, line_begin, line_end, use_bias_term_);
 	}
       }
-    } 
+
+      // Use up the examples left in the buffer.
+      while (shuffle_buffer.Size() > 0) {
+	shuffle_buffer.Remove(StepOnRandomExample(
+	    learner, shuffle_buffer, max_dimensionality_, eta_type_, lambda_,
+	    c_, &i, random_, w));
+      }
+    }
+
+   private:
+    const string& file_name_;
+    int buffer_mb_;
+    bool use_bias_term_;
+    bool parse_in_background_;
+    int max_dimensionality_;
+    int shuffle_buffer_mb_;
+    int num_passes_;
+    EtaType eta_type_;
+    float lambda_;
+    float c_;
+    const SfFeatureMap& feature_map_;
+    SfRandom* random_;
+  };
+
+  void StreamingOuterLoop(const string& file_name,
+			  int buffer_mb,
+			  bool use_bias_term,
+			  bool parse_in_background,
+			  int max_dimensionality,
+			  int shuffle_buffer_mb,
+			  int num_passes,
+			  LearnerType learner_type,
+			  EtaType eta_type,
+			  float lambda,
+			  float c,
+			  const SfFeatureMap& feature_map,
+			  SfRandom* random,
+			  SfWeightVector* w) {
+    StreamingLoop loop(file_name, buffer_mb, use_bias_term,
+		       parse_in_background, max_dimensionality,
+		       shuffle_buffer_mb, num_passes, eta_type, lambda, c,
+		       feature_map, random);
+    RunLoop(loop, learner_type, w);
+  }
+
+  void FitDimensionality(int max_feature_id,
+			 int max_dimensionality,
+			 SfWeightVector* w) {
+    if (max_feature_id < w->GetDimensions()) return;
+    if (max_dimensionality > 0 && max_feature_id >= max_dimensionality) {
+      std::cerr << "Feature id " << max_feature_id
+		<< " exceeds the maximum dimensionality of "
+		<< max_dimensionality << std::endl;
+      exit(1);
+    }
+    w->GrowToFit(max_feature_id);
+  }
+
+  void DrawShards(const SfDataSet& training_set,
+		  int num_shards,
+		  bool by_group,
+		  SfRandom* random,
+		  vector<vector<long int> >* shards) {
+    by_group = by_group && training_set.NumGroups() >= num_shards;
+    // The units dealt out are groups, or single examples.
+    int num_units = by_group ? training_set.NumGroups() :
+      training_set.NumExamples();
+    vector<int> order(num_units);
+    for (int u = 0; u < num_units; ++u) {
+      order[u] = u;
+    }
+    for (int u = num_units - 1; u > 0; --u) {
+      std::swap(order[u], order[random->RandInt(u + 1)]);
+    }
+    // Dealing the units round robin keeps the shards within one unit of
+    // each other in size.
+    vector<int> shard_of_unit(num_units);
+    for (int u = 0; u < num_units; ++u) {
+      shard_of_unit[order[u]] = u % num_shards;
+    }
+    shards->assign(num_shards, vector<long int>());
+    for (long int i = 0; i < training_set.NumExamples(); ++i) {
+      int unit = by_group ? training_set.GroupAt(i) : i;
+      (*shards)[shard_of_unit[unit]].push_back(i);
+    }
   }
 
   //------------------------------------------------------------------------------//
   //                    Methods for Applying a Model on Data                      //
   //------------------------------------------------------------------------------//
 
-  float SingleSvmPrediction(const SfSparseVector& x,
+  float SingleSvmPrediction(const SfSparseVectorView& x,
 			    const SfWeightVector& w) {
     return w.InnerProduct(x);
   }
 
-  float SingleLogisticPrediction(const SfSparseVector& x,
+  float SingleLogisticPrediction(const SfSparseVectorView& x,
 				 const SfWeightVector& w) {
     float p = w.InnerProduct(x);
     return exp(p) / (1.0 + exp(p));
@@ -397,7 +1878,7 @@ namespace sofia_ml {
   // --------------------------------------------------- //
   
   bool OneLearnerStep(LearnerType learner_type,
-		      const SfSparseVector& x,
+		      const SfSparseVectorView& x,
 		      float eta,
 		      float c,
 		      float lambda,
@@ -427,8 +1908,8 @@ namespace sofia_ml {
   }
 
   bool OneLearnerRankStep(LearnerType learner_type,
-			  const SfSparseVector& a,
-			  const SfSparseVector& b,
+			  const SfSparseVectorView& a,
+			  const SfSparseVectorView& b,
 			  float eta,
 			  float c,
 			  float lambda,
@@ -461,291 +1942,132 @@ namespace sofia_ml {
   //            Single Stochastic Step Functions
   // --------------------------------------------------- //
   
-  bool SinglePegasosStep(const SfSparseVector& x,
+  bool SinglePegasosStep(const SfSparseVectorView& x,
 			  float eta,
 			  float lambda,
 			  SfWeightVector* w) {
-    float p = x.GetY() * w->InnerProduct(x);    
-
-    L2Regularize(eta, lambda, w);    
-    // If x has non-zero loss, perform gradient step in direction of x.
-    if (p < 1.0 && x.GetY() != 0.0) {
-      w->AddVector(x, (eta * x.GetY())); 
-    }
-
-    PegasosProjection(lambda, w);
-    return (p < 1.0 && x.GetY() != 0.0);
+    return PegasosLearner<VirtualBinding>().Step(x, eta, 0.0, lambda, w);
   }
 
-  bool SingleRommaStep(const SfSparseVector& x,
+  bool SingleRommaStep(const SfSparseVectorView& x,
 		       SfWeightVector* w) {
-    float wx = w->InnerProduct(x);
-    float p = x.GetY() * wx;
-    const float kVerySmallNumber = 0.0000000001;
-    
-    // If x has non-zero loss, perform gradient step in direction of x.
-    if (p < 1.0 && x.GetY() != 0.0) {
-      float xx = x.GetSquaredNorm();
-      float ww = w->GetSquaredNorm();
-      float c = ((xx * ww) - p + kVerySmallNumber) /
-	((xx * ww) - (wx * wx) + kVerySmallNumber);
-
-      float d = (ww * (x.GetY() - wx) + kVerySmallNumber) /
-	((xx * ww) - (wx * wx) + kVerySmallNumber);
-
-      // Avoid numerical problems caused by examples of extremely low magnitude.
-      if (c >= 0.0) {
-	w->ScaleBy(c);
-	w->AddVector(x, d); 
-      }
-    }
-
-    return (p < 1.0 && x.GetY() != 0.0);
+    return RommaLearner<VirtualBinding>().Step(x, 0.0, 0.0, 0.0, w);
   }
 
-  bool SingleSgdSvmStep(const SfSparseVector& x,
+  bool SingleSgdSvmStep(const SfSparseVectorView& x,
 			  float eta,
 			  float lambda,
 			  SfWeightVector* w) {
-    float p = x.GetY() * w->InnerProduct(x);    
-
-    L2Regularize(eta, lambda, w);    
-    // If x has non-zero loss, perform gradient step in direction of x.
-    if (p < 1.0 && x.GetY() != 0.0) {
-      w->AddVector(x, (eta * x.GetY())); 
-    }
-
-    return (p < 1.0 && x.GetY() != 0.0);
+    return SgdSvmLearner<VirtualBinding>().Step(x, eta, 0.0, lambda, w);
   }
 
-  bool SingleMarginPerceptronStep(const SfSparseVector& x,
+  bool SingleMarginPerceptronStep(const SfSparseVectorView& x,
 				  float eta,
 				  float c,
 				  SfWeightVector* w) {
-    if (x.GetY() * w->InnerProduct(x) <= c) {
-      w->AddVector(x, eta * x.GetY());
-      return true;
-    } else {
-      return false;
-    }
+    return MarginPerceptronLearner<VirtualBinding>().Step(x, eta, c, 0.0, w);
   }
 
-  bool SinglePegasosLogRegStep(const SfSparseVector& x,
+  bool SinglePegasosLogRegStep(const SfSparseVectorView& x,
 			       float eta,
 			       float lambda,
 			       SfWeightVector* w) {
-    float loss = x.GetY() / (1 + exp(x.GetY() * w->InnerProduct(x)));
-
-    L2Regularize(eta, lambda, w);    
-    w->AddVector(x, (eta * loss));
-    PegasosProjection(lambda, w);
-    return (true);
+    return PegasosLogRegLearner<VirtualBinding>().Step(x, eta, 0.0, lambda, w);
   }
 
-  bool SingleLogRegStep(const SfSparseVector& x,
+  bool SingleLogRegStep(const SfSparseVectorView& x,
 			float eta,
 			float lambda,
 			SfWeightVector* w) {
-    float loss = x.GetY() / (1 + exp(x.GetY() * w->InnerProduct(x)));
-
-    L2Regularize(eta, lambda, w);    
-    w->AddVector(x, (eta * loss));
-    return (true);
+    return LogRegLearner<VirtualBinding>().Step(x, eta, 0.0, lambda, w);
   }
 
-  bool SingleLeastMeanSquaresStep(const SfSparseVector& x,
+  bool SingleLeastMeanSquaresStep(const SfSparseVectorView& x,
 				  float eta,
 				  float lambda,
 				  SfWeightVector* w) {
-    float loss = x.GetY() - w->InnerProduct(x);
-    L2Regularize(eta, lambda, w);    
-    w->AddVector(x, (eta * loss));
-    PegasosProjection(lambda, w);
-    return (true);
+    return LeastMeanSquaresLearner<VirtualBinding>().Step(
+	x, eta, 0.0, lambda, w);
   }
 
-  bool SinglePassiveAggressiveStep(const SfSparseVector& x,
+  bool SinglePassiveAggressiveStep(const SfSparseVectorView& x,
 				   float lambda,
 				   float max_step,
 				   SfWeightVector* w) {
-    float p = 1 - (x.GetY() * w->InnerProduct(x));    
-    // If x has non-zero loss, perform gradient step in direction of x.
-    if (p > 0.0 && x.GetY() != 0.0) {
-      float step = p / x.GetSquaredNorm();
-      if (step > max_step) step = max_step;
-      w->AddVector(x, (step * x.GetY())); 
-    }
-
-    if (lambda > 0.0) {
-      PegasosProjection(lambda, w);
-    }
-    return (p < 1.0 && x.GetY() != 0.0);
+    return PassiveAggressiveLearner<VirtualBinding>().Step(
+	x, 0.0, max_step, lambda, w);
   }
 
-  bool SinglePassiveAggressiveRankStep(const SfSparseVector& a,
-				       const SfSparseVector& b,
+  bool SinglePassiveAggressiveRankStep(const SfSparseVectorView& a,
+				       const SfSparseVectorView& b,
 				       float lambda,
 				       float max_step,
 				       SfWeightVector* w) {
-    float y = (a.GetY() > b.GetY()) ? 1.0 :
-      (a.GetY() < b.GetY()) ? -1.0 : 0.0;
-    float p = 1 - (y * w->InnerProductOnDifference(a, b)); 
-    // If (a-b) has non-zero loss, perform gradient step in direction of x.
-    if (p > 0.0 && y != 0.0) {
-      // Compute squared norm of (a-b).
-      int i = 0;
-      int j = 0;
-      float squared_norm = 0;
-      while (i < a.NumFeatures() || j < b.NumFeatures()) {
-	int a_feature = (i < a.NumFeatures()) ? a.FeatureAt(i) : INT_MAX;
-	int b_feature = (j < b.NumFeatures()) ? b.FeatureAt(j) : INT_MAX;
-	if (a_feature < b_feature) {
-	  squared_norm += a.ValueAt(i) * a.ValueAt(i);
-	  ++i;
-	} else if (b_feature < a_feature) {
-	  squared_norm += b.ValueAt(j) * b.ValueAt(j);
-	  ++j;
-	} else {
-	  squared_norm += (a.ValueAt(i) - b.ValueAt(j)) * (a.ValueAt(i) - b.ValueAt(j));
-	  ++i;
-	  ++j;
-	}
-      }
-      float step = p / squared_norm;
-      if (step > max_step) step = max_step;
-      w->AddVector(a, (step * y)); 
-      w->AddVector(b, (step * y * -1.0)); 
-    }
-
-    if (lambda > 0.0) {
-      PegasosProjection(lambda, w);
-    }
-    return (p > 0 && y != 0.0);
+    return PassiveAggressiveLearner<VirtualBinding>().RankStep(
+	a, b, 0.0, max_step, lambda, w);
   }
 
-  bool SinglePegasosRankStep(const SfSparseVector& a,
-			     const SfSparseVector& b,
+  bool SinglePegasosRankStep(const SfSparseVectorView& a,
+			     const SfSparseVectorView& b,
 			     float eta,
 			     float lambda,
 			     SfWeightVector* w) {
-    float y = (a.GetY() > b.GetY()) ? 1.0 :
-      (a.GetY() < b.GetY()) ? -1.0 : 0.0;
-    float p = y * w->InnerProductOnDifference(a, b);
-
-    L2Regularize(eta, lambda, w);
-
-    // If (a - b) has non-zero loss, perform gradient step.         
-    if (p < 1.0 && y != 0.0) {
-      w->AddVector(a, (eta * y));
-      w->AddVector(b, (-1.0 * eta * y));
-    }
-
-    PegasosProjection(lambda, w);
-    return (p < 1.0 && y != 0.0);
+    return PegasosLearner<VirtualBinding>().RankStep(a, b, eta, 0.0, lambda, w);
   }
 
-  bool SingleSgdSvmRankStep(const SfSparseVector& a,
-			     const SfSparseVector& b,
+  bool SingleSgdSvmRankStep(const SfSparseVectorView& a,
+			     const SfSparseVectorView& b,
 			     float eta,
 			     float lambda,
 			     SfWeightVector* w) {
-    float y = (a.GetY() > b.GetY()) ? 1.0 :
-      (a.GetY() < b.GetY()) ? -1.0 : 0.0;
-    float p = y * w->InnerProductOnDifference(a, b);
-
-    L2Regularize(eta, lambda, w);
-
-    // If (a - b) has non-zero loss, perform gradient step.         
-    if (p < 1.0 && y != 0.0) {
-      w->AddVector(a, (eta * y));
-      w->AddVector(b, (-1.0 * eta * y));
-    }
-
-    return (p < 1.0 && y != 0.0);
+    return SgdSvmLearner<VirtualBinding>().RankStep(a, b, eta, 0.0, lambda, w);
   }
 
-  bool SingleLeastMeanSquaresRankStep(const SfSparseVector& a,
-			     const SfSparseVector& b,
+  bool SingleLeastMeanSquaresRankStep(const SfSparseVectorView& a,
+			     const SfSparseVectorView& b,
 			     float eta,
 			     float lambda,
 			     SfWeightVector* w) {
-    float y = (a.GetY() - b.GetY());
-    float loss = y - w->InnerProductOnDifference(a, b);
-
-    L2Regularize(eta, lambda, w);
-    w->AddVector(a, (eta * loss));
-    w->AddVector(b, (-1.0 * eta * loss));
-    PegasosProjection(lambda, w);
-    return (true);
+    return LeastMeanSquaresLearner<VirtualBinding>().RankStep(
+	a, b, eta, 0.0, lambda, w);
   }
 
-  bool SingleRommaRankStep(const SfSparseVector& a,
-			   const SfSparseVector& b,
+  bool SingleRommaRankStep(const SfSparseVectorView& a,
+			   const SfSparseVectorView& b,
 			   SfWeightVector* w) {
-    // Not the most efficient approach, but it takes care of
-    // computing the squared norm of x with minimal coding effort.
-    float y = (a.GetY() > b.GetY()) ? 1.0 :
-      (a.GetY() < b.GetY()) ? -1.0 : 0.0;
-    SfSparseVector x_diff(a, b, y);
-    if (y != 0.0) {
-      return SingleRommaStep(x_diff, w);
-    } else {
-      return false;
-    }
+    return RommaLearner<VirtualBinding>().RankStep(a, b, 0.0, 0.0, 0.0, w);
   }
 
-  bool SinglePegasosLogRegRankStep(const SfSparseVector& a,
-				   const SfSparseVector& b,
+  bool SinglePegasosLogRegRankStep(const SfSparseVectorView& a,
+				   const SfSparseVectorView& b,
 				   float eta,
 				   float lambda,
 				   SfWeightVector* w) {
-    float y = (a.GetY() > b.GetY()) ? 1.0 :
-      (a.GetY() < b.GetY()) ? -1.0 : 0.0;
-    float loss = y / (1 + exp(y * w->InnerProductOnDifference(a, b)));
-    L2Regularize(eta, lambda, w);    
-
-    w->AddVector(a, (eta * loss));
-    w->AddVector(b, (-1.0 * eta * loss));
-
-    PegasosProjection(lambda, w);
-    return (true);
+    return PegasosLogRegLearner<VirtualBinding>().RankStep(
+	a, b, eta, 0.0, lambda, w);
   }
 
-  bool SingleLogRegRankStep(const SfSparseVector& a,
-			    const SfSparseVector& b,
+  bool SingleLogRegRankStep(const SfSparseVectorView& a,
+			    const SfSparseVectorView& b,
 			    float eta,
 			    float lambda,
 			    SfWeightVector* w) {
-    float y = (a.GetY() > b.GetY()) ? 1.0 :
-      (a.GetY() < b.GetY()) ? -1.0 : 0.0;
-    float loss = y / (1 + exp(y * w->InnerProductOnDifference(a, b)));
-    L2Regularize(eta, lambda, w);    
-
-    w->AddVector(a, (eta * loss));
-    w->AddVector(b, (-1.0 * eta * loss));
-    return (true);
+    return LogRegLearner<VirtualBinding>().RankStep(a, b, eta, 0.0, lambda, w);
   }
 
-  bool SingleMarginPerceptronRankStep(const SfSparseVector& a,
-				      const SfSparseVector& b,
+  bool SingleMarginPerceptronRankStep(const SfSparseVectorView& a,
+				      const SfSparseVectorView& b,
 				      float eta,
 				      float c,
 				      SfWeightVector* w) {
-    float y = (a.GetY() > b.GetY()) ? 1.0 :
-      (a.GetY() < b.GetY()) ? -1.0 : 0.0;
-    if (y * w->InnerProductOnDifference(a, b) <= c) {
-      w->AddVector(a, eta);
-      w->AddVector(b, -1.0 * eta);
-      return true;
-    } else {
-      return false;
-    }
+    return MarginPerceptronLearner<VirtualBinding>().RankStep(
+	a, b, eta, c, 0.0, w);
   }
 
-  bool SinglePegasosRankWithTiesStep(const SfSparseVector& rank_a,
-				     const SfSparseVector& rank_b,
-				     const SfSparseVector& tied_a,
-				     const SfSparseVector& tied_b,
+  bool SinglePegasosRankWithTiesStep(const SfSparseVectorView& rank_a,
+				     const SfSparseVectorView& rank_b,
+				     const SfSparseVectorView& tied_a,
+				     const SfSparseVectorView& tied_b,
 				     float eta,
 				     float lambda,
 				     SfWeightVector* w) {
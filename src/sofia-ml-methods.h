@@ -26,6 +26,8 @@
 #define SOFIA_ML_METHODS_H__
 
 #include "sf-data-set.h"
+#include "sf-feature-map.h"
+#include "sf-random.h"
 #include "sf-sparse-vector.h"
 #include "sf-weight-vector.h"
 
@@ -44,6 +46,17 @@ namespace sofia_ml {
   //   lambda        regularization parameter (ignored by some LearnerTypes)
   //   c             capacity parameter (ignored by some LearnerTypes)
   //   num_iters     number of stochastic steps to take.
+  //   random        the generator used to sample examples, which the caller
+  //                   seeds; each thread training at once needs its own.
+  //   num_threads   the number of threads that take the steps, as set by
+  //                   thread_mode.  Above 1, each thread samples with a
+  //                   generator of its own, seeded from random, and w must
+  //                   be an SfWeightVector, not a subclass such as
+  //                   SfHashWeightVector.
+  //   thread_mode   a ThreadMode enum showing how the threads share w.
+  //   mixing_interval  with PARAMETER_MIXING, the number of steps each
+  //                   thread takes between averages, or 0 to average only
+  //                   once, at the end.
 
   // We currently support the following learners.
   enum LearnerType {
@@ -65,6 +78,18 @@ namespace sofia_ml {
     CONSTANT  // Use constant eta = 0.02 for all steps.
   };
 
+  // Steps may be taken on several threads in different ways.
+  enum ThreadMode {
+    HOGWILD,  // All threads share the weights of w, and update them without
+              // locks ("Hogwild!"), so that an update may now and then be
+              // lost, and the result differs from run to run.
+    PARAMETER_MIXING  // Each thread trains its own replica of w on its own
+                      // shard of the training set, num_iters / num_threads
+                      // steps in all, and the replicas are averaged into w.
+                      // The result depends only on random, not on how the
+                      // threads happen to be scheduled.
+  };
+
   // Trains a model w over training_set, using learner_type and eta_type learner with
   // given parameters.  For each iteration, samples one example uniformly at random from
   // training set.  Each example in the training_set has an equal probability of being
@@ -76,7 +101,33 @@ namespace sofia_ml {
                            float lambda,
                            float c,
                            int num_iters,
-                           SfWeightVector* w);
+                           SfRandom* random,
+                           SfWeightVector* w,
+                           int num_threads = 1,
+                           ThreadMode thread_mode = HOGWILD,
+                           int mixing_interval = 0);
+
+  // Trains a model w over training_set, using learner_type and eta_type learner with
+  // given parameters.  Rather than sampling with replacement, takes num_iters steps
+  // over a series of epochs, each of which visits every example exactly once in a
+  // fresh random order.  The order is shuffled in blocks of block_size consecutive
+  // examples, which are then visited in sequence, so that the examples of a block
+  // are read from memory in order and may be prefetched.  A block_size of 1 gives a
+  // plain random permutation of the examples in each epoch.  On several threads,
+  // Hogwild style, the threads take turns at the steps of one such series, so each
+  // epoch still visits every example once.
+  void EpochOuterLoop(const SfDataSet& training_set,
+		      int block_size,
+		      LearnerType learner_type,
+		      EtaType eta_type,
+		      float lambda,
+		      float c,
+		      int num_iters,
+		      SfRandom* random,
+		      SfWeightVector* w,
+		      int num_threads = 1,
+		      ThreadMode thread_mode = HOGWILD,
+		      int mixing_interval = 0);
 
   // Trains a model w over training_set, using learner_type and eta_type learner with
   // given parameters.  For each iteration, samples one positive example uniformly at
@@ -89,7 +140,11 @@ namespace sofia_ml {
                                    float lambda,
                                    float c,
                                    int num_iters,
-                                   SfWeightVector* w);
+                                   SfRandom* random,
+                                   SfWeightVector* w,
+                                   int num_threads = 1,
+                                   ThreadMode thread_mode = HOGWILD,
+                                   int mixing_interval = 0);
 
   // Trains a model w over training_set, using learner_type and eta_type learner with
   // given parameters.  For each iteration, samples one positive example uniformly at
@@ -102,7 +157,11 @@ namespace sofia_ml {
 			 float lambda,
 			 float c,
 			 int num_iters,
-			 SfWeightVector* w);
+			 SfRandom* random,
+			 SfWeightVector* w,
+			 int num_threads = 1,
+			 ThreadMode thread_mode = HOGWILD,
+			 int mixing_interval = 0);
 
   void StochasticClassificationAndRocLoop(const SfDataSet& training_set,
 					   LearnerType learner_type,
@@ -111,7 +170,11 @@ namespace sofia_ml {
 					   float c,
 					   float rank_step_probability,
 					   int num_iters,
-					   SfWeightVector* w);
+					   SfRandom* random,
+					   SfWeightVector* w,
+					   int num_threads = 1,
+					   ThreadMode thread_mode = HOGWILD,
+					   int mixing_interval = 0);
 
   void StochasticClassificationAndRankLoop(const SfDataSet& training_set,
 					   LearnerType learner_type,
@@ -120,7 +183,11 @@ namespace sofia_ml {
 					   float c,
 					   float rank_step_probability,
 					   int num_iters,
-					   SfWeightVector* w);
+					   SfRandom* random,
+					   SfWeightVector* w,
+					   int num_threads = 1,
+					   ThreadMode thread_mode = HOGWILD,
+					   int mixing_interval = 0);
 
   // Trains a model w over training_set, using learner_type and eta_type learner with
   // given parameters.  Trains a model using the RankSVM objective function, using
@@ -133,29 +200,87 @@ namespace sofia_ml {
 			  float lambda,
 			  float c,
 			  int num_iters,
-			  SfWeightVector* w);
+			  SfRandom* random,
+			  SfWeightVector* w,
+			  int num_threads = 1,
+			  ThreadMode thread_mode = HOGWILD,
+			  int mixing_interval = 0);
 
   // Optimize RankSVM objective function, but weight each query-id equally (even if some queries
-  // have very few or very many examples).  Currently this is implemented using rejection-sampling,
-  // which is slower than indexed-based sampling.
+  // have very few or very many examples).  Each step samples a query with at least two different
+  // ranks, an example from it, and then an example of a different rank from the same query,
+  // directly from the rank index.  Queries in which every example has the same rank are skipped.
   void StochasticQueryNormRankLoop(const SfDataSet& training_set,
 				   LearnerType learner_type,
 				   EtaType eta_type,
 				   float lambda,
 				   float c,
 				   int num_iters,
-				   SfWeightVector* w);
+				   SfRandom* random,
+				   SfWeightVector* w,
+				   int num_threads = 1,
+				   ThreadMode thread_mode = HOGWILD,
+				   int mixing_interval = 0);
+
+  // Trains a model w by streaming examples from the file file_name, rather than
+  // from a data set held in memory, so that memory use does not grow with the
+  // size of the file.  Examples pass through a shuffle buffer holding about
+  // shuffle_buffer_mb megabytes of examples: once the buffer is full, each new
+  // example replaces a buffered example chosen uniformly at random, and one step
+  // of learner_type is taken on the evicted example.  The file is read
+  // num_passes times, and at the end the examples left in the buffer are used in
+  // random order.  Thus one step is taken per example per pass.  The file is
+  // read through a buffer of buffer_mb megabytes, and use_bias_term is as for
+  // SfDataSet.  If parse_in_background is true, the file is read and parsed on
+  // a separate thread, in batches, while training goes on.  As the dimensionality
+  // of the data is not known in advance, w is grown to fit the examples as they
+  // are read, as for FitDimensionality() with max_dimensionality.  If
+  // feature_map is not empty, the feature ids of each example are first mapped
+  // by it, so that a model trained with --remap_features may go on training;
+  // features the map does not hold are dropped.
+  void StreamingOuterLoop(const string& file_name,
+			  int buffer_mb,
+			  bool use_bias_term,
+			  bool parse_in_background,
+			  int max_dimensionality,
+			  int shuffle_buffer_mb,
+			  int num_passes,
+			  LearnerType learner_type,
+			  EtaType eta_type,
+			  float lambda,
+			  float c,
+			  const SfFeatureMap& feature_map,
+			  SfRandom* random,
+			  SfWeightVector* w);
+
+  // Grows w, if need be, to fit feature ids up to max_feature_id.  If
+  // max_dimensionality is positive, exits instead if that would need more than
+  // max_dimensionality weights.
+  void FitDimensionality(int max_feature_id,
+			 int max_dimensionality,
+			 SfWeightVector* w);
+
+  // Splits the examples of training_set into num_shards shards, for
+  // PARAMETER_MIXING, by dealing them out in an order drawn from random.
+  // If by_group, and there are at least num_shards groups, whole groups are
+  // dealt out instead, so that every rank pair stays within one shard.
+  // Each shard lists the indices of its examples in increasing order.
+  void DrawShards(const SfDataSet& training_set,
+		  int num_shards,
+		  bool by_group,
+		  SfRandom* random,
+		  vector<vector<long int> >* shards);
 
   //------------------------------------------------------------------------------//
   //                    Methods for Applying a Model on Data                      //
   //------------------------------------------------------------------------------//
 
   // Computes a single linear prediction, returning f(x) = < x, w >
-  float SingleSvmPrediction(const SfSparseVector& x,
+  float SingleSvmPrediction(const SfSparseVectorView& x,
 			    const SfWeightVector& w);
 
   // Computes a single linear prediction, returning f(x) = e(< x, w >) / (1.0 + e(< x, w >))
-  float SingleLogisticPrediction(const SfSparseVector& x,
+  float SingleLogisticPrediction(const SfSparseVectorView& x,
 				 const SfWeightVector& w);
 
   // Performs a SingleSvmPrediction on each example in test_data.
@@ -181,7 +306,7 @@ namespace sofia_ml {
   // Takes one step using the LearnerType defined by method, and returns true
   // iff the method took a gradient step (ie, modified the model).
   bool OneLearnerStep(LearnerType method,
-		      const SfSparseVector& x,
+		      const SfSparseVectorView& x,
 		      float eta,
 		      float c,
 		      float lambda,
@@ -190,8 +315,8 @@ namespace sofia_ml {
   // Takes one rank (a-b) step using the LearnerType defined by method, and returns true
   // iff the method took a gradient step (mod.
   bool OneLearnerRankStep(LearnerType method,
-			  const SfSparseVector& a,
-			  const SfSparseVector& b,
+			  const SfSparseVectorView& a,
+			  const SfSparseVectorView& b,
 			  float eta,
 			  float c,
 			  float lambda,
@@ -203,14 +328,14 @@ namespace sofia_ml {
 
   // Takes a single PEGASOS step, including regularization and projection.
   // Returns true iff the example x was violating KKT conditions.
-  bool SinglePegasosStep(const SfSparseVector& x,
+  bool SinglePegasosStep(const SfSparseVectorView& x,
 			 float eta,
 			 float lambda,
 			 SfWeightVector* w);
 
   // Takes a single SGD SVM step, including regularization.
   // Returns true iff the example x was violating KKT conditions.
-  bool SingleSgdSvmStep(const SfSparseVector& x,
+  bool SingleSgdSvmStep(const SfSparseVectorView& x,
 			float eta,
 			float lambda,
 			SfWeightVector* w);
@@ -219,7 +344,7 @@ namespace sofia_ml {
   // regression) rather than hinge loss function (SVM loss).  Includes
   // L2 regularization and projection.  Always returns true, as updates
   // are performed for all examples.
-  bool SinglePegasosLogRegStep(const SfSparseVector& x,
+  bool SinglePegasosLogRegStep(const SfSparseVectorView& x,
 			       float eta,
 			       float lambda,
 			       SfWeightVector* w);
@@ -227,7 +352,7 @@ namespace sofia_ml {
   // Takes a single SDG step using logistic loss function (logistic
   // regression) rather than hinge loss function (SVM loss).  Includes
   // L2 regularization. Always returns true.
-  bool SingleLogRegStep(const SfSparseVector& x,
+  bool SingleLogRegStep(const SfSparseVectorView& x,
 			float eta,
 			float lambda,
 			SfWeightVector* w);
@@ -236,19 +361,19 @@ namespace sofia_ml {
   // rather than hinge loss function (SVM loss).  Includes L2 regularization
   // and projection.  Always returns true, as updates are performed for all
   // examples.
-  bool SingleLeastMeanSquaresStep(const SfSparseVector& x,
+  bool SingleLeastMeanSquaresStep(const SfSparseVectorView& x,
 				  float eta,
 				  float lambda,
 				  SfWeightVector* w);
 
   // Takes a single margin-perceptron step (with margin size = c).
-  bool SingleMarginPerceptronStep(const SfSparseVector& x,
+  bool SingleMarginPerceptronStep(const SfSparseVectorView& x,
 				  float eta,
 				  float c,
 				  SfWeightVector* w);
 
   // Takes a single ROMMA step.
-  bool SingleRommaStep(const SfSparseVector& x,
+  bool SingleRommaStep(const SfSparseVectorView& x,
 		       SfWeightVector* w);
 
   // Takes a single RANK step with PEGASOS, including regularization and
@@ -256,8 +381,8 @@ namespace sofia_ml {
   // y = 1 iff a.GetY() > b.GetY(), y = -1 iff b.GetY() > a.GetY(),
   // and y = 0 otherwise. Returns true iff the example x was violating KKT
   // conditions and y != 0.
-  bool SinglePegasosRankStep(const SfSparseVector& a,
-			     const SfSparseVector& b,
+  bool SinglePegasosRankStep(const SfSparseVectorView& a,
+			     const SfSparseVectorView& b,
 			     float eta,
 			     float lambda,
 			     SfWeightVector* w);
@@ -267,45 +392,45 @@ namespace sofia_ml {
   // y = 1 iff a.GetY() > b.GetY(), y = -1 iff b.GetY() > a.GetY(),
   // and y = 0 otherwise. Returns true iff the example x was violating KKT
   // conditions and y != 0.
-  bool SingleSgdSvmRankStep(const SfSparseVector& a,
-			     const SfSparseVector& b,
+  bool SingleSgdSvmRankStep(const SfSparseVectorView& a,
+			     const SfSparseVectorView& b,
 			     float eta,
 			     float lambda,
 			     SfWeightVector* w);
 
   // Takes a single ROMMA rank step.
-  bool SingleRommaRankStep(const SfSparseVector& a,
-			   const SfSparseVector& b,
+  bool SingleRommaRankStep(const SfSparseVectorView& a,
+			   const SfSparseVectorView& b,
 			   SfWeightVector* w);
 
   // Takes a single margin-perceptron step (with margin size = c), on the
   // vector (a-b).
-  bool SingleMarginPerceptronRankStep(const SfSparseVector& a,
-				      const SfSparseVector& b,
+  bool SingleMarginPerceptronRankStep(const SfSparseVectorView& a,
+				      const SfSparseVectorView& b,
 				      float eta,
 				      float c,
 				      SfWeightVector* w);
 
   // Takes a single margin-perceptron step (with margin size = c), on the
   // vector (a-b).
-  bool SingleLeastMeanSquaresRankStep(const SfSparseVector& a,
-				      const SfSparseVector& b,
+  bool SingleLeastMeanSquaresRankStep(const SfSparseVectorView& a,
+				      const SfSparseVectorView& b,
 				      float eta,
 				      float c,
 				      SfWeightVector* w);
 
   // Takes a single logistic regression step on vector (a-b), using pegasos
   // projection for regularization.
-  bool SinglePegasosLogRegRankStep(const SfSparseVector& a,
-                                   const SfSparseVector& b,
+  bool SinglePegasosLogRegRankStep(const SfSparseVectorView& a,
+                                   const SfSparseVectorView& b,
                                    float eta,
                                    float lambda,
                                    SfWeightVector* w);
 
   // Takes a single logistic regression step on vector (a-b), using lambda
   // regularization.
-  bool SingleLogRegRankStep(const SfSparseVector& a,
-			    const SfSparseVector& b,
+  bool SingleLogRegRankStep(const SfSparseVectorView& a,
+			    const SfSparseVectorView& b,
 			    float eta,
 			    float lambda,
 			    SfWeightVector* w);
@@ -313,10 +438,10 @@ namespace sofia_ml {
 
   // Takes a single RANK WITH TIES step using PEGASOS, including regularization
   // and projection.
-  bool SinglePegasosRankWithTiesStep(const SfSparseVector& rank_a,
-                                     const SfSparseVector& rank_b,
-                                     const SfSparseVector& tied_a,
-                                     const SfSparseVector& tied_b,
+  bool SinglePegasosRankWithTiesStep(const SfSparseVectorView& rank_a,
+                                     const SfSparseVectorView& rank_b,
+                                     const SfSparseVectorView& tied_a,
+                                     const SfSparseVectorView& tied_b,
                                      float eta,
                                      float lambda,
                                      SfWeightVector* w);
@@ -324,7 +449,7 @@ namespace sofia_ml {
   // Takes a single Passive-Aggressive step, including projection if
   // lambda is greater than 0.0.  Returns true iff the example x was
   // violating KKT conditions.
-  bool SinglePassiveAggressiveStep(const SfSparseVector& x,
+  bool SinglePassiveAggressiveStep(const SfSparseVectorView& x,
 				   float lambda,
 				   float max_step,
 				   SfWeightVector* w);
@@ -334,8 +459,8 @@ namespace sofia_ml {
   // y = 1 iff a.GetY() > b.GetY(), y = -1 iff b.GetY() > a.GetY(),
   // and y = 0 otherwise. Returns true iff the example x was violating KKT
   // conditions and y != 0.
-  bool SinglePassiveAggressiveRankStep(const SfSparseVector& a,
-				       const SfSparseVector& b,
+  bool SinglePassiveAggressiveRankStep(const SfSparseVectorView& a,
+				       const SfSparseVectorView& b,
 				       float lambda,
 				       float max_step,
 				       SfWeightVector* w);
@@ -0,0 +1,157 @@
+//================================================================================//
+// Copyright 2026 The sofia-ml Authors                                            //
+//                                                                                //
+// Licensed under the Apache License, Version 2.0 (the "License");                //
+// you may not use this file except in compliance with the License.               //
+// You may obtain a copy of the License at                                        //
+//                                                                                //
+//      http://www.apache.org/licenses/LICENSE-2.0                                //
+//                                                                                //
+// Unless required by applicable law or agreed to in writing, software            //
+// distributed under the License is distributed on an "AS IS" BASIS,              //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.       //
+// See the License for the specific language governing permissions and            //
+// limitations under the License.                                                 //
+//================================================================================//
+//
+// sofia-ml-methods_benchmark.cc
+//
+// Compares --loop_type stochastic, which samples examples with replacement,
+// against --loop_type epoch, which walks a fresh shuffle of the examples
+// each epoch, optionally in blocks of consecutive examples.  For each, the
+// throughput in steps per second and the SVM objective reached after the
+// same number of steps are reported.  Sampling with replacement reads the
+// examples in random order; larger epoch blocks read them more and more
+// sequentially.  The difference shows only once the data set is much larger
+// than the processor cache.  Sampling with replacement is also run on
+// several threads at once (--threads), sharing one model and then mixing
+// replicas of it, to measure how throughput scales with the number of
+// threads; that needs as many cores.  Last,
+// --loop_type roc is run, to measure the throughput of rank steps on pairs
+// of examples.
+//
+// Usage: ./sofia-ml-methods_benchmark [svm-light file]
+// With no file, a synthetic data set of about 250MB is generated in memory.
+
+#include <sys/time.h>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include "sf-data-set.h"
+#include "sf-random.h"
+#include "sf-weight-vector.h"
+#include "sofia-ml-methods.h"
+
+using std::string;
+
+static const int kNumSyntheticExamples = 500000;
+static const int kSyntheticDimensionality = 200000;
+static const float kLambda = 0.0001;
+// Steps each thread takes between averages of the replicas, when mixing.
+static const int kMixingInterval = 10000;
+
+// Wall-clock time in seconds.
+double WallTime() {
+  struct timeval now;
+  gettimeofday(&now, NULL);
+  return now.tv_sec + now.tv_usec / 1000000.0;
+}
+
+// Fills data_set with sparse examples of roughly 60 non-zero features each,
+// labeled by the sign of a fixed random linear model, with 5% of the labels
+// flipped.
+void AddSyntheticExamples(int num_examples, SfDataSet* data_set) {
+  SfRandom random(1);
+  float* model = new float[kSyntheticDimensionality];
+  for (int i = 0; i < kSyntheticDimensionality; ++i) {
+    model[i] = random.RandFloat() - 0.5;
+  }
+  for (int i = 0; i < num_examples; ++i) {
+    std::ostringstream features;
+    float score = 0.0;
+    int id = 0;
+    while (true) {
+      id += 1 + random.RandInt(2 * kSyntheticDimensionality / 60);
+      if (id >= kSyntheticDimensionality) break;
+      float value = random.RandFloat();
+      score += model[id] * value;
+      features << " " << id << ":" << value;
+    }
+    bool positive = (score > 0) != (random.RandInt(20) == 0);
+    data_set->AddVector((positive ? "1" : "-1") + features.str());
+  }
+  delete[] model;
+}
+
+// Trains a fresh model with the given loop for num_steps steps, and
+// reports its throughput and the objective value reached.  Loop types of
+// "stochastic" and "roc" ignore block_size.
+void Run(const SfDataSet& data_set,
+	 const string& loop_type,
+	 int block_size,
+	 int num_threads,
+	 sofia_ml::ThreadMode thread_mode,
+	 int num_steps) {
+  SfWeightVector w(data_set.MaxFeatureId() + 1);
+  SfRandom random(1);
+  double start = WallTime();
+  if (loop_type == "stochastic") {
+    sofia_ml::StochasticOuterLoop(data_set, sofia_ml::PEGASOS,
+				  sofia_ml::PEGASOS_ETA, kLambda, 0,
+				  num_steps, &random, &w, num_threads,
+				  thread_mode, kMixingInterval);
+  } else if (loop_type == "roc") {
+    sofia_ml::StochasticRocLoop(data_set, sofia_ml::PEGASOS,
+				sofia_ml::PEGASOS_ETA, kLambda, 0,
+				num_steps, &random, &w, num_threads,
+				thread_mode, kMixingInterval);
+  } else {
+    sofia_ml::EpochOuterLoop(data_set, block_size, sofia_ml::PEGASOS,
+			     sofia_ml::PEGASOS_ETA, kLambda, 0, num_steps,
+			     &random, &w, num_threads, thread_mode,
+			     kMixingInterval);
+  }
+  double num_secs = WallTime() - start;
+
+  std::ostringstream name;
+  name << loop_type;
+  if (loop_type == "epoch") name << ", block size " << block_size;
+  if (num_threads > 1) name << ", " << num_threads << " threads";
+  if (num_threads > 1 && thread_mode == sofia_ml::PARAMETER_MIXING) {
+    name << ", mixing";
+  }
+  std::cout << name.str() << ": " << num_steps / num_secs << " steps/s, "
+	    << "objective " << sofia_ml::SvmObjective(data_set, w, kLambda)
+	    << std::endl;
+}
+
+int main (int argc, char** argv) {
+  SfDataSet* data_set;
+  if (argc > 1) {
+    data_set = new SfDataSet(argv[1], 40, true);
+  } else {
+    data_set = new SfDataSet(true);
+    AddSyntheticExamples(kNumSyntheticExamples, data_set);
+  }
+  std::cout << data_set->NumExamples() << " examples" << std::endl;
+
+  // Three epochs' worth of steps for every loop.
+  int num_steps = 3 * data_set->NumExamples();
+  Run(*data_set, "stochastic", 1, 1, sofia_ml::HOGWILD, num_steps);
+  Run(*data_set, "epoch", 1, 1, sofia_ml::HOGWILD, num_steps);
+  Run(*data_set, "epoch", 64, 1, sofia_ml::HOGWILD, num_steps);
+  Run(*data_set, "epoch", 4096, 1, sofia_ml::HOGWILD, num_steps);
+  for (int num_threads = 2; num_threads <= 8; num_threads *= 2) {
+    Run(*data_set, "stochastic", 1, num_threads, sofia_ml::HOGWILD,
+	num_steps);
+  }
+  for (int num_threads = 2; num_threads <= 8; num_threads *= 2) {
+    Run(*data_set, "stochastic", 1, num_threads, sofia_ml::PARAMETER_MIXING,
+	num_steps);
+  }
+  Run(*data_set, "roc", 1, 1, sofia_ml::HOGWILD, num_steps);
+  delete data_set;
+}
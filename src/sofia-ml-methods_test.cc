@@ -15,10 +15,42 @@
 //================================================================================//
 //
 #include <assert.h>
+#include <cmath>
+#include <cstdlib>
 #include <iostream>
+#include <new>
+#include <sstream>
 
+#include "sf-hash-weight-vector.h"
 #include "sofia-ml-methods.h"
 
+// Counts heap allocations, so that steps can be checked to make none.
+static int num_allocations = 0;
+
+void* operator new(size_t size) {
+  ++num_allocations;
+  void* memory = malloc(size);
+  if (memory == NULL) throw std::bad_alloc();
+  return memory;
+}
+
+void operator delete(void* memory) throw() {
+  free(memory);
+}
+
+// A weight vector of a type that the loops do not know, which counts the
+// steps taken through its own TakeStep().
+class CountingWeightVector : public SfWeightVector {
+ public:
+  explicit CountingWeightVector(int dimensionality)
+    : SfWeightVector(dimensionality), num_steps_(0) {}
+  virtual bool TakeStep(const SfSparseVectorView& x, SfStepRule* rule) {
+    ++num_steps_;
+    return SfWeightVector::TakeStep(x, rule);
+  }
+  int num_steps_;
+};
+
 int main (int argc, char** argv) {
   SfSparseVector x_p("1.0 0:1 1:1");
   SfSparseVector x_n("-1.0 0:-1 1:-1");
@@ -46,26 +78,400 @@ int main (int argc, char** argv) {
   assert(rank_2.ValueOf(0) < 2.84 + 0.01);
   assert(rank_2.ValueOf(0) > 2.84 - 0.01);
 
+  // A ROMMA rank step matches a step on the difference of the examples,
+  // up to rounding.
+  SfSparseVector romma_a("1 1:1.0 2:0.5");
+  SfSparseVector romma_b("-1 1:-0.5 3:1.0");
+  SfSparseVector romma_diff(romma_a, romma_b, 1.0);
+  SfWeightVector romma_rank(4);
+  SfWeightVector romma_single(4);
+  for (int i = 0; i < 3; ++i) {
+    assert(sofia_ml::SingleRommaRankStep(romma_a, romma_b, &romma_rank) ==
+	   sofia_ml::SingleRommaStep(romma_diff, &romma_single));
+    for (int j = 0; j < 4; ++j) {
+      assert(fabs(romma_rank.ValueOf(j) - romma_single.ValueOf(j)) < 1e-5);
+    }
+  }
+  assert(!sofia_ml::SingleRommaRankStep(romma_a, romma_a, &romma_rank));
+
+  // Rank steps make no heap allocations, for any learner.
+  for (int learner = sofia_ml::PEGASOS; learner <= sofia_ml::ROMMA;
+       ++learner) {
+    SfWeightVector rank_w(4);
+    int allocations_before = num_allocations;
+    for (int i = 0; i < 10; ++i) {
+      sofia_ml::OneLearnerRankStep(
+          static_cast<sofia_ml::LearnerType>(learner), romma_a, romma_b,
+	  0.1, 1.0, 0.1, &rank_w);
+      sofia_ml::OneLearnerRankStep(
+          static_cast<sofia_ml::LearnerType>(learner), romma_b, romma_a,
+	  0.1, 1.0, 0.1, &rank_w);
+    }
+    assert(num_allocations == allocations_before);
+  }
+
   SfDataSet data_set_2(false);
   data_set_2.AddVector("1 1:1.0 2:1.0");
   data_set_2.AddVector("-1 1:-1.0 2:-1.0");
   data_set_2.AddVector("1 1:0.5 2:-1.0");
   data_set_2.AddVector("-1 1:-1.0 2:-1.0");
-  SfWeightVector pegasos_5(3);
-  
-  srand(100);
-  sofia_ml::StochasticOuterLoop(data_set_2,
-				sofia_ml::PEGASOS,
-				sofia_ml::PEGASOS_ETA,
-				0.1,
-				0,
-				4,
-				&pegasos_5);
-  assert(pegasos_5.ValueOf(1) < 0.560);
-  assert(pegasos_5.ValueOf(1) > 0.559);
-  assert(pegasos_5.ValueOf(2) < 0.560);
-  assert(pegasos_5.ValueOf(2) > 0.559);
 
+  // Whichever examples are drawn, Pegasos separates this data and keeps
+  // w inside the ball of radius 1 / sqrt(lambda).
+  for (int seed = 1; seed <= 10; ++seed) {
+    SfWeightVector pegasos_5(3);
+    SfRandom random(seed);
+    sofia_ml::StochasticOuterLoop(data_set_2,
+				  sofia_ml::PEGASOS,
+				  sofia_ml::PEGASOS_ETA,
+				  0.1,
+				  0,
+				  100,
+				  &random,
+				  &pegasos_5);
+    for (int i = 0; i < data_set_2.NumExamples(); ++i) {
+      assert(sofia_ml::SingleSvmPrediction(data_set_2.VectorAt(i), pegasos_5) *
+	     data_set_2.VectorAt(i).GetY() > 0.0);
+    }
+    assert(pegasos_5.GetSquaredNorm() <= 1.0 / 0.1 + 0.0001);
+  }
+
+  // An epoch of one block visits the examples in order, exactly once.
+  SfWeightVector epoch_pegasos(3);
+  SfRandom epoch_random(100);
+  sofia_ml::EpochOuterLoop(data_set_2,
+			   4,
+			   sofia_ml::PEGASOS,
+			   sofia_ml::PEGASOS_ETA,
+			   0.1,
+			   0,
+			   4,
+			   &epoch_random,
+			   &epoch_pegasos);
+  SfWeightVector in_order_pegasos(3);
+  for (int i = 0; i < 4; ++i) {
+    sofia_ml::SinglePegasosStep(data_set_2.VectorAt(i), 1.0 / (0.1 * (i + 1)),
+				0.1, &in_order_pegasos);
+  }
+  for (int i = 0; i < 3; ++i) {
+    assert(epoch_pegasos.ValueOf(i) == in_order_pegasos.ValueOf(i));
+  }
+
+  // Smaller blocks still take exactly num_iters steps, over several epochs.
+  SfWeightVector epoch_romma(3);
+  sofia_ml::EpochOuterLoop(data_set_2,
+			   1,
+			   sofia_ml::ROMMA,
+			   sofia_ml::PEGASOS_ETA,
+			   0.1,
+			   0,
+			   10,
+			   &epoch_random,
+			   &epoch_romma);
+  assert(sofia_ml::SingleSvmPrediction(data_set_2.VectorAt(0),
+				       epoch_romma) > 0.0);
+  assert(sofia_ml::SingleSvmPrediction(data_set_2.VectorAt(1),
+				       epoch_romma) < 0.0);
+
+  // For every learner and kind of weight vector, a loop trains exactly as
+  // the same steps taken one at a time.
+  for (int learner = sofia_ml::PEGASOS; learner <= sofia_ml::ROMMA;
+       ++learner) {
+    // Dense, hashed and counting weight vectors of 8 weights each.
+    SfWeightVector dense_loop(8);
+    SfWeightVector dense_step(8);
+    SfHashWeightVector hash_loop(3);
+    SfHashWeightVector hash_step(3);
+    CountingWeightVector counting_loop(8);
+    CountingWeightVector counting_step(8);
+    SfWeightVector* loop_ws[3] = {&dense_loop, &hash_loop, &counting_loop};
+    SfWeightVector* step_ws[3] = {&dense_step, &hash_step, &counting_step};
+    for (int kind = 0; kind < 3; ++kind) {
+      SfWeightVector* loop_w = loop_ws[kind];
+      SfWeightVector* step_w = step_ws[kind];
+      SfRandom loop_random(7);
+      sofia_ml::StochasticOuterLoop(data_set_2,
+				    static_cast<sofia_ml::LearnerType>(learner),
+				    sofia_ml::CONSTANT,
+				    0.1,
+				    1.0,
+				    20,
+				    &loop_random,
+				    loop_w);
+      SfRandom step_random(7);
+      for (int i = 0; i < 20; ++i) {
+	sofia_ml::OneLearnerStep(
+	    static_cast<sofia_ml::LearnerType>(learner),
+	    data_set_2.VectorAt(step_random.RandInt(data_set_2.NumExamples())),
+	    0.02, 1.0, 0.1, step_w);
+      }
+      for (int j = 0; j < 8; ++j) {
+	assert(loop_w->ValueOf(j) == step_w->ValueOf(j));
+      }
+      assert(loop_w->GetSquaredNorm() == step_w->GetSquaredNorm());
+    }
+    assert(counting_loop.num_steps_ == 20);
+  }
+
+  // Steps taken on several threads at once still train every learner, and
+  // keep the squared norm in step with the weights.
+  for (int learner = sofia_ml::PEGASOS; learner <= sofia_ml::ROMMA;
+       ++learner) {
+    SfWeightVector threaded_w(3);
+    SfRandom threaded_random(7);
+    sofia_ml::StochasticOuterLoop(data_set_2,
+				  static_cast<sofia_ml::LearnerType>(learner),
+				  sofia_ml::PEGASOS_ETA,
+				  0.1,
+				  1.0,
+				  5000,
+				  &threaded_random,
+				  &threaded_w,
+				  4);
+    assert(sofia_ml::SingleSvmPrediction(data_set_2.VectorAt(0),
+					 threaded_w) > 0.0);
+    assert(sofia_ml::SingleSvmPrediction(data_set_2.VectorAt(1),
+					 threaded_w) < 0.0);
+    // The squared norm drifts from the weights over many syncs, and is
+    // summed afresh once the threads are done.
+    double squared_norm = 0.0;
+    for (int j = 0; j < 3; ++j) {
+      squared_norm += threaded_w.ValueOf(j) * threaded_w.ValueOf(j);
+    }
+    assert(fabs(threaded_w.GetSquaredNorm() - squared_norm) <=
+	   0.000001 * squared_norm + 1e-9);
+    // Pegasos projects onto the ball of radius 1 / sqrt(lambda).
+    if (learner == sofia_ml::PEGASOS) {
+      assert(threaded_w.GetSquaredNorm() <= 1.0 / 0.1 + 0.0001);
+    }
+  }
+
+  // With many features per example and a small lambda, the Pegasos
+  // projection shrinks the scale of each thread's view far enough that the
+  // weights must be rescaled while the threads train.
+  SfDataSet data_set_3(true);
+  SfRandom data_random(3);
+  for (int i = 0; i < 100; ++i) {
+    std::ostringstream example;
+    example << (i % 2 == 0 ? "-1" : "1");
+    for (int id = 1 + data_random.RandInt(30); id < 2000;
+	 id += 1 + data_random.RandInt(30)) {
+      example << " " << id << ":" << data_random.RandFloat();
+    }
+    data_set_3.AddVector(example.str());
+  }
+  for (int num_threads = 2; num_threads <= 4; ++num_threads) {
+    SfWeightVector rescaled_w(2000);
+    SfRandom rescaled_random(7);
+    sofia_ml::StochasticOuterLoop(data_set_3,
+				  sofia_ml::PEGASOS,
+				  sofia_ml::PEGASOS_ETA,
+				  0.0001,
+				  0,
+				  1000,
+				  &rescaled_random,
+				  &rescaled_w,
+				  num_threads);
+    double rescaled_norm = 0.0;
+    for (int j = 0; j < 2000; ++j) {
+      rescaled_norm += rescaled_w.ValueOf(j) * rescaled_w.ValueOf(j);
+    }
+    assert(rescaled_norm <= 1.0 / 0.0001 + 0.1);
+    assert(fabs(rescaled_w.GetSquaredNorm() - rescaled_norm) <=
+	   0.000001 * rescaled_norm);
+  }
+
+  // Threads share the epochs of an epoch loop between them, so that each
+  // epoch still visits every example exactly once.  Each example has a
+  // weight of its own, with no bias, and no step ever meets the margin, so
+  // that each visit adds exactly the constant eta of 0.02 to its weight.
+  SfDataSet one_hot(false);
+  for (int i = 1; i <= 12; ++i) {
+    std::ostringstream example;
+    example << "1 " << i << ":1";
+    one_hot.AddVector(example.str());
+  }
+  for (int num_threads = 2; num_threads <= 5; ++num_threads) {
+    for (int block_size = 1; block_size <= 5; block_size += 4) {
+      SfWeightVector visits_w(13);
+      SfRandom visits_random(11);
+      sofia_ml::EpochOuterLoop(one_hot,
+			       block_size,
+			       sofia_ml::PEGASOS,
+			       sofia_ml::CONSTANT,
+			       0.0,
+			       0,
+			       3 * 12,
+			       &visits_random,
+			       &visits_w,
+			       num_threads);
+      for (int i = 1; i <= 12; ++i) {
+	assert(lround(visits_w.ValueOf(i) / 0.02) == 3);
+      }
+    }
+  }
+
+  // Shards hold every example once, in order, and differ in size by at
+  // most one example, or, by group, keep each group whole.  With fewer
+  // groups than shards, the examples are dealt out instead.
+  SfDataSet grouped(true);
+  for (int i = 0; i < 12; ++i) {
+    std::ostringstream example;
+    example << (i % 2 == 0 ? "-1" : "1") << " qid:" << i % 5 << " 1:1";
+    grouped.AddVector(example.str());
+  }
+  for (int num_shards = 3; num_shards <= 6; num_shards += 3) {
+    for (int by_group = 0; by_group <= 1; ++by_group) {
+      SfRandom shard_random(5);
+      vector<vector<long int> > shards;
+      sofia_ml::DrawShards(grouped, num_shards, by_group, &shard_random,
+			   &shards);
+      assert(static_cast<int>(shards.size()) == num_shards);
+      int shard_of[12];
+      for (int i = 0; i < 12; ++i) {
+	shard_of[i] = -1;
+      }
+      for (int t = 0; t < num_shards; ++t) {
+	for (unsigned int k = 0; k < shards[t].size(); ++k) {
+	  assert(k == 0 || shards[t][k - 1] < shards[t][k]);
+	  assert(shard_of[shards[t][k]] == -1);
+	  shard_of[shards[t][k]] = t;
+	}
+	if (!by_group || num_shards > grouped.NumGroups()) {
+	  assert(static_cast<int>(shards[t].size()) == 12 / num_shards);
+	}
+      }
+      for (int i = 0; i < 12; ++i) {
+	assert(shard_of[i] != -1);
+	if (by_group && num_shards <= grouped.NumGroups()) {
+	  assert(shard_of[i] == shard_of[i % 5]);
+	}
+      }
+    }
+  }
+
+  // Parameter mixing with a single average at the end gives the mean of
+  // the same loop run on each shard apart, with the generators the threads
+  // are seeded with.
+  for (int learner = sofia_ml::PEGASOS; learner <= sofia_ml::ROMMA;
+       ++learner) {
+    SfWeightVector mixed_w(2000);
+    SfRandom mixed_random(7);
+    sofia_ml::StochasticOuterLoop(data_set_3,
+				  static_cast<sofia_ml::LearnerType>(learner),
+				  sofia_ml::PEGASOS_ETA,
+				  0.001,
+				  1.0,
+				  1001,
+				  &mixed_random,
+				  &mixed_w,
+				  2,
+				  sofia_ml::PARAMETER_MIXING);
+    SfRandom seed_random(7);
+    vector<vector<long int> > shards;
+    sofia_ml::DrawShards(data_set_3, 2, false, &seed_random, &shards);
+    SfRandom shard_random_0(seed_random.RandUint32());
+    SfRandom shard_random_1(seed_random.RandUint32());
+    SfDataSet shard_0(data_set_3, shards[0]);
+    SfDataSet shard_1(data_set_3, shards[1]);
+    SfWeightVector shard_w_0(2000);
+    SfWeightVector shard_w_1(2000);
+    sofia_ml::StochasticOuterLoop(shard_0,
+				  static_cast<sofia_ml::LearnerType>(learner),
+				  sofia_ml::PEGASOS_ETA,
+				  0.001,
+				  1.0,
+				  501,
+				  &shard_random_0,
+				  &shard_w_0);
+    sofia_ml::StochasticOuterLoop(shard_1,
+				  static_cast<sofia_ml::LearnerType>(learner),
+				  sofia_ml::PEGASOS_ETA,
+				  0.001,
+				  1.0,
+				  500,
+				  &shard_random_1,
+				  &shard_w_1);
+    double mixed_norm = 0.0;
+    for (int j = 0; j < 2000; ++j) {
+      float mean = (shard_w_0.ValueOf(j) + shard_w_1.ValueOf(j)) / 2.0;
+      assert(fabs(mixed_w.ValueOf(j) - mean) <= 0.0001 * fabs(mean) + 1e-6);
+      mixed_norm += mixed_w.ValueOf(j) * mixed_w.ValueOf(j);
+    }
+    assert(fabs(mixed_w.GetSquaredNorm() - mixed_norm) <=
+	   0.0001 * mixed_norm + 1e-6);
+  }
+
+  // Mixing every few steps, on threads that are scheduled differently from
+  // run to run, gives the same model every time.
+  for (int run = 0; run < 2; ++run) {
+    SfWeightVector mixed_w_a(2000);
+    SfWeightVector mixed_w_b(2000);
+    SfWeightVector* mixed_ws[2] = {&mixed_w_a, &mixed_w_b};
+    for (int i = 0; i < 2; ++i) {
+      SfRandom mixed_random(11);
+      sofia_ml::StochasticRankLoop(data_set_3,
+				   sofia_ml::PEGASOS,
+				   sofia_ml::PEGASOS_ETA,
+				   0.001,
+				   0,
+				   2000,
+				   &mixed_random,
+				   mixed_ws[i],
+				   3 + run,
+				   sofia_ml::PARAMETER_MIXING,
+				   25);
+    }
+    for (int j = 0; j < 2000; ++j) {
+      assert(mixed_w_a.ValueOf(j) == mixed_w_b.ValueOf(j));
+    }
+    assert(mixed_w_a.GetSquaredNorm() == mixed_w_b.GetSquaredNorm());
+    assert(mixed_w_a.GetSquaredNorm() > 0.0);
+  }
+
+  // Mixing trains the roc and rank loops whether the labels of the examples
+  // alternate or are sorted, as the shards are drawn at random and so each
+  // gets examples of both labels.
+  vector<long int> label_sorted;
+  for (int i = 0; i < 200; i += 2) {
+    label_sorted.push_back(i % 100 + i / 100);
+  }
+  SfDataSet data_set_4(data_set_3, label_sorted);
+  typedef void (*PairLoop)(const SfDataSet&, sofia_ml::LearnerType,
+			   sofia_ml::EtaType, float, float, int, SfRandom*,
+			   SfWeightVector*, int, sofia_ml::ThreadMode, int);
+  PairLoop pair_loops[2] = {sofia_ml::StochasticRocLoop,
+			    sofia_ml::StochasticRankLoop};
+  for (int loop = 0; loop < 2; ++loop) {
+    for (int sorted = 0; sorted <= 1; ++sorted) {
+      const SfDataSet& pair_data = sorted ? data_set_4 : data_set_3;
+      assert(pair_data.VectorAt(0).GetY() == -1.0);
+      assert(pair_data.VectorAt(1).GetY() == (sorted ? -1.0 : 1.0));
+      for (int num_threads = 2; num_threads <= 3; ++num_threads) {
+	SfWeightVector pair_w(2000);
+	SfRandom pair_random(13);
+	pair_loops[loop](pair_data, sofia_ml::PEGASOS, sofia_ml::PEGASOS_ETA,
+			 0.001, 0, 3000, &pair_random, &pair_w, num_threads,
+			 sofia_ml::PARAMETER_MIXING, 50);
+	// Count the pairs of a positive and a negative example that the
+	// model ranks in order.
+	int num_in_order = 0;
+	for (int a = 0; a < 100; ++a) {
+	  for (int b = 0; b < 100; ++b) {
+	    if (pair_data.VectorAt(a).GetY() > 0 &&
+		pair_data.VectorAt(b).GetY() < 0 &&
+		sofia_ml::SingleSvmPrediction(pair_data.VectorAt(a), pair_w) >
+		sofia_ml::SingleSvmPrediction(pair_data.VectorAt(b), pair_w)) {
+	      ++num_in_order;
+	    }
+	  }
+	}
+	assert(num_in_order >= 0.98 * 50 * 50);
+      }
+    }
+  }
+
+  SfWeightVector pegasos_5("0 0.559 0.559");
   vector<float> predictions;
   sofia_ml::SvmPredictionsOnTestSet(data_set_2, pegasos_5, &predictions);
   assert(predictions.size() == 4);
@@ -83,5 +489,85 @@ int main (int argc, char** argv) {
   assert (svm_objective < expected_objective + 0.01);
   assert (svm_objective > expected_objective - 0.01);
 
+  // Streaming the same examples from a file, with a buffer of just one
+  // example, takes one step per example per pass.  The weight vector grows
+  // to fit the examples.
+  SfFeatureMap no_feature_map;
+  SfWeightVector streaming_pegasos(1);
+  SfRandom streaming_random(100);
+  sofia_ml::StreamingOuterLoop("sofia-ml-methods_test.dat",
+			       1,
+			       false,
+			       false,
+			       0,
+			       0,
+			       2,
+			       sofia_ml::PEGASOS,
+			       sofia_ml::PEGASOS_ETA,
+			       0.1,
+			       0,
+			       no_feature_map,
+			       &streaming_random,
+			       &streaming_pegasos);
+  assert(sofia_ml::SingleSvmPrediction(data_set_2.VectorAt(0),
+				       streaming_pegasos) > 0.0);
+  assert(sofia_ml::SingleSvmPrediction(data_set_2.VectorAt(1),
+				       streaming_pegasos) < 0.0);
+  assert(streaming_pegasos.GetDimensions() == 3);
+
+  // Parsing the file in the background trains the same model.
+  SfWeightVector background_pegasos(1);
+  SfRandom background_random(100);
+  sofia_ml::StreamingOuterLoop("sofia-ml-methods_test.dat",
+			       1,
+			       false,
+			       true,
+			       0,
+			       0,
+			       2,
+			       sofia_ml::PEGASOS,
+			       sofia_ml::PEGASOS_ETA,
+			       0.1,
+			       0,
+			       no_feature_map,
+			       &background_random,
+			       &background_pegasos);
+  for (int i = 0; i < 3; ++i) {
+    assert(background_pegasos.ValueOf(i) == streaming_pegasos.ValueOf(i));
+  }
+
+  // A model trained on remapped ids goes on training on them when the file
+  // is streamed with its map.  This map swaps features 1 and 2, so the
+  // weights are those trained above, swapped.
+  SfDataSet map_source(false);
+  map_source.AddVector("1 2:1.0");
+  map_source.AddVector("1 1:1.0 2:1.0");
+  SfFeatureMap feature_map;
+  feature_map.AddFeatures(map_source);
+  assert(feature_map.DenseId(2) == 1);
+  assert(feature_map.DenseId(1) == 2);
+  for (int parse_in_background = 0; parse_in_background < 2;
+       ++parse_in_background) {
+    SfWeightVector mapped_pegasos(1);
+    SfRandom mapped_random(100);
+    sofia_ml::StreamingOuterLoop("sofia-ml-methods_test.dat",
+				 1,
+				 false,
+				 parse_in_background,
+				 0,
+				 0,
+				 2,
+				 sofia_ml::PEGASOS,
+				 sofia_ml::PEGASOS_ETA,
+				 0.1,
+				 0,
+				 feature_map,
+				 &mapped_random,
+				 &mapped_pegasos);
+    assert(mapped_pegasos.GetDimensions() == 3);
+    assert(mapped_pegasos.ValueOf(1) == streaming_pegasos.ValueOf(2));
+    assert(mapped_pegasos.ValueOf(2) == streaming_pegasos.ValueOf(1));
+  }
+
   std::cout << argv[0] << ": PASS" << std::endl;
 }
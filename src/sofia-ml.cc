@@ -23,13 +23,19 @@
 // a variant of the PEGASOS stochastic gradient svm solver.
 
 #include <assert.h>
+#include <pthread.h>
+#include <sys/stat.h>
 #include <cstdlib>
 #include <ctime>
 #include <fstream>
 #include <iostream>
 #include <string>
 
+#include "sf-feature-map.h"
 #include "sf-hash-weight-vector.h"
+#include "sf-line-reader.h"
+#include "sf-random.h"
+#include "sf-sparse-dot.h"
 #include "sofia-ml-methods.h"
 #include "sf-weight-vector.h"
 #include "simple-cmd-line-helper.h"
@@ -37,8 +43,19 @@
 using std::string;
 
 void CommandLine(int argc, char** argv) {
-  AddFlag("--training_file", "File to be used for training.", string(""));
-  AddFlag("--test_file", "File to be used for testing.", string(""));
+  AddFlag("--training_file",
+	  "File to be used for training.  Use - to read standard input.",
+	  string(""));
+  AddFlag("--test_file",
+	  "File to be used for testing.  Use - to read standard input.  When\n"
+	  "    this is standard input or a named pipe, each prediction is written\n"
+	  "    as soon as its example has been read.",
+	  string(""));
+  AddFlag("--convert_to_binary",
+	  "Write the data in --training_file (or, if that is not given, in\n"
+	  "    --test_file) to this file in binary format, and exit.  Binary data\n"
+	  "    files are detected automatically, and load much faster than text.",
+	  string(""));
   AddFlag("--results_file", "File to which to write predictions.", string(""));
   AddFlag("--model_in", "Read in a model from this file.", string(""));
   AddFlag("--model_out", "Write the model to this file.", string(""));
@@ -70,11 +87,34 @@ void CommandLine(int argc, char** argv) {
 	  string("pegasos"));
   AddFlag("--loop_type",
 	  "Type of loop to use for training, controlling how examples are selected.\n"
-	  "    Options are: stochastic, balanced-stochastic, "
+	  "    Options are: stochastic, epoch, balanced-stochastic, "
 	  "roc, rank, query-norm-rank, combined-ranking, "
-	  "combined-roc\n"
+	  "combined-roc, streaming\n"
+	  "    The epoch loop visits every example once per epoch in a fresh\n"
+	  "    random order, for --iterations steps in all; see\n"
+	  "    --epoch_block_size.\n"
+	  "    The streaming loop reads --training_file as it trains, without\n"
+	  "    loading it into memory, taking one classification step per example\n"
+	  "    per pass; see --shuffle_buffer_mb and --passes.  --iterations is\n"
+	  "    not used.\n"
 	  "    Default: stochastic",
 	  string("stochastic"));
+  AddFlag("--epoch_block_size",
+	  "Number of consecutive examples shuffled as one block by --loop_type\n"
+	  "    epoch.  Examples within a block are visited in order, which reads\n"
+	  "    memory sequentially; 1 shuffles every example individually.\n"
+	  "    Default: 1",
+	  int(1));
+  AddFlag("--shuffle_buffer_mb",
+	  "Size, in MB, of the buffer of examples used by --loop_type streaming.\n"
+	  "    Each example read replaces a random example in the buffer, which\n"
+	  "    is then used for training, so this also bounds memory use.\n"
+	  "    Default: 100",
+	  int(100));
+  AddFlag("--passes",
+	  "Number of passes over --training_file for --loop_type streaming.\n"
+	  "    Default: 1",
+	  int(1));
   AddFlag("--prediction_type",
 	  "Type of predictions to compute on test data.\n"
 	  "    Options are: linear, logistic\n"
@@ -104,12 +144,62 @@ void CommandLine(int argc, char** argv) {
 	  bool(false));
   AddFlag("--buffer_mb",
 	  "Size of buffer to use in reading/writing to files, in MB.\n"
+	  "    Memory-mapped input files release each --buffer_mb of parsed input\n"
+	  "    from memory as they are read.\n"
 	  "    Default: 40",
 	  int(40));
+  AddFlag("--parse_threads",
+	  "Number of threads to use in parsing each memory-mapped data file.\n"
+	  "    Examples keep the order in which they appear in the file.\n"
+	  "    Default: 1",
+	  int(1));
+  AddFlag("--threads",
+	  "Number of threads taking training steps at once, --iterations steps\n"
+	  "    in all; see --thread_mode.  Not supported with --loop_type streaming\n"
+	  "    or --hash_mask_bits.\n"
+	  "    Default: 1",
+	  int(1));
+  AddFlag("--thread_mode",
+	  "How the --threads share the model.  Options are: hogwild, mixing\n"
+	  "    With hogwild, the threads update the model at once, without locks,\n"
+	  "    so that an update may now and then be lost, and models differ from\n"
+	  "    run to run even with --random_seed.  With mixing, each thread\n"
+	  "    trains its own copy of the model on a random shard of the\n"
+	  "    examples (of whole qid groups, for the rank loops), and the\n"
+	  "    copies are averaged every --mixing_interval steps and at the\n"
+	  "    end; the model depends only on --random_seed.\n"
+	  "    Default: hogwild",
+	  string("hogwild"));
+  AddFlag("--mixing_interval",
+	  "With --thread_mode mixing, the number of steps each thread takes\n"
+	  "    between averages of the copies of the model, or 0 to average them\n"
+	  "    only at the end.\n"
+	  "    Default: 0",
+	  int(0));
+  AddFlag("--pipeline",
+	  "Overlap reading data with training.  With --loop_type streaming, the\n"
+	  "    training file is parsed on a separate thread as training goes on,\n"
+	  "    and --test_file is read on a separate thread while training runs.\n"
+	  "    Training and test data may then be held in memory at the same time.\n"
+	  "    Default: not set.",
+	  bool(false));
   AddFlag("--dimensionality",
-	  "Index value of largest feature index in training data set. \n"
-	  "    Default: 2^17 = 131072",
-	  int(2<<16));
+	  "Largest allowed feature index plus one.  The weight vector is sized\n"
+	  "    to fit the largest feature index in the training data; if that is\n"
+	  "    at least this value, loading the data fails rather than training.\n"
+	  "    Default of 0 sets no limit.",
+	  int(0));
+  AddFlag("--remap_features",
+	  "Renumber the feature ids of the training data 1, 2, 3, ... in order of\n"
+	  "    decreasing frequency, so that the weight vector is only as large as\n"
+	  "    the number of distinct features, even for sparse hashed ids.  The\n"
+	  "    map is saved with the model and applied to test data; features not\n"
+	  "    seen in training are then ignored.  Not supported with --loop_type\n"
+	  "    streaming, or with a --model_in model trained without it.  A\n"
+	  "    --model_in model trained with it keeps using its map, also with\n"
+	  "    --loop_type streaming; new features are then ignored.\n"
+	  "    Default: not set.",
+	  bool(false));
   AddFlag("--hash_mask_bits",
 	  "When set to a non-zero value, causes the use of a hashed weight vector\n"
 	  "    with hashed cross product features.  The size of the hash table is set\n"
@@ -125,6 +215,15 @@ void CommandLine(int argc, char** argv) {
 	  "    this flag as no effect for rank and roc optimzation.\n"
 	  "    Default: not set.",
 	  bool(false));
+  AddFlag("--sequential_inner_products",
+	  "Sum the terms of each inner product one at a time, left to right, as\n"
+	  "    earlier versions did, so that their results are reproduced\n"
+	  "    bit-for-bit.  By default the terms are summed in 8 interleaved lanes,\n"
+	  "    using AVX2 or AVX-512 where the CPU supports them.  Results are then\n"
+	  "    identical on every machine, but may differ from sequential sums in\n"
+	  "    the last bits.\n"
+	  "    Default: not set.",
+	  bool(false));
   ParseFlags(argc, argv);
 }
 
@@ -133,7 +232,20 @@ void PrintElapsedTime(clock_t start, const string& message) {
   std::cout << message << num_secs << std::endl;
 }
 
-void SaveModelToFile(const string& file_name, SfWeightVector* w) {
+// True if file_name is "-", for standard input, or a named pipe.  Such a
+// file can only be read once, as it is written.
+bool IsPipe(const string& file_name) {
+  if (file_name == "-") return true;
+  struct stat file_stat;
+  return stat(file_name.c_str(), &file_stat) == 0 &&
+    S_ISFIFO(file_stat.st_mode);
+}
+
+// Writes w to file_name, followed on a second line by feature_map if it is
+// not empty.
+void SaveModelToFile(const string& file_name,
+		     const SfFeatureMap& feature_map,
+		     SfWeightVector* w) {
   std::fstream model_stream;
   model_stream.open(file_name.c_str(), std::fstream::out);
   if (!model_stream) {
@@ -142,11 +254,18 @@ void SaveModelToFile(const string& file_name, SfWeightVector* w) {
   }
   std::cerr << "Writing model to: " << file_name << std::endl;
   model_stream << w->AsString() << std::endl;
+  if (!feature_map.Empty()) {
+    model_stream << feature_map.AsString() << std::endl;
+  }
   model_stream.close();
   std::cerr << "   Done." << std::endl;
 }
 
-void LoadModelFromFile(const string& file_name, SfWeightVector** w) {
+// Reads a model written by SaveModelToFile() into *w and *feature_map.  A
+// model with no second line has no feature map.
+void LoadModelFromFile(const string& file_name,
+		       SfFeatureMap* feature_map,
+		       SfWeightVector** w) {
   if (*w != NULL) {
     delete *w;
   }
@@ -161,14 +280,31 @@ void LoadModelFromFile(const string& file_name, SfWeightVector** w) {
   std::cerr << "Reading model from: " << file_name << std::endl;
   string model_string;
   std::getline(model_stream, model_string);
+  string feature_map_string;
+  std::getline(model_stream, feature_map_string);
   model_stream.close();
   std::cerr << "   Done." << std::endl;
 
   *w = new SfWeightVector(model_string);
   assert(*w != NULL);
+  *feature_map = SfFeatureMap(feature_map_string);
 }
 
-void TrainModel (const SfDataSet& training_data, SfWeightVector* w) {
+// The limit on the dimensionality of the weight vector, or 0 for none.  Hashed
+// weight vectors have a fixed size, whatever the feature ids.
+int MaxDimensionality() {
+  if (CMD_LINE_INTS["--hash_mask_bits"] != 0) return 0;
+  return CMD_LINE_INTS["--dimensionality"];
+}
+
+// Trains w on training_data, or, if training_data is NULL, on examples
+// streamed from --training_file, as for --loop_type streaming.  Streamed
+// examples are first mapped by feature_map, if it is not empty; training_data
+// is expected to be remapped already.  Examples are sampled with random.
+void TrainModel (const SfDataSet* training_data,
+		 const SfFeatureMap& feature_map,
+		 SfRandom* random,
+		 SfWeightVector* w) {
   clock_t train_start = clock();
   assert(w != NULL);
 
@@ -216,66 +352,133 @@ void TrainModel (const SfDataSet& training_data, SfWeightVector* w) {
     exit(0);
   }
   
-  if (CMD_LINE_STRINGS["--loop_type"] == "stochastic")
-    sofia_ml::StochasticOuterLoop(training_data,
+  sofia_ml::ThreadMode thread_mode;
+  if (CMD_LINE_STRINGS["--thread_mode"] == "hogwild")
+    thread_mode = sofia_ml::HOGWILD;
+  else if (CMD_LINE_STRINGS["--thread_mode"] == "mixing")
+    thread_mode = sofia_ml::PARAMETER_MIXING;
+  else {
+    std::cerr << "--thread_mode " << CMD_LINE_STRINGS["--thread_mode"]
+	      << " not supported." << std::endl;
+    exit(1);
+  }
+
+  if (training_data == NULL)
+    sofia_ml::StreamingOuterLoop(CMD_LINE_STRINGS["--training_file"],
+				 CMD_LINE_INTS["--buffer_mb"],
+				 !CMD_LINE_BOOLS["--no_bias_term"],
+				 CMD_LINE_BOOLS["--pipeline"],
+				 MaxDimensionality(),
+				 CMD_LINE_INTS["--shuffle_buffer_mb"],
+				 CMD_LINE_INTS["--passes"],
+				 learner_type,
+				 eta_type,
+				 lambda,
+				 c,
+				 feature_map,
+				 random,
+				 w);
+  else if (CMD_LINE_STRINGS["--loop_type"] == "stochastic")
+    sofia_ml::StochasticOuterLoop(*training_data,
 				learner_type,
 				eta_type,
 				lambda,
 				c,
 				CMD_LINE_INTS["--iterations"],
-				w);
+				random,
+				w,
+				CMD_LINE_INTS["--threads"],
+				thread_mode,
+				CMD_LINE_INTS["--mixing_interval"]);
+  else if (CMD_LINE_STRINGS["--loop_type"] == "epoch")
+    sofia_ml::EpochOuterLoop(*training_data,
+			     CMD_LINE_INTS["--epoch_block_size"],
+			     learner_type,
+			     eta_type,
+			     lambda,
+			     c,
+			     CMD_LINE_INTS["--iterations"],
+			     random,
+			     w,
+			     CMD_LINE_INTS["--threads"],
+			     thread_mode,
+			     CMD_LINE_INTS["--mixing_interval"]);
   else if (CMD_LINE_STRINGS["--loop_type"] == "balanced-stochastic")
-    sofia_ml::BalancedStochasticOuterLoop(training_data,
+    sofia_ml::BalancedStochasticOuterLoop(*training_data,
 					learner_type,
 					eta_type,
 					lambda,
 					c,
 					CMD_LINE_INTS["--iterations"],
-					w);
+					random,
+					w,
+					CMD_LINE_INTS["--threads"],
+					thread_mode,
+					CMD_LINE_INTS["--mixing_interval"]);
   else if (CMD_LINE_STRINGS["--loop_type"] == "roc")
-    sofia_ml::StochasticRocLoop(training_data,
+    sofia_ml::StochasticRocLoop(*training_data,
 			      learner_type,
 			      eta_type,
 			      lambda,
 			      c,
 			      CMD_LINE_INTS["--iterations"],
-			      w);
+			      random,
+			      w,
+			      CMD_LINE_INTS["--threads"],
+			      thread_mode,
+			      CMD_LINE_INTS["--mixing_interval"]);
   else if (CMD_LINE_STRINGS["--loop_type"] == "rank")
-    sofia_ml::StochasticRankLoop(training_data,
+    sofia_ml::StochasticRankLoop(*training_data,
 			      learner_type,
 			      eta_type,
 			      lambda,
 			      c,
 			      CMD_LINE_INTS["--iterations"],
-			      w);
+			      random,
+			      w,
+			      CMD_LINE_INTS["--threads"],
+			      thread_mode,
+			      CMD_LINE_INTS["--mixing_interval"]);
   else if (CMD_LINE_STRINGS["--loop_type"] == "combined-ranking")
     sofia_ml::StochasticClassificationAndRankLoop(
-		training_data,
+		*training_data,
 		learner_type,
 		eta_type,
 		lambda,
 		c,
 		CMD_LINE_FLOATS["--rank_step_probability"],
 		CMD_LINE_INTS["--iterations"],
-		w);
+		random,
+		w,
+		CMD_LINE_INTS["--threads"],
+		thread_mode,
+		CMD_LINE_INTS["--mixing_interval"]);
   else if (CMD_LINE_STRINGS["--loop_type"] == "combined-roc")
     sofia_ml::StochasticClassificationAndRocLoop(
-		training_data,
+		*training_data,
 		learner_type,
 		eta_type,
 		lambda,
 		c,
 		CMD_LINE_FLOATS["--rank_step_probability"],
 		CMD_LINE_INTS["--iterations"],
-		w);
+		random,
+		w,
+		CMD_LINE_INTS["--threads"],
+		thread_mode,
+		CMD_LINE_INTS["--mixing_interval"]);
   else if (CMD_LINE_STRINGS["--loop_type"] == "query-norm-rank")
-    sofia_ml::StochasticQueryNormRankLoop(training_data,
+    sofia_ml::StochasticQueryNormRankLoop(*training_data,
 			      learner_type,
 			      eta_type,
 			      lambda,
 			      c,
 			      CMD_LINE_INTS["--iterations"],
-			      w);
+			      random,
+			      w,
+			      CMD_LINE_INTS["--threads"],
+			      thread_mode,
+			      CMD_LINE_INTS["--mixing_interval"]);
   else {
     std::cerr << "--loop_type " << CMD_LINE_STRINGS["--loop_type"] << " not supported.";
     exit(0);
@@ -284,40 +487,226 @@ void TrainModel (const SfDataSet& training_data, SfWeightVector* w) {
   PrintElapsedTime(train_start, "Time to complete training: ");
 }
 
+// Opens --results_file for writing predictions, exiting on error.
+void OpenResultsFile(std::fstream* prediction_stream) {
+  prediction_stream->open(CMD_LINE_STRINGS["--results_file"].c_str(),
+			  std::fstream::out);
+  if (!*prediction_stream) {
+    std::cerr << "Error opening test results output file " 
+	      << CMD_LINE_STRINGS["--results_file"] << std::endl;
+    exit(1);
+  }
+  std::cerr << "Writing test results to: "
+	    << CMD_LINE_STRINGS["--results_file"] << std::endl;
+}
+
+// Writes a prediction by w for each example of --test_file to
+// --results_file as soon as the example has been read, rather than after
+// the whole file has been read, so that test data may arrive on a pipe.
+// w is grown to fit the test data, giving unseen features zero weight.
+// Feature ids are first mapped by feature_map, if it is not empty.
+void StreamPredictions(const SfFeatureMap& feature_map, SfWeightVector* w) {
+  bool logistic = CMD_LINE_STRINGS["--prediction_type"] == "logistic";
+  if (!logistic && CMD_LINE_STRINGS["--prediction_type"] != "linear") {
+    std::cerr << "--prediction " << CMD_LINE_STRINGS["--prediction_type"]
+	      << " not supported.";
+    exit(0);
+  }
+
+  std::cerr << "Streaming test data from: "
+	    << CMD_LINE_STRINGS["--test_file"] << std::endl;
+  SfLineReader line_reader(CMD_LINE_STRINGS["--test_file"],
+			   CMD_LINE_INTS["--buffer_mb"] * 1024L * 1024L);
+  std::fstream prediction_stream;
+  OpenResultsFile(&prediction_stream);
+
+  bool use_bias_term = !CMD_LINE_BOOLS["--no_bias_term"];
+  SfSparseVector x;
+  const char* line_begin;
+  const char* line_end;
+  while (line_reader.NextLine(&line_begin, &line_end)) {
+    x.Parse(line_begin, line_end, use_bias_term);
+    if (!feature_map.Empty()) feature_map.MapVector(&x);
+    w->GrowToFit(SfSparseVectorView(x).MaxFeatureId());
+    float prediction = logistic ?
+      sofia_ml::SingleLogisticPrediction(x, *w) :
+      sofia_ml::SingleSvmPrediction(x, *w);
+    prediction_stream << prediction << "\t" << x.GetY() << "\n";
+    // Flush only before waiting for more input, rather than on every line.
+    if (!line_reader.HasBufferedLine()) prediction_stream.flush();
+  }
+  prediction_stream.close();
+  std::cerr << "   Done." << std::endl;
+}
+
+// A data set read on a separate thread, by StartBackgroundLoad().  The flag
+// values are copied in, so that the thread need not touch the flag maps.
+struct BackgroundLoad {
+  string file_name;
+  int buffer_mb;
+  bool use_bias_term;
+  int num_threads;
+  SfDataSet* data_set;
+  pthread_t thread;
+};
+
+void* LoadInBackground(void* load_pointer) {
+  BackgroundLoad* load = static_cast<BackgroundLoad*>(load_pointer);
+  load->data_set = new SfDataSet(load->file_name,
+				 load->buffer_mb,
+				 load->use_bias_term,
+				 load->num_threads);
+  return NULL;
+}
+
+// Starts reading file_name into load->data_set on a separate thread.
+void StartBackgroundLoad(const string& file_name, BackgroundLoad* load) {
+  load->file_name = file_name;
+  load->buffer_mb = CMD_LINE_INTS["--buffer_mb"];
+  load->use_bias_term = !CMD_LINE_BOOLS["--no_bias_term"];
+  load->num_threads = CMD_LINE_INTS["--parse_threads"];
+  load->data_set = NULL;
+  if (pthread_create(&load->thread, NULL, LoadInBackground, load) != 0) {
+    std::cerr << "Error creating thread to read " << file_name << std::endl;
+    exit(1);
+  }
+}
+
+// Waits for a load begun by StartBackgroundLoad() to finish, and returns
+// the data set read, which the caller takes ownership of.
+SfDataSet* FinishBackgroundLoad(BackgroundLoad* load) {
+  pthread_join(load->thread, NULL);
+  return load->data_set;
+}
+
 int main (int argc, char** argv) {
   CommandLine(argc, argv);
+
+  // A pipe can only be read once.
+  if (CMD_LINE_STRINGS["--training_file"] == "-" &&
+      CMD_LINE_STRINGS["--test_file"] == "-") {
+    std::cerr << "--training_file and --test_file can not both be standard "
+	      << "input." << std::endl;
+    exit(1);
+  }
+  if (CMD_LINE_STRINGS["--loop_type"] == "streaming" &&
+      CMD_LINE_INTS["--passes"] > 1 &&
+      IsPipe(CMD_LINE_STRINGS["--training_file"])) {
+    std::cerr << "--passes must be 1 when --training_file is a pipe."
+	      << std::endl;
+    exit(1);
+  }
+  if (CMD_LINE_STRINGS["--loop_type"] == "streaming" &&
+      CMD_LINE_BOOLS["--remap_features"]) {
+    std::cerr << "--remap_features is not supported with --loop_type "
+	      << "streaming." << std::endl;
+    exit(1);
+  }
   
-  if (CMD_LINE_INTS["--random_seed"] == 0) {
-    srand(time(NULL));
+  if (CMD_LINE_INTS["--threads"] > 1 &&
+      (CMD_LINE_STRINGS["--loop_type"] == "streaming" ||
+       CMD_LINE_INTS["--hash_mask_bits"] != 0)) {
+    std::cerr << "--threads is not supported with --loop_type streaming or "
+	      << "--hash_mask_bits." << std::endl;
+    exit(1);
+  }
+  
+  if (CMD_LINE_BOOLS["--sequential_inner_products"]) {
+    SfSetSparseDotOrder(SF_SEQUENTIAL_ORDER);
+  }
+
+  unsigned int random_seed = CMD_LINE_INTS["--random_seed"];
+  if (random_seed == 0) {
+    random_seed = time(NULL);
   } else {
     std::cerr << "Using random_seed: " << CMD_LINE_INTS["--random_seed"] << std::endl;
-    srand(CMD_LINE_INTS["--random_seed"]);
+  }
+  SfRandom random(random_seed);
+
+  // Convert a data file to binary format, if needed.
+  if (!CMD_LINE_STRINGS["--convert_to_binary"].empty()) {
+    string data_file = CMD_LINE_STRINGS["--training_file"].empty() ?
+      CMD_LINE_STRINGS["--test_file"] : CMD_LINE_STRINGS["--training_file"];
+    std::cerr << "Converting data from: " << data_file << std::endl;
+    SfDataSet data_set(data_file,
+		       CMD_LINE_INTS["--buffer_mb"],
+		       !CMD_LINE_BOOLS["--no_bias_term"],
+		       CMD_LINE_INTS["--parse_threads"]);
+    std::cerr << "Writing binary data to: "
+	      << CMD_LINE_STRINGS["--convert_to_binary"] << std::endl;
+    data_set.WriteBinaryFile(CMD_LINE_STRINGS["--convert_to_binary"]);
+    std::cerr << "   Done." << std::endl;
+    return 0;
   }
 
-  // Set up empty model with specified dimensionality.
+  // Set up empty model, which grows to fit the data it is used on.
   SfWeightVector* w  = NULL;
   if (CMD_LINE_INTS["--hash_mask_bits"] == 0) {
-    w = new SfWeightVector(CMD_LINE_INTS["--dimensionality"]);
+    w = new SfWeightVector(1);
   } else {
     w = new SfHashWeightVector(CMD_LINE_INTS["--hash_mask_bits"]);
   }
 
+  // Feature ids are used as they are unless a map is built or loaded.
+  SfFeatureMap feature_map;
+
   // Load model (overwriting empty model), if needed.
   if (!CMD_LINE_STRINGS["--model_in"].empty()) {
-    LoadModelFromFile(CMD_LINE_STRINGS["--model_in"], &w); 
+    LoadModelFromFile(CMD_LINE_STRINGS["--model_in"], &feature_map, &w); 
+    // The loaded weights are indexed by raw feature ids, which a new map
+    // would renumber out from under them.
+    if (CMD_LINE_BOOLS["--remap_features"] && feature_map.Empty()) {
+      std::cerr << "--remap_features requires that a --model_in model was "
+		<< "trained with --remap_features." << std::endl;
+      exit(1);
+    }
   }
   
+  // Start reading test data while the model trains, if needed.
+  bool stream_test_data = !CMD_LINE_STRINGS["--test_file"].empty() &&
+    IsPipe(CMD_LINE_STRINGS["--test_file"]);
+  bool test_data_in_background = CMD_LINE_BOOLS["--pipeline"] &&
+    !CMD_LINE_STRINGS["--test_file"].empty() && !stream_test_data;
+  BackgroundLoad test_data_load;
+  if (test_data_in_background) {
+    std::cerr << "Reading test data in background from: "
+	      << CMD_LINE_STRINGS["--test_file"] << std::endl;
+    StartBackgroundLoad(CMD_LINE_STRINGS["--test_file"], &test_data_load);
+  }
+
+  // Train model on streamed data, if needed.
+  if (!CMD_LINE_STRINGS["--training_file"].empty() &&
+      CMD_LINE_STRINGS["--loop_type"] == "streaming") {
+    std::cerr << "Streaming training data from: "
+	      << CMD_LINE_STRINGS["--training_file"] << std::endl;
+    TrainModel(NULL, feature_map, &random, w);
+  }
+
   // Train model, if needed.
-  if (!CMD_LINE_STRINGS["--training_file"].empty()) {
+  if (!CMD_LINE_STRINGS["--training_file"].empty() &&
+      CMD_LINE_STRINGS["--loop_type"] != "streaming") {
     std::cerr << "Reading training data from: " 
 	      << CMD_LINE_STRINGS["--training_file"] << std::endl;
     clock_t read_data_start = clock();
     SfDataSet training_data(CMD_LINE_STRINGS["--training_file"],
 			    CMD_LINE_INTS["--buffer_mb"],
-			    !CMD_LINE_BOOLS["--no_bias_term"]);
+			    !CMD_LINE_BOOLS["--no_bias_term"],
+			    CMD_LINE_INTS["--parse_threads"]);
     PrintElapsedTime(read_data_start, "Time to read training data: ");
+    // A loaded model that was trained on remapped data continues to be.
+    if (CMD_LINE_BOOLS["--remap_features"] || !feature_map.Empty()) {
+      clock_t remap_start = clock();
+      feature_map.AddFeatures(training_data);
+      training_data.RemapFeatures(feature_map);
+      std::cerr << "Remapped " << feature_map.NumFeatures()
+		<< " distinct features." << std::endl;
+      PrintElapsedTime(remap_start, "Time to remap training data: ");
+    }
+    sofia_ml::FitDimensionality(training_data.MaxFeatureId(),
+				MaxDimensionality(),
+				w);
 
-    TrainModel(training_data, w);
+    TrainModel(&training_data, feature_map, &random, w);
 
     // Compute value of objective function on training data, if needed.
     if (CMD_LINE_BOOLS["--training_objective"]) {
@@ -335,25 +724,39 @@ int main (int argc, char** argv) {
 
   // Save model, if needed.
   if (!CMD_LINE_STRINGS["--model_out"].empty()) {
-    SaveModelToFile(CMD_LINE_STRINGS["--model_out"], w);
+    SaveModelToFile(CMD_LINE_STRINGS["--model_out"], feature_map, w);
   }
     
+  // Test model on test data as it arrives, if needed.
+  if (stream_test_data) {
+    StreamPredictions(feature_map, w);
+  }
+
   // Test model on test data, if needed.
-  if (!CMD_LINE_STRINGS["--test_file"].empty()) {
-    std::cerr << "Reading test data from: " 
-	      << CMD_LINE_STRINGS["--test_file"] << std::endl;
+  if (!CMD_LINE_STRINGS["--test_file"].empty() && !stream_test_data) {
     clock_t read_data_start = clock();
-    SfDataSet test_data(CMD_LINE_STRINGS["--test_file"],
-			CMD_LINE_INTS["--buffer_mb"],
-			!CMD_LINE_BOOLS["--no_bias_term"]);
+    SfDataSet* test_data = NULL;
+    if (test_data_in_background) {
+      test_data = FinishBackgroundLoad(&test_data_load);
+    } else {
+      std::cerr << "Reading test data from: " 
+		<< CMD_LINE_STRINGS["--test_file"] << std::endl;
+      test_data = new SfDataSet(CMD_LINE_STRINGS["--test_file"],
+				CMD_LINE_INTS["--buffer_mb"],
+				!CMD_LINE_BOOLS["--no_bias_term"],
+				CMD_LINE_INTS["--parse_threads"]);
+    }
     PrintElapsedTime(read_data_start, "Time to read test data: ");
+    if (!feature_map.Empty()) test_data->RemapFeatures(feature_map);
+    // Features never seen in training get zero weight.
+    w->GrowToFit(test_data->MaxFeatureId());
     
     vector<float> predictions;
     clock_t predict_start = clock();
     if (CMD_LINE_STRINGS["--prediction_type"] == "linear")
-      sofia_ml::SvmPredictionsOnTestSet(test_data, *w, &predictions);
+      sofia_ml::SvmPredictionsOnTestSet(*test_data, *w, &predictions);
     else if (CMD_LINE_STRINGS["--prediction_type"] == "logistic")
-      sofia_ml::LogisticPredictionsOnTestSet(test_data, *w, &predictions);
+      sofia_ml::LogisticPredictionsOnTestSet(*test_data, *w, &predictions);
     else {
       std::cerr << "--prediction " << CMD_LINE_STRINGS["--prediction_type"]
 		<< " not supported.";
@@ -363,20 +766,13 @@ int main (int argc, char** argv) {
     PrintElapsedTime(predict_start, "Time to make test prediction results: ");
     
     std::fstream prediction_stream;
-    prediction_stream.open(CMD_LINE_STRINGS["--results_file"].c_str(),
-			   std::fstream::out);
-    if (!prediction_stream) {
-      std::cerr << "Error opening test results output file " 
-		<< CMD_LINE_STRINGS["--results_file"] << std::endl;
-      exit(1);
-    }
-    std::cerr << "Writing test results to: "
-	      << CMD_LINE_STRINGS["--results_file"] << std::endl;
+    OpenResultsFile(&prediction_stream);
     for (unsigned int i = 0; i < predictions.size(); ++i) {
       prediction_stream << predictions[i] << "\t" 
-			<< test_data.VectorAt(i).GetY() << std::endl;
+			<< test_data->VectorAt(i).GetY() << std::endl;
     }
     prediction_stream.close();
+    delete test_data;
     std::cerr << "   Done." << std::endl;
   }
 }